@@ -0,0 +1,76 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../src/renderer.h"
+#include "../src/scene.h"
+#include "benchmark.h"
+#include "scenes.h"
+
+namespace deer {
+
+namespace benchmark {
+
+// Adaptive against uniform supersampling, both measured against a 64x
+// uniform reference. The error comes almost entirely from edges. Adaptive
+// modes are named by their sample range and aa_contrast, with
+// aa_threshold at 0.01; a contrast of 1 turns the neighbour test off.
+DEER_BENCHMARK(AdaptiveAntialiasing) {
+  const Scene scene = MakeMixedScene(4);
+  const Camera camera = MakeCamera();
+  const std::size_t width = 320, height = 180;
+
+  auto options = MakeOptions(width, height);
+  options.min_samples = options.max_samples = 64;
+  RayTracer reference_tracer(options);
+  const auto reference = RenderImage(reference_tracer, scene, camera);
+
+  out << std::setw(22) << "mode"
+      << std::setw(14) << "rays/pixel"
+      << std::setw(10) << "time, s"
+      << std::setw(8) << "RMSE" << '\n';
+
+  auto report = [&](const std::string &name, std::size_t min_samples,
+                    std::size_t max_samples, double threshold,
+                    double contrast) {
+    options.min_samples = min_samples;
+    options.max_samples = max_samples;
+    options.aa_threshold = threshold;
+    options.aa_contrast = contrast;
+    RayTracer tracer(options);
+    std::vector<std::uint8_t> image;
+    Renderer::Statistics statistics;
+    const double time = Time([&] {
+      auto job_status = tracer.Render(scene, camera);
+      image = job_status->result.get();
+      statistics = job_status->statistics;
+    });
+    out << std::setw(22) << name
+        << std::setw(14) << std::setprecision(3)
+        << static_cast<double>(statistics.primary_rays) / (width * height)
+        << std::setw(10) << std::setprecision(3) << time
+        << std::setw(8) << std::setprecision(3)
+        << RootMeanSquareError(image, reference) << '\n';
+  };
+
+  for (std::size_t samples : {1, 4, 16}) {
+    report("uniform x" + std::to_string(samples), samples, samples, 0, 0);
+  }
+  for (double contrast : {1.0, 0.2, 0.1, 0.05}) {
+    for (std::size_t min_samples : {2, 4}) {
+      std::ostringstream name;
+      name << "adaptive " << min_samples << "-16, " << contrast;
+      report(name.str(), min_samples, 16, 0.01, contrast);
+    }
+  }
+}
+
+}  // namespace benchmark
+
+}  // namespace deer
@@ -0,0 +1,51 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "../src/renderer.h"
+#include "../src/scene.h"
+#include "benchmark.h"
+#include "scenes.h"
+
+namespace deer {
+
+namespace benchmark {
+
+// Four views of a scene whose cost is concentrated in one corner, one
+// job per view against all of them in one job.
+DEER_BENCHMARK(BatchedViews) {
+  const Scene scene = MakeUnevenScene(12);
+  std::vector<Camera> cameras;
+  for (double shift : {0.0, 2.0, 4.0, 6.0}) {
+    cameras.push_back(MakeCamera());
+    cameras.back().transform.Translate(shift, 0, 0);
+  }
+
+  out << std::setw(10) << "view size"
+      << std::setw(16) << "jobs, seconds"
+      << std::setw(16) << "batch, seconds" << '\n';
+  for (std::size_t width : {160, 320}) {
+    auto options = MakeOptions(width, width * 9 / 16);
+    options.progressive = true;
+    RayTracer tracer(options);
+    const double jobs_seconds = Time([&] {
+      for (const Camera &camera : cameras) {
+        tracer.Render(scene, camera)->result.wait();
+      }
+    });
+    const double batch_seconds = Time([&] {
+      tracer.Render(scene, cameras)->result.wait();
+    });
+    out << std::setw(6) << width << 'x' << std::setw(3) << width * 9 / 16
+        << std::setw(16) << std::setprecision(3) << jobs_seconds
+        << std::setw(16) << std::setprecision(3) << batch_seconds << '\n';
+  }
+}
+
+}  // namespace benchmark
+
+}  // namespace deer
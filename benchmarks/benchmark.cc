@@ -0,0 +1,66 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace deer {
+
+namespace benchmark {
+
+namespace {
+
+std::vector<std::pair<std::string, BenchmarkFunction>> &Registry() {
+  static std::vector<std::pair<std::string, BenchmarkFunction>> registry;
+  return registry;
+}
+
+}  // namespace
+
+Registration::Registration(const char *name, BenchmarkFunction function) {
+  Registry().emplace_back(name, function);
+}
+
+int RunBenchmarks(char **first, char **last, std::ostream &out) {
+  auto registry = Registry();
+  std::sort(registry.begin(), registry.end());
+
+  int n_run = 0;
+  for (const auto &[name, function] : registry) {
+    if (first != last && std::find(first, last, name) == last) continue;
+    out << "== " << name << " ==\n";
+    function(out);
+    out << '\n';
+    n_run++;
+  }
+
+  if (n_run == 0) {
+    out << "No benchmarks matched. Available:\n";
+    for (const auto &entry : registry) out << "  " << entry.first << '\n';
+    return 1;
+  }
+  return 0;
+}
+
+double RootMeanSquareError(const std::vector<std::uint8_t> &a,
+                           const std::vector<std::uint8_t> &b) {
+  double sum = 0;
+  const std::size_t n = std::min(a.size(), b.size());
+  for (std::size_t i = 0; i < n; i++) {
+    const double d = static_cast<double>(a[i]) - b[i];
+    sum += d * d;
+  }
+  return n > 0 ? std::sqrt(sum / n) : 0;
+}
+
+}  // namespace benchmark
+
+}  // namespace deer
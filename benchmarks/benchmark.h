@@ -0,0 +1,58 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#ifndef DEER_BENCHMARKS_BENCHMARK_H_
+#define DEER_BENCHMARKS_BENCHMARK_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace deer {
+
+namespace benchmark {
+
+using BenchmarkFunction = void (*)(std::ostream &);
+
+// Registers a benchmark so that it can be run by name from the command line.
+struct Registration {
+  Registration(const char *name, BenchmarkFunction function);
+};
+
+#define DEER_BENCHMARK(name) \
+  static void name(std::ostream &); \
+  static ::deer::benchmark::Registration name##_registration(#name, name); \
+  static void name(std::ostream &out)
+
+// Runs every registered benchmark whose name is in [first, last),
+// or all of them if the range is empty.
+int RunBenchmarks(char **first, char **last, std::ostream &out);
+
+// Wall-clock seconds of the fastest of several runs.
+template<class F>
+double Time(F &&f, int repeats = 3) {
+  double best = std::numeric_limits<double>::infinity();
+  for (int i = 0; i < repeats; i++) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto finish = std::chrono::steady_clock::now();
+    best = std::min(best,
+        std::chrono::duration<double>(finish - start).count());
+  }
+  return best;
+}
+
+// Root-mean-square difference of two byte images, in 0..255 units.
+double RootMeanSquareError(const std::vector<std::uint8_t> &,
+                           const std::vector<std::uint8_t> &);
+
+}  // namespace benchmark
+
+}  // namespace deer
+
+#endif  // DEER_BENCHMARKS_BENCHMARK_H_
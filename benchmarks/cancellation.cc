@@ -0,0 +1,73 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include "../src/renderer.h"
+#include "../src/scene.h"
+#include "benchmark.h"
+#include "scenes.h"
+
+namespace deer {
+
+namespace benchmark {
+
+namespace {
+
+double SecondsBetween(std::chrono::steady_clock::time_point start,
+                      std::chrono::steady_clock::time_point end) {
+  return std::chrono::duration<double>(end - start).count();
+}
+
+}  // namespace
+
+// How long a job takes to hand back its threads after being cancelled,
+// and how closely it keeps to a time limit.
+DEER_BENCHMARK(JobCancellation) {
+  const Scene scene = MakeMixedScene(8);
+  const Camera camera = MakeCamera();
+
+  out << std::setw(12) << "cancel at, s"
+      << std::setw(14) << "stopped, s"
+      << std::setw(14) << "latency, ms" << '\n';
+  for (double cancel_at : {0.1, 0.5, 1.0}) {
+    RayTracer tracer(MakeOptions(640, 360));
+    const auto start = std::chrono::steady_clock::now();
+    auto job_status = tracer.Render(scene, camera);
+    std::this_thread::sleep_for(std::chrono::duration<double>(cancel_at));
+    const auto cancel_time = std::chrono::steady_clock::now();
+    job_status->cancel_requested = true;
+    job_status->result.wait();
+    const auto end = std::chrono::steady_clock::now();
+    out << std::setw(12) << cancel_at
+        << std::setw(14) << std::setprecision(3) << SecondsBetween(start, end)
+        << std::setw(14) << std::setprecision(3)
+        << SecondsBetween(cancel_time, end) * 1000 << '\n';
+  }
+
+  out << '\n' << std::setw(12) << "limit, s"
+      << std::setw(14) << "stopped, s"
+      << std::setw(14) << "passes done" << '\n';
+  for (double time_limit : {0.1, 0.5, 1.0}) {
+    auto options = MakeOptions(640, 360);
+    options.progressive = true;
+    options.time_limit = time_limit;
+    RayTracer tracer(options);
+    const auto start = std::chrono::steady_clock::now();
+    auto job_status = tracer.Render(scene, camera);
+    job_status->result.wait();
+    const auto end = std::chrono::steady_clock::now();
+    out << std::setw(12) << time_limit
+        << std::setw(14) << std::setprecision(3) << SecondsBetween(start, end)
+        << std::setw(9) << job_status->passes_done << " of "
+        << job_status->passes_total << '\n';
+  }
+}
+
+}  // namespace benchmark
+
+}  // namespace deer
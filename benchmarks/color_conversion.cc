@@ -0,0 +1,93 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "../src/color_conversion.h"
+#include "../src/framebuffer.h"
+#include "../src/renderer.h"
+#include "../src/rgb.h"
+#include "../src/scene.h"
+#include "benchmark.h"
+#include "scenes.h"
+
+namespace deer {
+
+namespace benchmark {
+
+DEER_BENCHMARK(ColorConversion) {
+  const std::size_t width = 1920, height = 1080;
+  const RgbColorProfile profile = MakeColorProfile();
+
+  Framebuffer framebuffer(width, height);
+  for (std::size_t row = 0; row < height; row++) {
+    for (std::size_t col = 0; col < width; col++) {
+      const double x = double(row * width + col) / (width * height);
+      framebuffer.Set(row, col, double3{x, 1.5 * x - 0.25, 1 - x});
+    }
+  }
+
+  std::vector<std::uint8_t> bytes(width * height * 3);
+  const double per_pixel_time = Time([&] {
+    for (std::size_t row = 0; row < height; row++) {
+      for (std::size_t col = 0; col < width; col++) {
+        auto rgb = profile.ToRgbBytes(profile.ToRgb(framebuffer.Get(row, col)));
+        std::uint8_t *p = &bytes[(row * width + col) * 3];
+        p[0] = rgb[0]; p[1] = rgb[1]; p[2] = rgb[2];
+      }
+    }
+  });
+
+  out << std::setw(24) << "conversion"
+      << std::setw(14) << "ms per 1080p" << '\n';
+  out << std::setw(24) << "per-pixel ToRgbBytes"
+      << std::setw(14) << std::setprecision(3) << per_pixel_time * 1e3 << '\n';
+
+  for (double gamma : {1.0, 2.2}) {
+    const ColorConverter converter(profile, gamma);
+    const double batched_time = Time([&] {
+      converter.Convert(framebuffer, PixelLayout::kBgr, bytes.data());
+    });
+    out << std::setw(19) << "batched, gamma " << std::setw(5) << gamma
+        << std::setw(14) << std::setprecision(3) << batched_time * 1e3
+        << '\n';
+  }
+  const std::pair<ToneMapping, const char *> tone_mappings[] = {
+    {ToneMapping::kReinhard, "batched, Reinhard"},
+    {ToneMapping::kAces, "batched, ACES"},
+  };
+  for (const auto &[tone_mapping, name] : tone_mappings) {
+    const ColorConverter converter(profile, 2.2, tone_mapping, 2);
+    const double batched_time = Time([&] {
+      converter.Convert(framebuffer, PixelLayout::kBgr, bytes.data());
+    });
+    out << std::setw(24) << name
+        << std::setw(14) << std::setprecision(3) << batched_time * 1e3
+        << '\n';
+  }
+
+  // The conversion share of a real render, and re-exposing it from the
+  // linear image instead of rendering it again.
+  auto options = MakeOptions(640, 360);
+  RayTracer tracer(options);
+  auto job_status = tracer.Render(MakeMixedScene(4), MakeCamera());
+  job_status->result.wait();
+  const ColorConverter reexposure(options.color_profile, 1,
+                                  ToneMapping::kReinhard, 0.5);
+  const double reexposure_time = Time([&] {
+    reexposure.Convert(job_status->image, options.pixel_layout);
+  });
+  out << "640x360 render: tracing "
+      << job_status->statistics.tracing_seconds * 1e3 << " ms, conversion "
+      << job_status->statistics.conversion_seconds * 1e3
+      << " ms, re-exposure " << reexposure_time * 1e3 << " ms\n";
+}
+
+}  // namespace benchmark
+
+}  // namespace deer
@@ -0,0 +1,49 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include <iomanip>
+#include <iostream>
+
+#include "../src/renderer.h"
+#include "../src/scene.h"
+#include "../src/scheduler.h"
+#include "benchmark.h"
+#include "scenes.h"
+
+namespace deer {
+
+namespace benchmark {
+
+// Re-rendering a region of a frame, against the whole frame.
+DEER_BENCHMARK(CropWindow) {
+  const Scene scene = MakeMixedScene(4);
+  const Camera camera = MakeCamera();
+  auto options = MakeOptions(1280, 720);
+  options.min_samples = options.max_samples = 4;
+
+  out << std::setw(20) << "region" << std::setw(10) << "seconds"
+      << std::setw(16) << "framebuffer, MB" << '\n';
+  auto run = [&](const char *name, const RayTracer::Options &run_options) {
+    RayTracer tracer(run_options);
+    std::size_t framebuffer_bytes = 0;
+    const double seconds = Time([&] {
+      auto job_status = tracer.Render(scene, camera);
+      job_status->result.wait();
+      framebuffer_bytes = job_status->image.size() * sizeof(float);
+    });
+    out << std::setw(20) << name
+        << std::setw(10) << std::setprecision(3) << seconds
+        << std::setw(16) << std::setprecision(3) << framebuffer_bytes / 1e6
+        << '\n';
+  };
+  run("full frame", options);
+  options.crop = Tile{270, 480, 180, 320};
+  run("crop, 1/16", options);
+  options.paste_crop = true;
+  run("crop, pasted", options);
+}
+
+}  // namespace benchmark
+
+}  // namespace deer
@@ -0,0 +1,69 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "../src/renderer.h"
+#include "../src/scene.h"
+#include "benchmark.h"
+#include "scenes.h"
+
+namespace deer {
+
+namespace benchmark {
+
+// Soft shadows from one shadow ray per sample, with and without the
+// denoiser, against a reference with many samples.
+DEER_BENCHMARK(Denoiser) {
+  Scene scene = MakeMixedScene(4);
+  for (const auto &light : scene.point_light_sources()) {
+    light->softness = 1.5;
+  }
+  const Camera camera = MakeCamera();
+
+  auto options = MakeOptions(320, 180);
+  options.n_threads = 1;
+  options.min_shadow_samples = options.max_shadow_samples = 1;
+
+  auto reference_options = options;
+  reference_options.min_samples = reference_options.max_samples = 1024;
+  RayTracer reference_tracer(reference_options);
+  const auto reference = RenderImage(reference_tracer, scene, camera);
+
+  out << std::setw(6) << "spp"
+      << std::setw(10) << "denoised"
+      << std::setw(12) << "tracing, s"
+      << std::setw(14) << "denoising, s"
+      << std::setw(8) << "RMSE" << '\n';
+  for (std::size_t spp : {1, 2, 4, 8, 16, 64}) {
+    for (bool denoise : {false, true}) {
+      auto run_options = options;
+      run_options.min_samples = run_options.max_samples = spp;
+      run_options.denoise = denoise;
+      RayTracer tracer(run_options);
+      std::vector<std::uint8_t> image;
+      Renderer::Statistics statistics;
+      Time([&] {
+        auto job_status = tracer.Render(scene, camera);
+        image = job_status->result.get();
+        statistics = job_status->statistics;
+      }, 1);
+      out << std::setw(6) << spp
+          << std::setw(10) << (denoise ? "yes" : "no")
+          << std::setw(12) << std::setprecision(3)
+          << statistics.tracing_seconds
+          << std::setw(14) << std::setprecision(3)
+          << statistics.denoising_seconds
+          << std::setw(8) << std::setprecision(3)
+          << RootMeanSquareError(image, reference) << '\n';
+    }
+  }
+}
+
+}  // namespace benchmark
+
+}  // namespace deer
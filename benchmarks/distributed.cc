@@ -0,0 +1,60 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../src/distributed.h"
+#include "../src/renderer.h"
+#include "../src/scene.h"
+#include "benchmark.h"
+#include "scenes.h"
+
+namespace deer {
+
+namespace benchmark {
+
+// Worker processes against the threads of one process, by region size;
+// the image must come out the same.
+DEER_BENCHMARK(DistributedTiles) {
+  const Scene scene = MakeMixedScene(4);
+  const Camera camera = MakeCamera();
+  auto options = MakeOptions(1280, 720);
+  options.min_samples = options.max_samples = 4;
+
+  std::vector<std::uint8_t> reference;
+  out << std::setw(20) << "renderer" << std::setw(8) << "region"
+      << std::setw(10) << "seconds" << std::setw(8) << "same" << '\n';
+  auto run = [&](const char *name, std::size_t region_size,
+                 Renderer *renderer) {
+    std::vector<std::uint8_t> image;
+    const double seconds = Time([&] {
+      image = renderer->Render(scene, camera)->result.get();
+    });
+    if (reference.empty()) reference = image;
+    out << std::setw(20) << name << std::setw(8) << region_size
+        << std::setw(10) << std::setprecision(3) << seconds
+        << std::setw(8) << (image == reference ? "yes" : "no") << '\n';
+  };
+  RayTracer tracer(options);
+  run("one process", 0, &tracer);
+  for (std::size_t n_workers : {1, 2, 4}) {
+    for (std::size_t region_size : {32, 64, 128}) {
+      DistributedRenderer::Options distributed_options;
+      distributed_options.n_workers = n_workers;
+      distributed_options.region_size = region_size;
+      DistributedRenderer renderer(options, distributed_options);
+      const std::string name = std::to_string(n_workers) + " workers";
+      run(name.c_str(), region_size, &renderer);
+    }
+  }
+}
+
+}  // namespace benchmark
+
+}  // namespace deer
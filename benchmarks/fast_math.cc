@@ -0,0 +1,140 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include <cmath>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "../src/fast_math.h"
+#include "../src/renderer.h"
+#include "../src/scene.h"
+#include "benchmark.h"
+#include "scenes.h"
+
+namespace deer {
+
+namespace benchmark {
+
+namespace {
+
+// Unnormalized normals and light directions, structure-of-arrays.
+struct ShadingInputs {
+  std::vector<float> nx, ny, nz, lx, ly, lz;
+
+  explicit ShadingInputs(std::size_t n)
+      : nx(n), ny(n), nz(n), lx(n), ly(n), lz(n) {
+    for (std::size_t i = 0; i < n; i++) {
+      const float t = 0.001f * i;
+      nx[i] = std::sin(t); ny[i] = 1 + std::cos(3 * t); nz[i] = 0.5f;
+      lx[i] = std::cos(t); ly[i] = 2; lz[i] = std::sin(2 * t) - 1;
+    }
+  }
+};
+
+// Diffuse plus Phong specular intensity of one light, scalar.
+template<MathAccuracy kAccuracy>
+float ShadeScalar(const ShadingInputs &in, std::size_t n, float shininess) {
+  using Math = FastMath<kAccuracy>;
+  float sum = 0;
+  for (std::size_t i = 0; i < n; i++) {
+    const float rn = Math::Rsqrt(in.nx[i]*in.nx[i] + in.ny[i]*in.ny[i] +
+                                 in.nz[i]*in.nz[i]);
+    const float rl = Math::Rsqrt(in.lx[i]*in.lx[i] + in.ly[i]*in.ly[i] +
+                                 in.lz[i]*in.lz[i]);
+    const float cos_nl = (in.nx[i]*in.lx[i] + in.ny[i]*in.ly[i] +
+                          in.nz[i]*in.lz[i]) * rn * rl;
+    // For unit vectors, cos(n, r) = 2 cos^2(n, l) - 1.
+    const float cos_nr = 2 * cos_nl * cos_nl - 1;
+    sum += cos_nl;
+    if (cos_nr > 0) sum += Math::Pow(cos_nr, shininess);
+  }
+  return sum;
+}
+
+#ifdef __SSE2__
+template<MathAccuracy kAccuracy>
+float ShadeSimd(const ShadingInputs &in, std::size_t n, float shininess) {
+  using Math = FastMath<kAccuracy>;
+  const __m128 y = _mm_set1_ps(shininess);
+  __m128 sum = _mm_setzero_ps();
+  for (std::size_t i = 0; i + 4 <= n; i += 4) {
+    const __m128 nx = _mm_loadu_ps(&in.nx[i]), lx = _mm_loadu_ps(&in.lx[i]);
+    const __m128 ny = _mm_loadu_ps(&in.ny[i]), ly = _mm_loadu_ps(&in.ly[i]);
+    const __m128 nz = _mm_loadu_ps(&in.nz[i]), lz = _mm_loadu_ps(&in.lz[i]);
+    auto dot = [](__m128 ax, __m128 ay, __m128 az,
+                  __m128 bx, __m128 by, __m128 bz) {
+      return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)),
+                        _mm_mul_ps(az, bz));
+    };
+    const __m128 rn = Math::Rsqrt(dot(nx, ny, nz, nx, ny, nz));
+    const __m128 rl = Math::Rsqrt(dot(lx, ly, lz, lx, ly, lz));
+    const __m128 cos_nl =
+        _mm_mul_ps(dot(nx, ny, nz, lx, ly, lz), _mm_mul_ps(rn, rl));
+    const __m128 cos_nr = _mm_sub_ps(
+        _mm_mul_ps(_mm_set1_ps(2), _mm_mul_ps(cos_nl, cos_nl)),
+        _mm_set1_ps(1));
+    const __m128 lit = _mm_cmpgt_ps(cos_nr, _mm_setzero_ps());
+    const __m128 safe = _mm_max_ps(cos_nr, _mm_set1_ps(1e-30f));
+    sum = _mm_add_ps(sum, cos_nl);
+    sum = _mm_add_ps(sum, _mm_and_ps(lit, Math::Pow(safe, y)));
+  }
+  alignas(16) float lanes[4];
+  _mm_store_ps(lanes, sum);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+#endif
+
+template<MathAccuracy kAccuracy>
+void ReportTier(std::ostream &out, const char *name,
+                const ShadingInputs &in, std::size_t n) {
+  volatile float sink;
+  const double scalar_time = Time([&] {
+    sink = ShadeScalar<kAccuracy>(in, n, 5);
+  });
+  out << std::setw(9) << name
+      << std::setw(14) << std::setprecision(4) << n / scalar_time / 1e6;
+#ifdef __SSE2__
+  const double simd_time = Time([&] {
+    sink = ShadeSimd<kAccuracy>(in, n, 5);
+  });
+  out << std::setw(14) << std::setprecision(4) << n / simd_time / 1e6;
+#endif
+  (void)sink;
+  out << '\n';
+}
+
+}  // namespace
+
+DEER_BENCHMARK(ShadingMathTiers) {
+  const std::size_t n = 1 << 20;
+  const ShadingInputs in(n);
+
+  out << std::setw(9) << "tier"
+      << std::setw(14) << "scalar, M/s"
+      << std::setw(14) << "SIMD, M/s" << '\n';
+  ReportTier<MathAccuracy::kExact>(out, "exact", in, n);
+  ReportTier<MathAccuracy::kFast>(out, "fast", in, n);
+  ReportTier<MathAccuracy::kFastest>(out, "fastest", in, n);
+
+  const Scene scene = MakeMixedScene(4);
+  const Camera camera = MakeCamera();
+  out << "\n640x360 render:\n";
+  for (auto [accuracy, name] : {
+      std::pair{MathAccuracy::kExact, "exact"},
+      std::pair{MathAccuracy::kFast, "fast"},
+      std::pair{MathAccuracy::kFastest, "fastest"}}) {
+    auto options = MakeOptions(640, 360);
+    options.math_accuracy = accuracy;
+    RayTracer tracer(options);
+    const double time = Time([&] { RenderImage(tracer, scene, camera); });
+    out << std::setw(9) << name
+        << std::setw(10) << std::setprecision(3) << time << " s\n";
+  }
+}
+
+}  // namespace benchmark
+
+}  // namespace deer
@@ -0,0 +1,84 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "../src/frame_sequence.h"
+#include "../src/renderer.h"
+#include "../src/scene.h"
+#include "benchmark.h"
+#include "scenes.h"
+
+namespace deer {
+
+namespace benchmark {
+
+// A slow sideways fly-through, every frame traced in full against frames
+// reprojected from the ones before.
+DEER_BENCHMARK(CameraFlyThrough) {
+  const Scene scene = MakeMixedScene(4);
+  const std::size_t n_frames = 24;
+  std::vector<Camera> cameras;
+  for (std::size_t frame = 0; frame < n_frames; frame++) {
+    cameras.push_back(MakeCamera());
+    cameras.back().transform.Translate(0.02 * frame, 0.01 * frame, 0);
+  }
+  auto options = MakeOptions(320, 180);
+  options.min_samples = 4;
+  options.max_samples = 16;
+
+  RayTracer tracer(options);
+  std::vector<std::vector<std::uint8_t>> references;
+  const double full_seconds = Time([&] {
+    references.clear();
+    for (const Camera &camera : cameras) {
+      references.push_back(RenderImage(tracer, scene, camera));
+    }
+  }, 1);
+  // The noise alone: the same frame with other random numbers.
+  auto reseeded_options = options;
+  reseeded_options.sample_seed = 1;
+  RayTracer reseeded_tracer(reseeded_options);
+  const double noise = RootMeanSquareError(
+      RenderImage(reseeded_tracer, scene, cameras[0]), references[0]);
+
+  out << "RMSE of another seed: " << std::setprecision(3) << noise << '\n'
+      << std::setw(10) << "refresh" << std::setw(10) << "seconds"
+      << std::setw(10) << "reused" << std::setw(12) << "mean RMSE"
+      << std::setw(12) << "max RMSE" << '\n'
+      << std::setw(10) << "every" << std::setw(10) << std::setprecision(3)
+      << full_seconds << std::setw(10) << 0 << std::setw(12) << 0
+      << std::setw(12) << 0 << '\n';
+
+  for (std::size_t refresh_interval : {8, 24}) {
+    FrameSequence::Options sequence_options;
+    sequence_options.refresh_interval = refresh_interval;
+    double reused = 0, mean_error = 0, max_error = 0;
+    const double seconds = Time([&] {
+      FrameSequence sequence(options, sequence_options);
+      reused = mean_error = max_error = 0;
+      for (std::size_t frame = 0; frame < n_frames; frame++) {
+        auto job_status = sequence.RenderFrame(scene, cameras[frame]);
+        const double error =
+            RootMeanSquareError(job_status->result.get(), references[frame]);
+        reused += job_status->statistics.reused_pixel_fraction / n_frames;
+        mean_error += error / n_frames;
+        max_error = std::max(max_error, error);
+      }
+    }, 1);
+    out << std::setw(10) << refresh_interval
+        << std::setw(10) << std::setprecision(3) << seconds
+        << std::setw(10) << std::setprecision(3) << reused
+        << std::setw(12) << std::setprecision(3) << mean_error
+        << std::setw(12) << std::setprecision(3) << max_error << '\n';
+  }
+}
+
+}  // namespace benchmark
+
+}  // namespace deer
@@ -0,0 +1,52 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include <iomanip>
+#include <iostream>
+
+#include "../src/compiled_scene.h"
+#include "../src/renderer.h"
+#include "../src/scene.h"
+#include "benchmark.h"
+#include "scenes.h"
+
+namespace deer {
+
+namespace benchmark {
+
+DEER_BENCHMARK(GeometryDispatch) {
+  const Camera camera = MakeCamera();
+
+  out << std::setw(8) << "objects"
+      << std::setw(12) << "virtual, s"
+      << std::setw(13) << "bucketed, s"
+      << std::setw(10) << "speedup" << '\n';
+
+  for (int n : {2, 4, 8}) {
+    const Scene scene = MakeMixedScene(n);
+
+    auto options = MakeOptions(320, 180);
+    options.geometry_dispatch = GeometryDispatch::kVirtual;
+    RayTracer virtual_tracer(options);
+    options.geometry_dispatch = GeometryDispatch::kBucketed;
+    RayTracer bucketed_tracer(options);
+
+    const double virtual_time = Time([&] {
+      RenderImage(virtual_tracer, scene, camera);
+    });
+    const double bucketed_time = Time([&] {
+      RenderImage(bucketed_tracer, scene, camera);
+    });
+
+    out << std::setw(8) << scene.objects().size()
+        << std::setw(12) << std::setprecision(3) << virtual_time
+        << std::setw(13) << std::setprecision(3) << bucketed_time
+        << std::setw(9) << std::setprecision(3)
+        << virtual_time / bucketed_time << "x\n";
+  }
+}
+
+}  // namespace benchmark
+
+}  // namespace deer
@@ -0,0 +1,90 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "../src/irradiance_cache.h"
+#include "../src/path_tracer.h"
+#include "../src/scene.h"
+#include "benchmark.h"
+#include "scenes.h"
+
+namespace deer {
+
+namespace benchmark {
+
+// Diffuse indirect light from brute-force paths and from an irradiance
+// cache, against a brute-force reference with many samples, and a second
+// frame of the same static scene that keeps the cache of the first.
+DEER_BENCHMARK(IrradianceCaching) {
+  const Scene scene = MakeMixedScene(4);
+  const Camera camera = MakeCamera();
+
+  PathTracer::Options options;
+  options.image_width = 160;
+  options.image_height = 90;
+  options.color_profile = MakeColorProfile();
+  options.n_threads = 1;
+  options.max_bounces = 3;
+
+  auto reference_options = options;
+  reference_options.samples_per_pixel = 1024;
+  PathTracer reference_tracer(reference_options);
+  const auto reference = RenderImage(reference_tracer, scene, camera);
+
+  out << std::setw(24) << "indirect light"
+      << std::setw(8) << "spp"
+      << std::setw(10) << "records"
+      << std::setw(12) << "seconds"
+      << std::setw(8) << "RMSE" << '\n';
+  auto report = [&](const char *name, std::size_t spp, std::size_t records,
+                    double seconds, const std::vector<std::uint8_t> &image) {
+    out << std::setw(24) << name
+        << std::setw(8) << spp
+        << std::setw(10) << records
+        << std::setw(12) << std::setprecision(3) << seconds
+        << std::setw(8) << std::setprecision(3)
+        << RootMeanSquareError(image, reference) << '\n';
+  };
+
+  for (std::size_t spp : {4, 16, 64}) {
+    auto brute_force_options = options;
+    brute_force_options.samples_per_pixel = spp;
+    PathTracer tracer(brute_force_options);
+    std::vector<std::uint8_t> image;
+    const double seconds = Time([&] {
+      image = RenderImage(tracer, scene, camera);
+    });
+    report("brute force", spp, 0, seconds, image);
+  }
+
+  for (double accuracy : {0.1, 0.2, 0.4}) {
+    auto cached_options = options;
+    cached_options.samples_per_pixel = 4;
+    cached_options.irradiance_cache =
+        std::make_shared<IrradianceCache>(accuracy);
+    PathTracer tracer(cached_options);
+    std::vector<std::uint8_t> image;
+    const double first_frame = Time([&] {
+      image = RenderImage(tracer, scene, camera);
+    }, 1);
+    const std::size_t records = cached_options.irradiance_cache->size();
+    out << "accuracy " << accuracy << ":\n";
+    report("cache, first frame", 4, records, first_frame, image);
+    const double next_frame = Time([&] {
+      image = RenderImage(tracer, scene, camera);
+    });
+    report("cache, next frames",
+           4, cached_options.irradiance_cache->size() - records,
+           next_frame, image);
+  }
+}
+
+}  // namespace benchmark
+
+}  // namespace deer
@@ -0,0 +1,13 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include <iostream>
+
+#include "benchmark.h"
+
+// Usage: benchmarks [name...]
+// Benchmarks are meaningful only in an optimized build.
+int main(int argc, char **argv) {
+  return deer::benchmark::RunBenchmarks(argv + 1, argv + argc, std::cout);
+}
@@ -0,0 +1,73 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../src/renderer.h"
+#include "../src/scene.h"
+#include "../src/spectrum.h"
+#include "benchmark.h"
+#include "scenes.h"
+
+namespace deer {
+
+namespace benchmark {
+
+// Light tree sampling against shading with every light, as the lights
+// of a ceiling grid get more numerous and dimmer. Shading with every
+// light of the largest grid takes too long, so it goes without a
+// reference.
+DEER_BENCHMARK(ManyLights) {
+  const Camera camera = MakeCamera();
+
+  out << std::setw(8) << "lights"
+      << std::setw(16) << "light samples"
+      << std::setw(10) << "time, s"
+      << std::setw(8) << "RMSE" << '\n';
+  for (int grid : {4, 16, 64}) {
+    const int n_lights = grid * grid;
+    Scene scene = MakeMixedScene(4);
+    for (int i = 0; i < n_lights; i++) {
+      scene.Add(std::make_shared<PointLightSource>(
+          double4{-8 + 16.0 * (i % grid + 0.5) / grid, 5,
+                  -10 + 20.0 * (i / grid + 0.5) / grid, 1},
+          Spectrum::MakeConstant(2.0 / n_lights)));
+    }
+
+    auto options = MakeOptions(160, 90);
+    options.min_samples = options.max_samples = 4;
+    std::vector<std::uint8_t> reference;
+    auto report = [&](std::size_t light_samples) {
+      options.light_samples = light_samples;
+      RayTracer tracer(options);
+      std::vector<std::uint8_t> image;
+      const double time = Time([&] {
+        image = RenderImage(tracer, scene, camera);
+      });
+      if (light_samples == 0) reference = image;
+      out << std::setw(8) << n_lights + 2
+          << std::setw(16)
+          << (light_samples ? std::to_string(light_samples) : "all")
+          << std::setw(10) << std::setprecision(3) << time;
+      if (!reference.empty()) {
+        out << std::setw(8) << std::setprecision(3)
+            << RootMeanSquareError(image, reference);
+      }
+      out << '\n';
+    };
+
+    if (n_lights <= 256) report(0);
+    for (std::size_t light_samples : {1, 4, 16}) report(light_samples);
+  }
+}
+
+}  // namespace benchmark
+
+}  // namespace deer
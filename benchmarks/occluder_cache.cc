@@ -0,0 +1,113 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include <array>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../src/geometry.h"
+#include "../src/optics.h"
+#include "../src/renderer.h"
+#include "../src/scene.h"
+#include "../src/spectrum.h"
+#include "../src/transform.h"
+#include "benchmark.h"
+#include "scenes.h"
+
+namespace deer {
+
+namespace benchmark {
+
+namespace {
+
+// A unit disc in the XY plane, as a fan of many triangles.
+std::shared_ptr<TrianglesGeometry> MakeDisc() {
+  constexpr int kTriangles = 64;
+  const double step = 2 * M_PI / kTriangles;
+  std::vector<std::array<double4, 3>> triangles;
+  for (int i = 0; i < kTriangles; i++) {
+    triangles.push_back({
+      double4{0, 0, 0, 1},
+      double4{std::cos(i * step), std::sin(i * step), 0, 1},
+      double4{std::cos((i + 1) * step), std::sin((i + 1) * step), 0, 1},
+    });
+  }
+  return std::make_shared<TrianglesGeometry>(triangles);
+}
+
+}  // namespace
+
+// Shadow rays with and without the per-thread occluder cache, on grids of
+// more and more objects, with a large ball or a disc of many triangles in
+// front of each light that shadows much of the scene.
+DEER_BENCHMARK(OccluderCache) {
+  const Camera camera = MakeCamera();
+  auto material = std::make_shared<Material>();
+  material->ambiance_spectrum = Spectrum::MakeConstant(1);
+  material->diffusion_spectrum = Spectrum::MakeConstant(1);
+  material->specular_spectrum = Spectrum::MakeConstant(0);
+  material->shininess = 0;
+
+  out << std::setw(8) << "objects"
+      << std::setw(8) << "lights"
+      << std::setw(10) << "occluder"
+      << std::setw(12) << "off, s"
+      << std::setw(12) << "on, s"
+      << std::setw(10) << "occluded"
+      << std::setw(10) << "hit rate" << '\n';
+  for (int n : {4, 8, 16}) {
+    for (double softness : {0.0, 1.0}) {
+      for (bool mesh : {false, true}) {
+        Scene scene = MakeMixedScene(n);
+        for (const auto &light : scene.point_light_sources()) {
+          light->softness = softness;
+          // Between the light and the scene, listed last.
+          const double4 &position = light->position;
+          std::shared_ptr<Geometry> occluder =
+              std::make_shared<UnitSphereGeometry>();
+          if (mesh) occluder = MakeDisc();
+          scene.Add(std::make_shared<GeometryObject>(
+              occluder, material,
+              AffineTransform().Scale(1.5).Translate(
+                  position[0] / 2, position[1] / 2, position[2] / 2)));
+        }
+
+        auto options = MakeOptions(320, 180);
+        options.n_threads = 1;
+        options.occluder_cache = false;
+        RayTracer uncached(options);
+        const double uncached_time = Time([&] {
+          uncached.Render(scene, camera)->result.wait();
+        });
+        options.occluder_cache = true;
+        RayTracer cached(options);
+        Renderer::Statistics statistics;
+        const double cached_time = Time([&] {
+          auto job_status = cached.Render(scene, camera);
+          job_status->result.wait();
+          statistics = job_status->statistics;
+        });
+
+        out << std::setw(8) << n * n + 4
+            << std::setw(8) << (softness > 0 ? "soft" : "hard")
+            << std::setw(10) << (mesh ? "mesh" : "ball")
+            << std::setw(12) << std::setprecision(3) << uncached_time
+            << std::setw(12) << std::setprecision(3) << cached_time
+            << std::setw(9) << std::setprecision(3)
+            << 100.0 * statistics.occluded_shadow_rays / statistics.shadow_rays
+            << '%'
+            << std::setw(9) << std::setprecision(3)
+            << 100 * statistics.occluder_cache_hit_rate() << "%\n";
+      }
+    }
+  }
+}
+
+}  // namespace benchmark
+
+}  // namespace deer
@@ -0,0 +1,52 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include <iomanip>
+#include <iostream>
+
+#include "../src/renderer.h"
+#include "../src/scene.h"
+#include "benchmark.h"
+#include "scenes.h"
+
+namespace deer {
+
+namespace benchmark {
+
+// The colour alone, the colour with all the output buffers from the same
+// paths, and the colour followed by one more render per buffer, as a
+// renderer without output buffers would need.
+DEER_BENCHMARK(OutputBuffers) {
+  const Scene scene = MakeMixedScene(4);
+  const Camera camera = MakeCamera();
+  auto options = MakeOptions(640, 360);
+  options.min_samples = options.max_samples = 4;
+
+  auto outputs_options = options;
+  outputs_options.output_depth = outputs_options.output_normal = true;
+  outputs_options.output_albedo = outputs_options.output_object_id = true;
+  outputs_options.output_hit_count = true;
+
+  RayTracer colour_tracer(options);
+  RayTracer outputs_tracer(outputs_options);
+  const double colour_seconds = Time([&] {
+    RenderImage(colour_tracer, scene, camera);
+  });
+  const double outputs_seconds = Time([&] {
+    RenderImage(outputs_tracer, scene, camera);
+  });
+  const std::size_t n_buffers = 5;
+
+  out << std::setw(28) << "render" << std::setw(12) << "seconds" << '\n'
+      << std::setw(28) << "colour" << std::setw(12)
+      << std::setprecision(3) << colour_seconds << '\n'
+      << std::setw(28) << "colour + buffers, one pass" << std::setw(12)
+      << std::setprecision(3) << outputs_seconds << '\n'
+      << std::setw(28) << "colour + buffers, 6 passes" << std::setw(12)
+      << std::setprecision(3) << colour_seconds * (1 + n_buffers) << '\n';
+}
+
+}  // namespace benchmark
+
+}  // namespace deer
@@ -0,0 +1,91 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../src/path_tracer.h"
+#include "../src/renderer.h"
+#include "../src/scene.h"
+#include "benchmark.h"
+#include "scenes.h"
+
+namespace deer {
+
+namespace benchmark {
+
+namespace {
+
+PathTracer::Options MakePathTracerOptions(std::size_t width,
+                                          std::size_t height) {
+  PathTracer::Options options;
+  options.image_width = width;
+  options.image_height = height;
+  options.color_profile = MakeColorProfile();
+  return options;
+}
+
+Renderer::Statistics RenderStatistics(Renderer &renderer, const Scene &scene,
+                                      const Camera &camera) {
+  auto job_status = renderer.Render(scene, camera);
+  job_status->result.wait();
+  return job_status->statistics;
+}
+
+}  // namespace
+
+// Path tracing throughput by thread count and path length.
+DEER_BENCHMARK(PathTracerScaling) {
+  const Scene scene = MakeMixedScene(4);
+  const Camera camera = MakeCamera();
+
+  std::vector<std::size_t> thread_counts = {1, 2, 4};
+  const std::size_t n_hardware = std::thread::hardware_concurrency();
+  if (n_hardware > 4) thread_counts.push_back(n_hardware);
+  out << "hardware threads: " << n_hardware << "\n\n";
+
+  out << std::setw(8) << "threads"
+      << std::setw(16) << "samples/s"
+      << std::setw(10) << "speedup" << '\n';
+  double single_thread_rate = 0;
+  for (std::size_t n_threads : thread_counts) {
+    auto options = MakePathTracerOptions(320, 180);
+    options.n_threads = n_threads;
+    PathTracer tracer(options);
+    const double rate =
+        RenderStatistics(tracer, scene, camera).samples_per_second();
+    if (n_threads == 1) single_thread_rate = rate;
+    out << std::setw(8) << n_threads
+        << std::setw(16) << std::setprecision(4) << rate
+        << std::setw(9) << std::setprecision(3)
+        << rate / single_thread_rate << "x\n";
+  }
+
+  out << '\n' << std::setw(8) << "bounces"
+      << std::setw(16) << "samples/s" << '\n';
+  for (std::size_t max_bounces : {0, 1, 2, 4, 8}) {
+    auto options = MakePathTracerOptions(320, 180);
+    options.n_threads = 1;
+    options.max_bounces = max_bounces;
+    PathTracer tracer(options);
+    out << std::setw(8) << max_bounces
+        << std::setw(16) << std::setprecision(4)
+        << RenderStatistics(tracer, scene, camera).samples_per_second()
+        << '\n';
+  }
+
+  auto ray_tracer_options = MakeOptions(320, 180);
+  ray_tracer_options.n_threads = 1;
+  ray_tracer_options.min_samples = ray_tracer_options.max_samples = 16;
+  RayTracer ray_tracer(ray_tracer_options);
+  out << "\nRayTracer, 16 samples: " << std::setprecision(4)
+      << RenderStatistics(ray_tracer, scene, camera).samples_per_second()
+      << " samples/s\n";
+}
+
+}  // namespace benchmark
+
+}  // namespace deer
@@ -0,0 +1,73 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../src/renderer.h"
+#include "../src/scene.h"
+#include "benchmark.h"
+#include "scenes.h"
+
+namespace deer {
+
+namespace benchmark {
+
+// Time until the first pass gives a complete (if blocky) image, and
+// until the final image is ready, against a plain render.
+DEER_BENCHMARK(ProgressiveRendering) {
+  const Scene scene = MakeMixedScene(8);
+  const Camera camera = MakeCamera();
+
+  out << std::setw(8) << "stride"
+      << std::setw(8) << "passes"
+      << std::setw(16) << "first pass, s"
+      << std::setw(10) << "total, s"
+      << std::setw(12) << "snapshot, s" << '\n';
+
+  for (std::size_t stride : {1, 4, 16}) {
+    auto options = MakeOptions(640, 360);
+    options.progressive = stride > 1;
+    options.progressive_stride = stride;
+    RayTracer tracer(options);
+
+    double first_pass = 0, total = 0, snapshot = 0;
+    std::size_t passes = 0;
+    for (int i = 0; i < 3; i++) {
+      const auto start = std::chrono::steady_clock::now();
+      auto job_status = tracer.Render(scene, camera);
+      while (job_status->passes_done == 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      }
+      const auto first_pass_end = std::chrono::steady_clock::now();
+      std::vector<std::uint8_t> image = job_status->snapshot();
+      const auto snapshot_end = std::chrono::steady_clock::now();
+      job_status->result.wait();
+      const auto end = std::chrono::steady_clock::now();
+
+      const std::chrono::duration<double> d1 = first_pass_end - start;
+      const std::chrono::duration<double> d2 = end - start;
+      const std::chrono::duration<double> d3 = snapshot_end - first_pass_end;
+      if (i == 0 || d2.count() < total) {
+        first_pass = d1.count();
+        total = d2.count();
+        snapshot = d3.count();
+      }
+      passes = job_status->passes_total;
+    }
+
+    out << std::setw(8) << stride
+        << std::setw(8) << passes
+        << std::setw(16) << std::setprecision(3) << first_pass
+        << std::setw(10) << std::setprecision(3) << total
+        << std::setw(12) << std::setprecision(3) << snapshot << '\n';
+  }
+}
+
+}  // namespace benchmark
+
+}  // namespace deer
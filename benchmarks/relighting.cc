@@ -0,0 +1,61 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include <iomanip>
+#include <iostream>
+
+#include "../src/relighter.h"
+#include "../src/renderer.h"
+#include "../src/scene.h"
+#include "benchmark.h"
+#include "scenes.h"
+
+namespace deer {
+
+namespace benchmark {
+
+// Moving a light and rendering again, from scratch against from the
+// cached camera ray hits.
+DEER_BENCHMARK(Relighting) {
+  const Camera camera = MakeCamera();
+  out << std::setw(8) << "scene" << std::setw(6) << "spp"
+      << std::setw(16) << "traced, s" << std::setw(16) << "relit, s"
+      << std::setw(16) << "first, s" << '\n';
+  for (int n : {4, 8}) {
+    Scene scene = MakeMixedScene(n);
+    for (std::size_t spp : {1, 4}) {
+      auto options = MakeOptions(640, 360);
+      options.min_samples = options.max_samples = spp;
+      RayTracer tracer(options);
+      Relighter relighter(options);
+
+      const double first_seconds = Time([&] {
+        relighter.Render(scene, camera)->result.wait();
+      }, 1);
+      auto &light = scene.point_light_sources()[0]->position;
+      double step = 0.5;
+      auto move_light = [&] {
+        light += double4{step, 0, 0, 0};
+        step = -step;
+      };
+      const double traced_seconds = Time([&] {
+        move_light();
+        RenderImage(tracer, scene, camera);
+      });
+      const double relit_seconds = Time([&] {
+        move_light();
+        relighter.Render(scene, camera)->result.wait();
+      });
+      out << std::setw(5) << n << 'x' << std::setw(2) << n
+          << std::setw(6) << spp
+          << std::setw(16) << std::setprecision(3) << traced_seconds
+          << std::setw(16) << std::setprecision(3) << relit_seconds
+          << std::setw(16) << std::setprecision(3) << first_seconds << '\n';
+    }
+  }
+}
+
+}  // namespace benchmark
+
+}  // namespace deer
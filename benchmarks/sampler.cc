@@ -0,0 +1,123 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "../src/renderer.h"
+#include "../src/sampler.h"
+#include "../src/scene.h"
+#include "benchmark.h"
+#include "scenes.h"
+
+namespace deer {
+
+namespace benchmark {
+
+namespace {
+
+const std::pair<SampleSequence, const char *> kSequences[] = {
+  {SampleSequence::kRandom, "random"},
+  {SampleSequence::kSobol, "sobol"},
+  {SampleSequence::kBlueNoise, "blue noise"},
+};
+
+}  // namespace
+
+// Error of estimating, per pixel, the covered area of a disk edge (like
+// anti-aliasing an edge) and a smooth integrand, and then of anti-aliasing
+// a render, against a 256 sample kRandom reference.
+DEER_BENCHMARK(SamplerConvergence) {
+  const std::size_t n_pixels = 64 * 64;
+  const double pi = std::acos(-1);
+
+  out << std::setw(12) << "sequence"
+      << std::setw(10) << "samples"
+      << std::setw(14) << "edge RMSE"
+      << std::setw(14) << "smooth RMSE" << '\n';
+  for (auto [sequence, name] : kSequences) {
+    const Sampler sampler(sequence, 64);
+    for (std::size_t n_samples : {1, 4, 16, 64, 256}) {
+      double edge_error = 0, smooth_error = 0;
+      for (std::size_t pixel = 0; pixel < n_pixels; pixel++) {
+        // A disk of radius 2 with its centre at a different distance from
+        // every pixel, so that its edge crosses the pixel at some angle.
+        const double angle = pixel * 2.39996;
+        const double cx = 0.5 + 2 * std::cos(angle) + 0.3 * std::sin(pixel);
+        const double cy = 0.5 + 2 * std::sin(angle);
+        double edge = 0, smooth = 0;
+        for (std::size_t sample = 0; sample < n_samples; sample++) {
+          const double2 p = sampler.Get2D(pixel, sample, 0);
+          edge += std::pow(p[0] - cx, 2) + std::pow(p[1] - cy, 2) < 4;
+          smooth += std::sin(pi * p[0]) * std::sin(pi * p[1]);
+        }
+        edge /= n_samples;
+        smooth /= n_samples;
+        // The exact coverage, by dense midpoint integration.
+        double exact_edge = 0;
+        const int n = 256;
+        for (int i = 0; i < n; i++) {
+          for (int j = 0; j < n; j++) {
+            exact_edge += std::pow((i + 0.5) / n - cx, 2) +
+                          std::pow((j + 0.5) / n - cy, 2) < 4;
+          }
+        }
+        exact_edge /= n * n;
+        edge_error += std::pow(edge - exact_edge, 2);
+        smooth_error += std::pow(smooth - 4 / (pi * pi), 2);
+      }
+      out << std::setw(12) << name
+          << std::setw(10) << n_samples
+          << std::setw(14) << std::setprecision(3)
+          << std::sqrt(edge_error / n_pixels)
+          << std::setw(14) << std::setprecision(3)
+          << std::sqrt(smooth_error / n_pixels) << '\n';
+    }
+  }
+
+  out << '\n' << std::setw(12) << "sequence"
+      << std::setw(16) << "ns per number" << '\n';
+  for (auto [sequence, name] : kSequences) {
+    const Sampler sampler(sequence, 64);
+    double sum = 0;
+    const std::size_t n = 1 << 22;
+    const double time = Time([&] {
+      for (std::size_t i = 0; i < n; i++) sum += sampler.Get(i >> 6, i & 63, 1);
+    });
+    out << std::setw(12) << name
+        << std::setw(16) << std::setprecision(3) << time / n * 1e9
+        << (sum < 0 ? "!" : "") << '\n';
+  }
+
+  const Scene scene = MakeMixedScene(4);
+  const Camera camera = MakeCamera();
+  auto options = MakeOptions(160, 90);
+  options.sample_sequence = SampleSequence::kRandom;
+  options.min_samples = options.max_samples = 256;
+  RayTracer reference_tracer(options);
+  const auto reference = RenderImage(reference_tracer, scene, camera);
+
+  out << "\n160x90 render:\n" << std::setw(12) << "sequence"
+      << std::setw(10) << "samples"
+      << std::setw(8) << "RMSE" << '\n';
+  for (auto [sequence, name] : kSequences) {
+    for (std::size_t n_samples : {4, 16}) {
+      options.sample_sequence = sequence;
+      options.min_samples = options.max_samples = n_samples;
+      RayTracer tracer(options);
+      out << std::setw(12) << name
+          << std::setw(10) << n_samples
+          << std::setw(8) << std::setprecision(3)
+          << RootMeanSquareError(RenderImage(tracer, scene, camera),
+                                 reference) << '\n';
+    }
+  }
+}
+
+}  // namespace benchmark
+
+}  // namespace deer
@@ -0,0 +1,149 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "scenes.h"
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "../src/geometry.h"
+#include "../src/optics.h"
+#include "../src/renderer.h"
+#include "../src/rgb.h"
+#include "../src/scene.h"
+#include "../src/spectrum.h"
+#include "../src/transform.h"
+
+namespace deer {
+
+namespace benchmark {
+
+RgbColorProfile MakeColorProfile() {
+  RgbColorProfile profile;
+  profile.wavelengths = double3{2, 1, 0};
+  profile.min_intensities = double3{0, 0, 0};
+  profile.max_intensities = double3{1, 1, 1};
+  return profile;
+}
+
+RayTracer::Options MakeOptions(std::size_t width, std::size_t height) {
+  RayTracer::Options options;
+  options.image_width = width;
+  options.image_height = height;
+  options.color_profile = MakeColorProfile();
+  return options;
+}
+
+std::shared_ptr<Geometry> MakePyramid(int n_vert) {
+  std::vector<std::array<double4, 3>> triangles;
+  const double PI = std::acos(-1);
+  double4 peak{0, 1, 0, 1};
+  for (int i = 0; i < n_vert; i++) {
+    double alpha1 = PI*2 * i / n_vert;
+    double alpha2 = PI*2 * (i+1) / n_vert;
+    double4 a1 = double4{std::cos(alpha1), 0, std::sin(alpha1), 1};
+    double4 a2 = double4{std::cos(alpha2), 0, std::sin(alpha2), 1};
+    triangles.push_back({peak, a1, a2});
+  }
+  return std::make_shared<TrianglesGeometry>(std::move(triangles));
+}
+
+Scene MakeMixedScene(int n) {
+  Scene scene;
+
+  auto white_spectrum = Spectrum::MakeConstant(1);
+
+  auto shiny_material = std::make_shared<Material>();
+  shiny_material->ambiance_spectrum = Spectrum::MakeMonochrome(2, 0.5, 1);
+  shiny_material->diffusion_spectrum = Spectrum::MakeMonochrome(2, 0.5, 1);
+  shiny_material->specular_spectrum = white_spectrum;
+  shiny_material->shininess = 5;
+
+  auto matte_material = std::make_shared<Material>();
+  matte_material->ambiance_spectrum = white_spectrum;
+  matte_material->diffusion_spectrum = white_spectrum;
+  matte_material->specular_spectrum = Spectrum::MakeConstant(0);
+  matte_material->shininess = 0;
+
+  auto sphere_geometry = std::make_shared<UnitSphereGeometry>();
+  auto pyramid_geometry = MakePyramid();
+
+  const double spacing = 8.0 / n;
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < n; j++) {
+      const double x = -4 + spacing * (i + 0.5);
+      const double z = spacing * j;
+      const double size = spacing * 0.4;
+      if ((i + j) % 2 == 0) {
+        scene.Add(std::make_shared<GeometryObject>(
+            sphere_geometry, shiny_material,
+            AffineTransform().Scale(size).Translate(x, -2 + size, z)));
+      } else {
+        scene.Add(std::make_shared<GeometryObject>(
+            pyramid_geometry, matte_material,
+            AffineTransform().Scale(size, 2 * size, size)
+                .Translate(x, -2, z)));
+      }
+    }
+  }
+
+  scene.Add(std::make_shared<GeometryObject>(
+      std::make_shared<XYPlaneGeometry>(), matte_material,
+      AffineTransform().RotateX(std::acos(0)).Translate(0, -2, 0)));
+  scene.Add(std::make_shared<GeometryObject>(
+      std::make_shared<XYPlaneGeometry>(), matte_material,
+      AffineTransform().Translate(0, 0, 10)));
+
+  scene.ambiance_spectrum = Spectrum::MakeConstant(0.2);
+  scene.Add(std::make_shared<PointLightSource>(
+      double4{-5, 3, -5, 1}, Spectrum::MakeConstant(0.5)));
+  scene.Add(std::make_shared<PointLightSource>(
+      double4{5, 3, -5, 1}, Spectrum::MakeConstant(0.5)));
+
+  return scene;
+}
+
+Scene MakeUnevenScene(int n) {
+  Scene scene;
+
+  auto material = std::make_shared<Material>();
+  material->ambiance_spectrum = Spectrum::MakeConstant(1);
+  material->diffusion_spectrum = Spectrum::MakeConstant(1);
+  material->specular_spectrum = Spectrum::MakeConstant(1);
+  material->shininess = 10;
+
+  auto pyramid_geometry = MakePyramid(16);
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < n; j++) {
+      scene.Add(std::make_shared<GeometryObject>(
+          pyramid_geometry, material,
+          AffineTransform().Scale(2.0 / n)
+              .Translate(-8 + 4.0 * i / n, 2 + 3.0 * j / n, 0)));
+    }
+  }
+
+  scene.ambiance_spectrum = Spectrum::MakeConstant(0.2);
+  scene.Add(std::make_shared<PointLightSource>(
+      double4{-5, 3, -5, 1}, Spectrum::MakeConstant(0.5)));
+
+  return scene;
+}
+
+Camera MakeCamera() {
+  Camera camera(16.0 / 9.0, 1, 2);
+  camera.transform.Translate(0, 0, -10);
+  return camera;
+}
+
+std::vector<std::uint8_t> RenderImage(Renderer &renderer, const Scene &scene,
+                                      const Camera &camera) {
+  return renderer.Render(scene, camera)->result.get();
+}
+
+}  // namespace benchmark
+
+}  // namespace deer
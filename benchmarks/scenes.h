@@ -0,0 +1,47 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#ifndef DEER_BENCHMARKS_SCENES_H_
+#define DEER_BENCHMARKS_SCENES_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "../src/geometry.h"
+#include "../src/renderer.h"
+#include "../src/rgb.h"
+#include "../src/scene.h"
+
+namespace deer {
+
+namespace benchmark {
+
+RgbColorProfile MakeColorProfile();
+
+RayTracer::Options MakeOptions(std::size_t width, std::size_t height);
+
+std::shared_ptr<Geometry> MakePyramid(int n_vert = 8);
+
+// A grid of n*n objects alternating between spheres and pyramids,
+// standing on a floor plane in front of a wall plane, lit by two lights.
+Scene MakeMixedScene(int n);
+
+// A dense cluster of small pyramids in the upper left of the view and
+// nothing but sky elsewhere, so that the cost per pixel is very uneven.
+Scene MakeUnevenScene(int n);
+
+// A camera looking at the scene from the front, as in main.cc.
+Camera MakeCamera();
+
+// Runs a job to completion and returns the image.
+std::vector<std::uint8_t> RenderImage(Renderer &, const Scene &,
+                                      const Camera &);
+
+}  // namespace benchmark
+
+}  // namespace deer
+
+#endif  // DEER_BENCHMARKS_SCENES_H_
@@ -0,0 +1,163 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include <time.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../src/renderer.h"
+#include "../src/scene.h"
+#include "../src/scheduler.h"
+#include "benchmark.h"
+#include "scenes.h"
+
+namespace deer {
+
+namespace benchmark {
+
+namespace {
+
+double ThreadCpuSeconds() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Spins for about `units` units of work.
+double Spin(std::size_t units) {
+  volatile double x = 0;
+  for (std::size_t i = 0; i < units * 1000; i++) x = x + 1e-9;
+  return x;
+}
+
+}  // namespace
+
+// Load balance measured in per-thread CPU time, so that it is meaningful
+// even with fewer cores than threads: the busiest thread bounds the wall
+// time of a run on enough cores.
+DEER_BENCHMARK(TileLoadBalance) {
+  const std::size_t width = 640, height = 360;
+  const auto tiles = MakeTiles(width, height, 16, TileOrder::kMorton);
+
+  out << std::setw(8) << "threads"
+      << std::setw(10) << "stealing"
+      << std::setw(16) << "busiest, s"
+      << std::setw(16) << "ideal, s"
+      << std::setw(12) << "imbalance" << '\n';
+
+  for (std::size_t n_threads : {2, 4, 8, 16}) {
+    for (bool work_stealing : {false, true}) {
+      TileScheduler scheduler(n_threads, work_stealing);
+      std::vector<double> busy(n_threads);
+      scheduler.Run(tiles, [&](const Tile &tile, std::size_t thread) {
+        const double start = ThreadCpuSeconds();
+        // Only the upper left quarter of the image is expensive.
+        const bool heavy = tile.row < height / 2 && tile.col < width / 2;
+        Spin(heavy ? 400 : 10);
+        busy[thread] += ThreadCpuSeconds() - start;
+      });
+
+      double total = 0, busiest = 0;
+      for (double b : busy) {
+        total += b;
+        busiest = std::max(busiest, b);
+      }
+      const double ideal = total / n_threads;
+      out << std::setw(8) << n_threads
+          << std::setw(10) << (work_stealing ? "yes" : "no")
+          << std::setw(16) << std::setprecision(3) << busiest
+          << std::setw(16) << std::setprecision(3) << ideal
+          << std::setw(11) << std::setprecision(3) << busiest / ideal
+          << "x\n";
+    }
+  }
+}
+
+// What a run costs over the work of its tiles, as paid by every pass of
+// a progressive render and by every frame of a sequence.
+DEER_BENCHMARK(TileRunOverhead) {
+  const auto tiles = MakeTiles(640, 360, 16, TileOrder::kMorton);
+  const std::size_t n_runs = 2000;
+
+  out << std::setw(8) << "threads"
+      << std::setw(14) << "per run, us" << '\n';
+  for (std::size_t n_threads : {1, 2, 4, 8}) {
+    TileScheduler scheduler(n_threads);
+    const double time = Time([&] {
+      for (std::size_t run = 0; run < n_runs; run++) {
+        scheduler.Run(tiles, [](const Tile &, std::size_t) {});
+      }
+    });
+    out << std::setw(8) << n_threads
+        << std::setw(14) << std::setprecision(3) << time / n_runs * 1e6
+        << '\n';
+  }
+}
+
+DEER_BENCHMARK(TileScheduling) {
+  const Scene scene = MakeUnevenScene(6);
+  const Camera camera = MakeCamera();
+
+  std::vector<std::size_t> thread_counts = {1, 2, 4};
+  const std::size_t n_hardware = std::thread::hardware_concurrency();
+  if (n_hardware > 4) thread_counts.push_back(n_hardware);
+  out << "hardware threads: " << n_hardware << "\n\n";
+
+  out << std::setw(8) << "threads"
+      << std::setw(10) << "stealing"
+      << std::setw(10) << "time, s"
+      << std::setw(10) << "speedup"
+      << std::setw(8) << "stolen" << '\n';
+
+  double single_thread_time = 0;
+  for (std::size_t n_threads : thread_counts) {
+    for (bool work_stealing : {false, true}) {
+      auto options = MakeOptions(640, 360);
+      options.n_threads = n_threads;
+      options.work_stealing = work_stealing;
+      RayTracer tracer(options);
+
+      Renderer::Statistics statistics;
+      const double time = Time([&] {
+        auto job_status = tracer.Render(scene, camera);
+        job_status->result.wait();
+        statistics = job_status->statistics;
+      });
+      if (n_threads == 1 && !work_stealing) single_thread_time = time;
+
+      out << std::setw(8) << n_threads
+          << std::setw(10) << (work_stealing ? "yes" : "no")
+          << std::setw(10) << std::setprecision(3) << time
+          << std::setw(9) << std::setprecision(3)
+          << single_thread_time / time << "x"
+          << std::setw(8) << statistics.tiles_stolen << '\n';
+    }
+  }
+
+  out << '\n' << std::setw(10) << "order"
+      << std::setw(8) << "tile"
+      << std::setw(10) << "time, s" << '\n';
+  for (auto [order, name] : {std::pair{TileOrder::kScanline, "scanline"},
+                             std::pair{TileOrder::kMorton, "morton"},
+                             std::pair{TileOrder::kSpiral, "spiral"}}) {
+    for (std::size_t tile_size : {8, 16, 32}) {
+      auto options = MakeOptions(640, 360);
+      options.tile_order = order;
+      options.tile_size = tile_size;
+      RayTracer tracer(options);
+      const double time = Time([&] { RenderImage(tracer, scene, camera); });
+      out << std::setw(10) << name
+          << std::setw(8) << tile_size
+          << std::setw(10) << std::setprecision(3) << time << '\n';
+    }
+  }
+}
+
+}  // namespace benchmark
+
+}  // namespace deer
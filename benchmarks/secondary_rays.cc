@@ -0,0 +1,96 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../src/geometry.h"
+#include "../src/optics.h"
+#include "../src/renderer.h"
+#include "../src/scene.h"
+#include "../src/spectrum.h"
+#include "../src/transform.h"
+#include "benchmark.h"
+#include "scenes.h"
+
+namespace deer {
+
+namespace benchmark {
+
+// Fixed-depth secondary rays against a weight threshold and Russian
+// roulette, between two mirrors around a glass sphere, where paths
+// bounce for a long time. The reference goes the whole 16 bounces.
+DEER_BENCHMARK(SecondaryRays) {
+  auto mirror = std::make_shared<Material>();
+  mirror->ambiance_spectrum = Spectrum::MakeMonochrome(2, 0.5, 1);
+  mirror->diffusion_spectrum = Spectrum::MakeMonochrome(2, 0.5, 1);
+  mirror->specular_spectrum = Spectrum::MakeConstant(0);
+  mirror->shininess = 0;
+  mirror->reflectivity = 0.9;
+
+  auto glass = std::make_shared<Material>();
+  glass->ambiance_spectrum = Spectrum::MakeConstant(0.1);
+  glass->diffusion_spectrum = Spectrum::MakeConstant(0.1);
+  glass->specular_spectrum = Spectrum::MakeConstant(1);
+  glass->shininess = 8;
+  glass->reflectivity = 0.1;
+  glass->transparency = 0.8;
+  glass->refractive_index = 1.5;
+
+  Scene scene = MakeMixedScene(4);
+  scene.Add(std::make_shared<GeometryObject>(
+      std::make_shared<UnitSphereGeometry>(), glass,
+      AffineTransform().Scale(1.5).Translate(0, 0, -3)));
+  for (double x : {-6.0, 6.0}) {
+    scene.Add(std::make_shared<GeometryObject>(
+        std::make_shared<XYPlaneGeometry>(), mirror,
+        AffineTransform().RotateY(std::acos(0)).Translate(x, 0, 0)));
+  }
+  const Camera camera = MakeCamera();
+
+  auto options = MakeOptions(320, 180);
+  options.max_bounces = 16;
+  options.path_weight_threshold = 0;
+  RayTracer reference_tracer(options);
+  const auto reference = RenderImage(reference_tracer, scene, camera);
+
+  out << std::setw(24) << "mode"
+      << std::setw(10) << "time, s"
+      << std::setw(8) << "RMSE" << '\n';
+  auto report = [&](const std::string &name, std::size_t max_bounces,
+                    double threshold, bool russian_roulette) {
+    options.max_bounces = max_bounces;
+    options.path_weight_threshold = threshold;
+    options.russian_roulette = russian_roulette;
+    RayTracer tracer(options);
+    std::vector<std::uint8_t> image;
+    const double time = Time([&] {
+      image = RenderImage(tracer, scene, camera);
+    });
+    out << std::setw(24) << name
+        << std::setw(10) << std::setprecision(3) << time
+        << std::setw(8) << std::setprecision(3)
+        << RootMeanSquareError(image, reference) << '\n';
+  };
+
+  for (std::size_t max_bounces : {0, 1, 2, 4, 8, 16}) {
+    report("depth " + std::to_string(max_bounces), max_bounces, 0, false);
+  }
+  for (double threshold : {0.02, 0.05, 0.1}) {
+    std::ostringstream name;
+    name << "threshold " << threshold;
+    report(name.str(), 16, threshold, false);
+    name << ", roulette";
+    report(name.str(), 16, threshold, true);
+  }
+}
+
+}  // namespace benchmark
+
+}  // namespace deer
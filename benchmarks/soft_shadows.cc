@@ -0,0 +1,59 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/renderer.h"
+#include "../src/scene.h"
+#include "benchmark.h"
+#include "scenes.h"
+
+namespace deer {
+
+namespace benchmark {
+
+// Adaptive shadow sampling against a fixed number of shadow rays per
+// light, for soft lights. The reference takes 64 rays everywhere.
+DEER_BENCHMARK(SoftShadows) {
+  Scene scene = MakeMixedScene(4);
+  for (const auto &light : scene.point_light_sources()) light->softness = 1;
+  const Camera camera = MakeCamera();
+
+  auto options = MakeOptions(320, 180);
+  options.min_shadow_samples = options.max_shadow_samples = 64;
+  RayTracer reference_tracer(options);
+  const auto reference = RenderImage(reference_tracer, scene, camera);
+
+  out << std::setw(16) << "shadow rays"
+      << std::setw(10) << "time, s"
+      << std::setw(8) << "RMSE" << '\n';
+  auto report = [&](const std::string &name, std::size_t min_samples,
+                    std::size_t max_samples) {
+    options.min_shadow_samples = min_samples;
+    options.max_shadow_samples = max_samples;
+    RayTracer tracer(options);
+    std::vector<std::uint8_t> image;
+    const double time = Time([&] {
+      image = RenderImage(tracer, scene, camera);
+    });
+    out << std::setw(16) << name
+        << std::setw(10) << std::setprecision(3) << time
+        << std::setw(8) << std::setprecision(3)
+        << RootMeanSquareError(image, reference) << '\n';
+  };
+
+  report("1", 1, 1);
+  report("16", 16, 16);
+  report("2 to 16", 2, 16);
+  report("4 to 16", 4, 16);
+  report("2 to 64", 2, 64);
+}
+
+}  // namespace benchmark
+
+}  // namespace deer
@@ -0,0 +1,74 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/renderer.h"
+#include "../src/scene.h"
+#include "../src/spectral_sampling.h"
+#include "benchmark.h"
+#include "scenes.h"
+
+namespace deer {
+
+namespace benchmark {
+
+// Convergence of hero-wavelength sampling towards a dense-bin reference.
+DEER_BENCHMARK(HeroWavelengthConvergence) {
+  const Scene scene = MakeMixedScene(4);
+  const Camera camera = MakeCamera();
+
+  auto options = MakeOptions(320, 180);
+  options.spectral_sampling = SpectralSampling::kDense;
+  options.spectral_bins = 256;
+  RayTracer reference_tracer(options);
+  std::vector<std::uint8_t> reference;
+  const double reference_time = Time([&] {
+    reference = RenderImage(reference_tracer, scene, camera);
+  }, 1);
+
+  out << std::setw(22) << "mode"
+      << std::setw(13) << "wavelengths"
+      << std::setw(10) << "time, s"
+      << std::setw(8) << "RMSE" << '\n';
+  out << std::setw(22) << "dense"
+      << std::setw(13) << options.spectral_bins
+      << std::setw(10) << std::setprecision(3) << reference_time
+      << std::setw(8) << 0.0 << '\n';
+
+  auto report = [&](const char *name, const RayTracer::Options &options) {
+    RayTracer tracer(options);
+    std::vector<std::uint8_t> image;
+    const double time = Time([&] {
+      image = RenderImage(tracer, scene, camera);
+    });
+    SpectralSampler sampler(options.color_profile, options.spectral_sampling,
+        options.spectral_samples, options.wavelengths_per_sample,
+        options.spectral_bins);
+    out << std::setw(22) << name
+        << std::setw(13) << sampler.cost()
+        << std::setw(10) << std::setprecision(3) << time
+        << std::setw(8) << std::setprecision(3)
+        << RootMeanSquareError(image, reference) << '\n';
+  };
+
+  options.spectral_sampling = SpectralSampling::kRgb;
+  report("rgb", options);
+
+  options.spectral_sampling = SpectralSampling::kHeroWavelength;
+  options.wavelengths_per_sample = 4;
+  for (int samples : {1, 2, 4, 8, 16}) {
+    options.spectral_samples = samples;
+    const std::string name = "hero x" + std::to_string(samples);
+    report(name.c_str(), options);
+  }
+}
+
+}  // namespace benchmark
+
+}  // namespace deer
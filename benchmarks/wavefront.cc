@@ -0,0 +1,73 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "../src/renderer.h"
+#include "../src/scene.h"
+#include "../src/spectrum.h"
+#include "benchmark.h"
+#include "scenes.h"
+
+namespace deer {
+
+namespace benchmark {
+
+// Per-pixel against wavefront execution as the number of lights, and so
+// of shadow rays per hit, grows.
+DEER_BENCHMARK(Wavefront) {
+  const Camera camera = MakeCamera();
+
+  out << std::setw(8) << "lights"
+      << std::setw(8) << "tile"
+      << std::setw(14) << "per-pixel, s"
+      << std::setw(14) << "wavefront, s"
+      << std::setw(10) << "max diff" << '\n';
+  for (int n_lights : {2, 8, 32}) {
+    Scene scene = MakeMixedScene(4);
+    for (int i = 2; i < n_lights; i++) {
+      const double angle = i * 2.4;
+      scene.Add(std::make_shared<PointLightSource>(
+          double4{8 * std::cos(angle), 6.0 + i % 3, 8 * std::sin(angle) - 8,
+                  1},
+          Spectrum::MakeConstant(2.0 / n_lights)));
+    }
+
+    for (std::size_t tile_size : {16, 64}) {
+      auto options = MakeOptions(320, 180);
+      options.n_threads = 1;
+      options.tile_size = tile_size;
+      std::vector<std::uint8_t> per_pixel, wavefront;
+      RayTracer per_pixel_tracer(options);
+      const double per_pixel_time = Time([&] {
+        per_pixel = RenderImage(per_pixel_tracer, scene, camera);
+      });
+      options.execution_mode = ExecutionMode::kWavefront;
+      RayTracer wavefront_tracer(options);
+      const double wavefront_time = Time([&] {
+        wavefront = RenderImage(wavefront_tracer, scene, camera);
+      });
+
+      int max_diff = 0;
+      for (std::size_t i = 0; i < per_pixel.size(); i++) {
+        max_diff = std::max(max_diff, std::abs(per_pixel[i] - wavefront[i]));
+      }
+      out << std::setw(8) << n_lights
+          << std::setw(8) << tile_size
+          << std::setw(14) << std::setprecision(3) << per_pixel_time
+          << std::setw(14) << std::setprecision(3) << wavefront_time
+          << std::setw(10) << max_diff << '\n';
+    }
+  }
+}
+
+}  // namespace benchmark
+
+}  // namespace deer
@@ -0,0 +1,241 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "color_conversion.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "framebuffer.h"
+#include "rgb.h"
+
+namespace deer {
+
+namespace {
+
+// Writes one quantized pixel in the requested layout.
+template<PixelLayout kLayout>
+inline void StorePixel(const std::int32_t *q, std::uint8_t *out) {
+  switch (kLayout) {
+    case PixelLayout::kRgb:
+      out[0] = q[0]; out[1] = q[1]; out[2] = q[2];
+      break;
+    case PixelLayout::kBgr:
+      out[0] = q[2]; out[1] = q[1]; out[2] = q[0];
+      break;
+    case PixelLayout::kRgba:
+      out[0] = q[0]; out[1] = q[1]; out[2] = q[2]; out[3] = 0xFF;
+      break;
+    case PixelLayout::kBgra:
+      out[0] = q[2]; out[1] = q[1]; out[2] = q[0]; out[3] = 0xFF;
+      break;
+  }
+}
+
+// The tone curves, on intensities mapped to [0, 1] and never negative.
+template<ToneMapping kToneMapping>
+inline float MapTone(float x) {
+  switch (kToneMapping) {
+    case ToneMapping::kLinear:
+      return x;
+    case ToneMapping::kReinhard:
+      return x / (1 + x);
+    case ToneMapping::kAces:
+      return std::min(
+          x * (2.51f * x + 0.03f) / (x * (2.43f * x + 0.59f) + 0.14f), 1.0f);
+  }
+  return x;
+}
+
+#ifdef __SSE2__
+template<ToneMapping kToneMapping>
+inline __m128 MapTone(__m128 x) {
+  const __m128 one = _mm_set1_ps(1);
+  switch (kToneMapping) {
+    case ToneMapping::kLinear:
+      return x;
+    case ToneMapping::kReinhard:
+      return _mm_div_ps(x, _mm_add_ps(one, x));
+    case ToneMapping::kAces: {
+      const __m128 numerator = _mm_mul_ps(
+          x, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.51f), x),
+                        _mm_set1_ps(0.03f)));
+      const __m128 denominator = _mm_add_ps(
+          _mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.43f), x),
+                                   _mm_set1_ps(0.59f))),
+          _mm_set1_ps(0.14f));
+      return _mm_min_ps(_mm_div_ps(numerator, denominator), one);
+    }
+  }
+  return x;
+}
+#endif
+
+}  // namespace
+
+std::size_t BytesPerPixel(PixelLayout layout) {
+  switch (layout) {
+    case PixelLayout::kRgb:
+    case PixelLayout::kBgr:
+      return 3;
+    case PixelLayout::kRgba:
+    case PixelLayout::kBgra:
+      return 4;
+  }
+  return 0;
+}
+
+ColorConverter::ColorConverter(const RgbColorProfile &profile, double gamma,
+                               ToneMapping tone_mapping, double exposure)
+    : tone_mapping_(tone_mapping) {
+  const double limit = gamma == 1 ? 255 : kGammaTableSize - 1;
+  for (std::size_t i = 0; i < 3; i++) {
+    const double min = profile.min_intensities[i];
+    const double max = profile.max_intensities[i];
+    offset_[i] = min;
+    if (tone_mapping == ToneMapping::kLinear) {
+      // The exposure moves the clamping bounds instead of every value,
+      // which keeps exposure == 1 exact.
+      low_[i] = min / exposure;
+      high_[i] = max / exposure;
+      scale_[i] = limit / (max - min) * exposure;
+    } else {
+      low_[i] = 0;
+      high_[i] = std::numeric_limits<float>::max();
+      scale_[i] = exposure / (max - min);
+    }
+  }
+
+  if (gamma != 1) {
+    gamma_table_.resize(kGammaTableSize);
+    for (std::size_t i = 0; i < kGammaTableSize; i++) {
+      const double x = double(i) / (kGammaTableSize - 1);
+      gamma_table_[i] =
+          static_cast<std::uint8_t>(255 * std::pow(x, 1 / gamma) + 0.5);
+    }
+  }
+}
+
+template<PixelLayout kLayout>
+void ColorConverter::ConvertRow(const float *in, std::size_t n_pixels,
+                                std::uint8_t *out) const {
+  switch (tone_mapping_) {
+    case ToneMapping::kLinear:
+      ConvertRow<kLayout, ToneMapping::kLinear>(in, n_pixels, out);
+      break;
+    case ToneMapping::kReinhard:
+      ConvertRow<kLayout, ToneMapping::kReinhard>(in, n_pixels, out);
+      break;
+    case ToneMapping::kAces:
+      ConvertRow<kLayout, ToneMapping::kAces>(in, n_pixels, out);
+      break;
+  }
+}
+
+template<PixelLayout kLayout, ToneMapping kToneMapping>
+void ColorConverter::ConvertRow(const float *in, std::size_t n_pixels,
+                                std::uint8_t *out) const {
+  constexpr bool kCurve = kToneMapping != ToneMapping::kLinear;
+  const bool has_table = !gamma_table_.empty();
+  const float limit = has_table ? kGammaTableSize - 1 : 255;
+  const float rounding = has_table ? 0.5f : 0.0f;
+  const std::size_t bpp = BytesPerPixel(kLayout);
+
+  alignas(16) std::int32_t q[12];
+  auto store = [&](std::size_t n) {
+    if (has_table) {
+      for (std::size_t k = 0; k < n * 3; k++) q[k] = gamma_table_[q[k]];
+    }
+    for (std::size_t k = 0; k < n; k++, out += bpp) {
+      StorePixel<kLayout>(q + 3*k, out);
+    }
+  };
+
+  std::size_t i = 0;
+
+#ifdef __SSE2__
+  // Four RGB pixels are three vectors; channel constants repeat every
+  // three lanes, so each of the vectors gets its own rotation of them.
+  auto rotate = [](const std::array<float, 3> &c, std::size_t k) {
+    return _mm_setr_ps(c[k % 3], c[(k+1) % 3], c[(k+2) % 3], c[k % 3]);
+  };
+  __m128 offset[3], low[3], high[3], scale[3];
+  for (std::size_t k = 0; k < 3; k++) {
+    offset[k] = rotate(offset_, k);
+    low[k] = rotate(low_, k);
+    high[k] = rotate(high_, k);
+    scale[k] = rotate(scale_, k);
+  }
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 limit4 = _mm_set1_ps(limit);
+  const __m128 rounding4 = _mm_set1_ps(rounding);
+
+  for (; i + 4 <= n_pixels; i += 4, in += 12) {
+    for (std::size_t k = 0; k < 3; k++) {
+      __m128 v = _mm_sub_ps(_mm_loadu_ps(in + 4*k), offset[k]);
+      v = _mm_mul_ps(_mm_min_ps(_mm_max_ps(v, low[k]), high[k]), scale[k]);
+      if (kCurve) v = _mm_mul_ps(MapTone<kToneMapping>(v), limit4);
+      v = _mm_add_ps(v, rounding4);
+      v = _mm_min_ps(_mm_max_ps(v, zero), limit4);
+      _mm_store_si128(reinterpret_cast<__m128i *>(q + 4*k),
+                      _mm_cvttps_epi32(v));
+    }
+    store(4);
+  }
+#endif
+
+  for (; i < n_pixels; i++, in += 3) {
+    for (std::size_t k = 0; k < 3; k++) {
+      float v = std::clamp(in[k] - offset_[k], low_[k], high_[k]) * scale_[k];
+      if (kCurve) v = MapTone<kToneMapping>(v) * limit;
+      v = std::clamp(v + rounding, 0.0f, limit);
+      q[k] = static_cast<std::int32_t>(v);
+    }
+    store(1);
+  }
+}
+
+void ColorConverter::Convert(const Framebuffer &framebuffer,
+                             PixelLayout layout, std::uint8_t *out) const {
+  const std::size_t width = framebuffer.width();
+  const std::size_t row_bytes = width * BytesPerPixel(layout);
+#pragma omp parallel for
+  for (std::size_t row = 0; row < framebuffer.height(); row++) {
+    const float *in = framebuffer.data() + row * width * 3;
+    std::uint8_t *row_out = out + row * row_bytes;
+    switch (layout) {
+      case PixelLayout::kRgb:
+        ConvertRow<PixelLayout::kRgb>(in, width, row_out);
+        break;
+      case PixelLayout::kBgr:
+        ConvertRow<PixelLayout::kBgr>(in, width, row_out);
+        break;
+      case PixelLayout::kRgba:
+        ConvertRow<PixelLayout::kRgba>(in, width, row_out);
+        break;
+      case PixelLayout::kBgra:
+        ConvertRow<PixelLayout::kBgra>(in, width, row_out);
+        break;
+    }
+  }
+}
+
+std::vector<std::uint8_t> ColorConverter::Convert(
+    const Framebuffer &framebuffer, PixelLayout layout) const {
+  std::vector<std::uint8_t> result(
+      framebuffer.width() * framebuffer.height() * BytesPerPixel(layout));
+  Convert(framebuffer, layout, result.data());
+  return result;
+}
+
+}  // namespace deer
@@ -0,0 +1,79 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#ifndef DEER_COLOR_CONVERSION_H_
+#define DEER_COLOR_CONVERSION_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "framebuffer.h"
+#include "rgb.h"
+
+namespace deer {
+
+enum struct PixelLayout {
+  kRgb,
+  kBgr,  // as stored by 24-bit TGA files
+  kRgba,
+  kBgra,  // as stored by 32-bit TGA files
+};
+
+std::size_t BytesPerPixel(PixelLayout);
+
+// How intensities beyond the colour profile's range are brought into it.
+// The curves work on intensities mapped so that the profile's range is
+// [0, 1], and are applied before gamma.
+enum struct ToneMapping {
+  // Clips everything above the range to white.
+  kLinear,
+  // Reinhard's x / (1 + x): rolls highlights off so that they never
+  // quite reach white, at the cost of a darker mid-range.
+  kReinhard,
+  // Narkowicz's fit of the ACES filmic curve: a slight toe in the
+  // shadows, and a shoulder that reaches white at about 10.
+  kAces,
+};
+
+// Quantizes a whole framebuffer to bytes in one pass, separately from
+// tracing, so that a finished render can be re-exposed or tone mapped
+// differently without being traced again. With gamma == 1, kLinear and
+// exposure == 1 the result matches RgbColorProfile::ToRgbBytes;
+// otherwise values are gamma-encoded through a lookup table.
+class ColorConverter {
+ public:
+  // Intensities are multiplied by the exposure before tone mapping.
+  explicit ColorConverter(const RgbColorProfile &, double gamma = 1,
+                          ToneMapping = ToneMapping::kLinear,
+                          double exposure = 1);
+
+  // `out` must hold width * height * BytesPerPixel(layout) bytes.
+  // Alpha, if any, is set to 255.
+  void Convert(const Framebuffer &, PixelLayout, std::uint8_t *out) const;
+  std::vector<std::uint8_t> Convert(const Framebuffer &, PixelLayout) const;
+
+ private:
+  static constexpr std::size_t kGammaTableSize = 4096;
+
+  // Per channel: v = clamp(x - offset, low, high) * scale. With kLinear,
+  // scale maps the profile range to [0, 255] (or to the gamma table
+  // index); otherwise to [0, 1], for the curve, whose result is then
+  // scaled to the same limit.
+  std::array<float, 3> offset_, low_, high_, scale_;
+  ToneMapping tone_mapping_;
+  std::vector<std::uint8_t> gamma_table_;  // empty if gamma == 1
+
+  template<PixelLayout>
+  void ConvertRow(const float *in, std::size_t n_pixels,
+                  std::uint8_t *out) const;
+  template<PixelLayout, ToneMapping>
+  void ConvertRow(const float *in, std::size_t n_pixels,
+                  std::uint8_t *out) const;
+};
+
+}  // namespace deer
+
+#endif  // DEER_COLOR_CONVERSION_H_
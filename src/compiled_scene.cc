@@ -0,0 +1,457 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "compiled_scene.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "geometry.h"
+#include "optics.h"
+#include "scene.h"
+#include "vector.h"
+
+namespace deer {
+
+namespace {
+
+// Returns true if the candidate hit should replace the current closest one.
+bool IsCloser(const std::optional<CompiledScene::Hit> &closest,
+              double distance2, std::size_t object) {
+  if (!closest) return true;
+  if (distance2 != closest->distance2) return distance2 < closest->distance2;
+  return object < closest->object;
+}
+
+template<class Instance>
+Ray ObjectSpaceRay(const Instance &instance, const double4 &origin,
+                   const double4 &direction) {
+  return Ray{
+    instance.transform.ApplyInverse(origin),
+    instance.transform.ApplyInverse(direction)
+  };
+}
+
+template<class Instance>
+std::optional<RayIntersection> IntersectInstance(const Instance &instance,
+                                                 const double4 &origin,
+                                                 const double4 &direction) {
+  return instance.geometry->Intersect(
+      ObjectSpaceRay(instance, origin, direction));
+}
+
+template<class Instance>
+constexpr bool kIsMesh =
+    std::is_same_v<typename Instance::GeometryType, TrianglesGeometry>;
+
+// Makes the instance's hit, in object space, the closest one if it is
+// closer to the ray origin.
+template<class Instance>
+void KeepCloser(const Instance &instance,
+                const std::optional<RayIntersection> &isec,
+                const double4 &origin,
+                std::optional<CompiledScene::Hit> *closest) {
+  if (!isec) return;
+  const double4 point = instance.transform.Apply(isec->point);
+  const double distance2 = length2(point - origin);
+  if (!IsCloser(*closest, distance2, instance.object)) return;
+  *closest = CompiledScene::Hit{point, instance.transform.Apply(isec->normal),
+                                distance2, instance.material,
+                                instance.material_features, instance.object};
+}
+
+// Whether the instance's hit, in object space, is closer to the ray
+// origin than sqrt(max_distance2).
+template<class Instance>
+bool OccludesWith(const Instance &instance,
+                  const std::optional<RayIntersection> &isec,
+                  const double4 &origin, double max_distance2) {
+  return isec && length2(instance.transform.Apply(isec->point) - origin) <
+                     max_distance2;
+}
+
+// Whether the instance blocks the ray, also given in object space. Any
+// triangle of a mesh that does will do, so *primitive is set to the first
+// one found.
+template<class Instance>
+bool OccludesObjectRay(const Instance &instance, const Ray &object_ray,
+                       const double4 &origin, double max_distance2,
+                       std::size_t *primitive) {
+  if constexpr (kIsMesh<Instance>) {
+    const std::size_t n_triangles = instance.geometry->transforms().size();
+    for (std::size_t i = 0; i < n_triangles; i++) {
+      if (OccludesWith(instance,
+                       instance.geometry->IntersectTriangle(i, object_ray),
+                       origin, max_distance2)) {
+        *primitive = i;
+        return true;
+      }
+    }
+    return false;
+  } else {
+    if (!OccludesWith(instance, instance.geometry->Intersect(object_ray),
+                      origin, max_distance2)) {
+      return false;
+    }
+    *primitive = 0;
+    return true;
+  }
+}
+
+// Batches go through the scene a chunk of rays at a time, small enough
+// for the stack.
+constexpr std::size_t kChunkSize = 64;
+
+// Rays in structure-of-arrays layout, in some space.
+struct RayChunk {
+  std::size_t size;
+  double origin[4][kChunkSize];
+  double direction[4][kChunkSize];
+
+  Ray operator[](std::size_t i) const {
+    return Ray{double4{origin[0][i], origin[1][i], origin[2][i],
+                       origin[3][i]},
+               double4{direction[0][i], direction[1][i], direction[2][i],
+                       direction[3][i]}};
+  }
+};
+
+void LoadChunk(const RayBatch &rays, std::size_t first, RayChunk *chunk) {
+  chunk->size = std::min(kChunkSize, rays.size() - first);
+  for (std::size_t k = 0; k < 4; k++) {
+    std::copy(rays.origins(k) + first, rays.origins(k) + first + chunk->size,
+              chunk->origin[k]);
+    std::copy(rays.directions(k) + first,
+              rays.directions(k) + first + chunk->size, chunk->direction[k]);
+  }
+}
+
+// m * v for all the origins and directions, adding up the same terms in
+// the same order as double4x4 * double4, in loops that vectorize.
+void TransformChunk(const double4x4 &m, const RayChunk &in, RayChunk *out) {
+  out->size = in.size;
+  for (std::size_t k = 0; k < 4; k++) {
+    const double m0 = m[0][k], m1 = m[1][k], m2 = m[2][k], m3 = m[3][k];
+    for (std::size_t i = 0; i < in.size; i++) {
+      double origin = 0, direction = 0;
+      origin += m0 * in.origin[0][i];
+      origin += m1 * in.origin[1][i];
+      origin += m2 * in.origin[2][i];
+      origin += m3 * in.origin[3][i];
+      direction += m0 * in.direction[0][i];
+      direction += m1 * in.direction[1][i];
+      direction += m2 * in.direction[2][i];
+      direction += m3 * in.direction[3][i];
+      out->origin[k][i] = origin;
+      out->direction[k][i] = direction;
+    }
+  }
+}
+
+// Clears may_hit[i] where the i-th ray, in object space, certainly misses
+// the geometry: the early outs of its Intersect, taken for all the rays
+// at once. Intersect has the last word on the rest.
+void ScreenChunk(const XYPlaneGeometry &, const RayChunk &rays,
+                 std::uint8_t *may_hit) {
+  for (std::size_t i = 0; i < rays.size; i++) {
+    may_hit[i] = !(rays.origin[2][i] * rays.direction[2][i] >= 0);
+  }
+}
+
+void ScreenChunk(const UnitSphereGeometry &, const RayChunk &rays,
+                 std::uint8_t *may_hit) {
+  for (std::size_t i = 0; i < rays.size; i++) {
+    const double rx = rays.origin[0][i], ry = rays.origin[1][i];
+    const double rz = rays.origin[2][i];
+    const double dx = rays.direction[0][i], dy = rays.direction[1][i];
+    const double dz = rays.direction[2][i];
+    const double a = dx*dx + dy*dy + dz*dz;
+    const double b = 2 * (rx*dx + ry*dy + rz*dz);
+    const double c = rx*rx + ry*ry + rz*rz - 1;
+    may_hit[i] = !(b > 0 && c > 0) && !(b*b - 4*a*c < 0);
+  }
+}
+
+void ScreenChunk(const TrianglesGeometry &geometry, const RayChunk &rays,
+                 std::uint8_t *may_hit) {
+  std::fill(may_hit, may_hit + rays.size, 0);
+  RayChunk triangle_rays;
+  for (const auto &transform : geometry.transforms()) {
+    TransformChunk(transform.inverse_matrix(), rays, &triangle_rays);
+    for (std::size_t i = 0; i < rays.size; i++) {
+      const double oz = triangle_rays.origin[2][i];
+      const double dz = triangle_rays.direction[2][i];
+      const double x = triangle_rays.origin[0][i] -
+                       triangle_rays.direction[0][i] * oz / dz;
+      const double y = triangle_rays.origin[1][i] -
+                       triangle_rays.direction[1][i] * oz / dz;
+      may_hit[i] |= !(oz * dz >= 0) && !(x < 0 || y < 0) && !(x + y > 1);
+    }
+  }
+}
+
+// The rays of the chunk in the instance's object space, and which of
+// them may hit it.
+template<class Instance>
+void ScreenInstance(const Instance &instance, const RayChunk &chunk,
+                    RayChunk *object_rays, std::uint8_t *may_hit) {
+  TransformChunk(instance.transform.inverse_matrix(), chunk, object_rays);
+  ScreenChunk(*instance.geometry, *object_rays, may_hit);
+}
+
+template<class Instance>
+bool OccludedByInstance(const void *instance, std::size_t *primitive,
+                        const Ray &ray, double max_distance2) {
+  const Instance &typed = *static_cast<const Instance *>(instance);
+  const Ray object_ray = ObjectSpaceRay(typed, ray.origin, ray.direction);
+  if constexpr (kIsMesh<Instance>) {
+    if (OccludesWith(typed,
+                     typed.geometry->IntersectTriangle(*primitive,
+                                                       object_ray),
+                     ray.origin, max_distance2)) {
+      return true;
+    }
+  }
+  return OccludesObjectRay(typed, object_ray, ray.origin, max_distance2,
+                           primitive);
+}
+
+template<class Instance>
+bool OccludedByCustom(const void *instance, std::size_t *,
+                      const Ray &ray, double max_distance2) {
+  const Instance &custom = *static_cast<const Instance *>(instance);
+  auto isec = custom.object->IntersectWithRay(ray);
+  return isec && length2(isec->point - ray.origin) < max_distance2;
+}
+
+}  // namespace
+
+CompiledScene::CompiledScene(const Scene &scene, GeometryDispatch dispatch)
+    : scene_(scene), dispatch_(dispatch) {
+  const auto &objects = scene.objects();
+  for (std::size_t i = 0; i < objects.size(); i++) {
+    const GeometryObject *geometry_object = objects[i]->AsGeometryObject();
+    bool bucketed = false;
+
+    MaterialFeatures material_features;
+    if (geometry_object && geometry_object->material()) {
+      material_features = ClassifyMaterial(*geometry_object->material());
+    }
+    material_features_.push_back(material_features);
+
+    if (dispatch == GeometryDispatch::kBucketed && geometry_object) {
+      const Geometry *geometry = geometry_object->geometry().get();
+      std::apply([&](auto &... buckets) {
+        auto try_add = [&](auto &bucket) {
+          using G = typename std::decay_t<
+              decltype(bucket)>::value_type::GeometryType;
+          if (bucketed || geometry->kind() != G::kKind) return;
+          bucket.push_back({
+            static_cast<const G *>(geometry),
+            geometry_object->transform,
+            geometry_object->material().get(),
+            material_features,
+            i
+          });
+          bucketed = true;
+        };
+        (try_add(buckets), ...);
+      }, buckets_);
+    }
+
+    if (!bucketed) {
+      custom_.push_back({objects[i].get(), i, material_features});
+    }
+  }
+
+  // Now that the buckets are filled, their instances stay put.
+  occlusion_tests_.resize(objects.size());
+  std::apply([&](const auto &... buckets) {
+    auto add_bucket = [&](const auto &bucket) {
+      using Instance = typename std::decay_t<decltype(bucket)>::value_type;
+      for (const auto &instance : bucket) {
+        occlusion_tests_[instance.object] =
+            OcclusionTest{OccludedByInstance<Instance>, &instance};
+      }
+    };
+    (add_bucket(buckets), ...);
+  }, buckets_);
+  for (const auto &custom : custom_) {
+    occlusion_tests_[custom.index] =
+        OcclusionTest{OccludedByCustom<CustomInstance>, &custom};
+  }
+}
+
+std::optional<CompiledScene::Hit> CompiledScene::Intersect(
+    const Ray &ray) const {
+  std::optional<Hit> closest;
+
+  std::apply([&](const auto &... buckets) {
+    auto intersect_bucket = [&](const auto &bucket) {
+      for (const auto &instance : bucket) {
+        KeepCloser(instance,
+                   IntersectInstance(instance, ray.origin, ray.direction),
+                   ray.origin, &closest);
+      }
+    };
+    (intersect_bucket(buckets), ...);
+  }, buckets_);
+
+  for (const auto &custom : custom_) {
+    auto isec = custom.object->IntersectWithRay(ray);
+    if (!isec) continue;
+    const double distance2 = length2(isec->point - ray.origin);
+    if (!IsCloser(closest, distance2, custom.index)) continue;
+    closest = Hit{isec->point, isec->normal, distance2,
+                  isec->material.get(), custom.material_features,
+                  custom.index};
+  }
+
+  return closest;
+}
+
+bool CompiledScene::Occluded(const Ray &ray, double max_distance2) const {
+  return FindOccluder(ray, max_distance2, kNoObject).object != kNoObject;
+}
+
+bool CompiledScene::Occluded(const Ray &ray, double max_distance2,
+                             Occluder *occluder) const {
+  const std::size_t cached = occluder->object;
+  if (cached != kNoObject && OccludedBy(occluder, ray, max_distance2)) {
+    return true;
+  }
+  const Occluder found = FindOccluder(ray, max_distance2, cached);
+  if (found.object == kNoObject) return false;
+  *occluder = found;
+  return true;
+}
+
+bool CompiledScene::OccludedBy(Occluder *occluder, const Ray &ray,
+                               double max_distance2) const {
+  const OcclusionTest &test = occlusion_tests_[occluder->object];
+  return test.occluded_by(test.instance, &occluder->primitive, ray,
+                          max_distance2);
+}
+
+void CompiledScene::Intersect(const RayBatch &rays,
+                              std::optional<Hit> *hits) const {
+  const std::size_t n_rays = rays.size();
+  std::fill(hits, hits + n_rays, std::nullopt);
+
+  RayChunk chunk, object_rays;
+  std::uint8_t may_hit[kChunkSize];
+  for (std::size_t first = 0; first < n_rays; first += kChunkSize) {
+    LoadChunk(rays, first, &chunk);
+    std::optional<Hit> *chunk_hits = hits + first;
+    std::apply([&](const auto &... buckets) {
+      auto intersect_bucket = [&](const auto &bucket) {
+        for (const auto &instance : bucket) {
+          ScreenInstance(instance, chunk, &object_rays, may_hit);
+          for (std::size_t i = 0; i < chunk.size; i++) {
+            if (!may_hit[i]) continue;
+            KeepCloser(instance, instance.geometry->Intersect(object_rays[i]),
+                       chunk[i].origin, &chunk_hits[i]);
+          }
+        }
+      };
+      (intersect_bucket(buckets), ...);
+    }, buckets_);
+  }
+
+  for (const auto &custom : custom_) {
+    for (std::size_t i = 0; i < n_rays; i++) {
+      const double4 origin = rays.origin(i);
+      auto isec = custom.object->IntersectWithRay(
+          Ray{origin, rays.direction(i)});
+      if (!isec) continue;
+      const double distance2 = length2(isec->point - origin);
+      if (!IsCloser(hits[i], distance2, custom.index)) continue;
+      hits[i] = Hit{isec->point, isec->normal, distance2,
+                    isec->material.get(), custom.material_features,
+                    custom.index};
+    }
+  }
+}
+
+void CompiledScene::FindOccluders(const RayBatch &rays,
+                                  const double *max_distance2,
+                                  Occluder *occluders) const {
+  const std::size_t n_rays = rays.size();
+
+  RayChunk chunk, object_rays;
+  std::uint8_t may_hit[kChunkSize];
+  for (std::size_t first = 0; first < n_rays; first += kChunkSize) {
+    LoadChunk(rays, first, &chunk);
+    Occluder *chunk_occluders = occluders + first;
+    std::apply([&](const auto &... buckets) {
+      auto occlude_bucket = [&](const auto &bucket) {
+        for (const auto &instance : bucket) {
+          ScreenInstance(instance, chunk, &object_rays, may_hit);
+          for (std::size_t i = 0; i < chunk.size; i++) {
+            Occluder &occluder = chunk_occluders[i];
+            if (!may_hit[i] || occluder.object != kNoObject) continue;
+            if (OccludesObjectRay(instance, object_rays[i], chunk[i].origin,
+                                  max_distance2[first + i],
+                                  &occluder.primitive)) {
+              occluder.object = instance.object;
+            }
+          }
+        }
+      };
+      (occlude_bucket(buckets), ...);
+    }, buckets_);
+  }
+
+  for (const auto &custom : custom_) {
+    for (std::size_t i = 0; i < n_rays; i++) {
+      if (occluders[i].object != kNoObject) continue;
+      const double4 origin = rays.origin(i);
+      auto isec = custom.object->IntersectWithRay(
+          Ray{origin, rays.direction(i)});
+      if (isec && length2(isec->point - origin) < max_distance2[i]) {
+        occluders[i] = Occluder{custom.index, 0};
+      }
+    }
+  }
+}
+
+CompiledScene::Occluder CompiledScene::FindOccluder(
+    const Ray &ray, double max_distance2, std::size_t skipped) const {
+  Occluder occluder;
+
+  std::apply([&](const auto &... buckets) {
+    auto occlude_bucket = [&](const auto &bucket) {
+      if (occluder.object != kNoObject) return;
+      for (const auto &instance : bucket) {
+        if (instance.object == skipped) continue;
+        if (OccludesObjectRay(instance,
+                              ObjectSpaceRay(instance, ray.origin,
+                                             ray.direction),
+                              ray.origin, max_distance2,
+                              &occluder.primitive)) {
+          occluder.object = instance.object;
+          return;
+        }
+      }
+    };
+    (occlude_bucket(buckets), ...);
+  }, buckets_);
+  if (occluder.object != kNoObject) return occluder;
+
+  for (const auto &custom : custom_) {
+    if (custom.index == skipped) continue;
+    auto isec = custom.object->IntersectWithRay(ray);
+    if (isec && length2(isec->point - ray.origin) < max_distance2) {
+      return Occluder{custom.index, 0};
+    }
+  }
+  return Occluder{};
+}
+
+}  // namespace deer
@@ -0,0 +1,142 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#ifndef DEER_COMPILED_SCENE_H_
+#define DEER_COMPILED_SCENE_H_
+
+#include <cstddef>
+#include <optional>
+#include <tuple>
+#include <vector>
+
+#include "geometry.h"
+#include "optics.h"
+#include "scene.h"
+#include "transform.h"
+#include "vector.h"
+
+namespace deer {
+
+enum struct GeometryDispatch {
+  // Every object goes through SceneObject::IntersectWithRay,
+  // exactly like Scene::TraceRay.
+  kVirtual,
+  // Built-in geometries are grouped by type and intersected by
+  // statically dispatched kernels; custom ones fall back to kVirtual.
+  kBucketed,
+};
+
+// A render-ready view of a Scene. The scene must outlive it and must not
+// be modified while it is in use.
+class CompiledScene {
+ public:
+  struct Hit {
+    double4 point;
+    double4 normal;
+    double distance2;  // from the ray origin
+    const Material *material;
+    MaterialFeatures material_features;
+    std::size_t object;  // index into Scene::objects()
+  };
+
+  explicit CompiledScene(const Scene &,
+      GeometryDispatch dispatch = GeometryDispatch::kBucketed);
+  // Points into itself.
+  CompiledScene(const CompiledScene &) = delete;
+
+  const Scene &scene() const { return scene_; }
+  GeometryDispatch dispatch() const { return dispatch_; }
+
+  // Closest hit; ties are resolved by object order, as in Scene::TraceRay.
+  std::optional<Hit> Intersect(const Ray &) const;
+
+  static constexpr std::size_t kNoObject = ~std::size_t{0};
+
+  // As of the compilation, which its hits carry.
+  const MaterialFeatures &material_features(std::size_t object) const {
+    return material_features_[object];
+  }
+
+  // What blocks a ray: an object, and the triangle of a mesh, which a
+  // cache can try before the rest. Other objects are a single primitive 0.
+  struct Occluder {
+    std::size_t object = kNoObject;
+    std::size_t primitive = 0;
+
+    bool operator==(const Occluder &other) const {
+      return object == other.object && primitive == other.primitive;
+    }
+  };
+
+  // Any hit closer than sqrt(max_distance2) to the ray origin.
+  bool Occluded(const Ray &, double max_distance2) const;
+  // The same, but first tries the object *occluder names, if any, and
+  // then sets it to what was hit, if anything; what blocked one shadow
+  // ray often blocks the next.
+  bool Occluded(const Ray &, double max_distance2, Occluder *occluder) const;
+  // Whether the object of *occluder on its own blocks the ray the same
+  // way: its primitive first, then the rest, setting it to the one that
+  // does.
+  bool OccludedBy(Occluder *occluder, const Ray &,
+                  double max_distance2) const;
+
+  // The same queries for a batch of rays at once, which go through the
+  // scene together, instance by instance, with the same results as one
+  // at a time. hits[i] is the closest hit of the i-th ray.
+  void Intersect(const RayBatch &, std::optional<Hit> *hits) const;
+  // Sets occluders[i] to the primitive that Occluded would find blocking
+  // the i-th ray closer than sqrt(max_distance2[i]), if any. Rays that
+  // already have an occluder are skipped, and the rest keep kNoObject.
+  void FindOccluders(const RayBatch &, const double *max_distance2,
+                     Occluder *occluders) const;
+
+ private:
+  template<class G>
+  struct Instance {
+    using GeometryType = G;
+    const G *geometry;
+    AffineTransform transform;
+    const Material *material;
+    MaterialFeatures material_features;
+    std::size_t object;
+  };
+
+  template<class... Gs>
+  using Buckets = std::tuple<std::vector<Instance<Gs>>...>;
+
+  // Adding a built-in geometry type is a matter of listing it here.
+  Buckets<XYPlaneGeometry, UnitSphereGeometry, TrianglesGeometry> buckets_;
+
+  struct CustomInstance {
+    const SceneObject *object;
+    std::size_t index;
+    // Classified up front for GeometryObjects; other objects may return
+    // any material, so they get the general kernel.
+    MaterialFeatures material_features;
+  };
+  std::vector<CustomInstance> custom_;
+
+  // Tests a single object for OccludedBy.
+  using OccludedByFunction = bool (*)(const void *instance,
+                                      std::size_t *primitive, const Ray &,
+                                      double max_distance2);
+  struct OcclusionTest {
+    OccludedByFunction occluded_by;
+    const void *instance;
+  };
+  std::vector<OcclusionTest> occlusion_tests_;  // by object index
+  std::vector<MaterialFeatures> material_features_;  // by object index
+
+  // The primitive closer than sqrt(max_distance2) that the ray hits
+  // first in bucket order, on any object but the skipped one.
+  Occluder FindOccluder(const Ray &, double max_distance2,
+                        std::size_t skipped) const;
+
+  const Scene &scene_;
+  GeometryDispatch dispatch_;
+};
+
+}  // namespace deer
+
+#endif  // DEER_COMPILED_SCENE_H_
@@ -0,0 +1,331 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "denoiser.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "fast_math.h"
+#include "framebuffer.h"
+
+namespace deer {
+
+namespace {
+
+using Exp = FastMath<MathAccuracy::kFast>;
+using Plane = std::vector<float>;
+
+// The B3 spline; every pass uses it both ways.
+constexpr float kKernel[5] = {1.0f / 16, 1.0f / 4, 3.0f / 8,
+                              1.0f / 4, 1.0f / 16};
+// The fast exponent is only defined down to about e^-87; weights below
+// e^-80 make no difference anyway.
+constexpr float kMinExponent = -80;
+constexpr float kEpsilon = 1e-6f;
+
+// One pass of the filter over planes of one value per pixel.
+struct Pass {
+  std::size_t width, height, step;
+  // Of the input; the intensity is the mean of the colour channels.
+  std::array<const float *, 3> color;
+  const float *variance, *intensity;
+  // Per pixel, the reciprocal of the intensity difference that costs a
+  // unit of the weight exponent.
+  const float *color_scale;
+  std::array<const float *, 3> normal, albedo;
+  const float *depth;
+  float depth_sigma, normal_scale, albedo_scale;
+
+  std::array<float *, 3> out_color;
+  float *out_variance;
+
+  // The reciprocal of the pixel distance to each tap; zero for the
+  // center, which never differs from itself.
+  float distance_scale[5][5];
+};
+
+// Filters one pixel, skipping the taps outside the image.
+void FilterPixel(const Pass &pass, std::size_t row, std::size_t col) {
+  const std::size_t p = row * pass.width + col;
+  const float depth_scale = 1 / (pass.depth_sigma * pass.depth[p] +
+                                 kEpsilon);
+  float sum_weight = 0, sum_variance = 0;
+  float sum_color[3] = {0, 0, 0};
+  for (int dy = -2; dy <= 2; dy++) {
+    const std::ptrdiff_t y = row + dy * std::ptrdiff_t(pass.step);
+    if (y < 0 || y >= std::ptrdiff_t(pass.height)) continue;
+    for (int dx = -2; dx <= 2; dx++) {
+      const std::ptrdiff_t x = col + dx * std::ptrdiff_t(pass.step);
+      if (x < 0 || x >= std::ptrdiff_t(pass.width)) continue;
+      const std::size_t q = y * pass.width + x;
+
+      float normal_distance2 = 0, albedo_distance2 = 0;
+      for (std::size_t c = 0; c < 3; c++) {
+        const float dn = pass.normal[c][p] - pass.normal[c][q];
+        const float da = pass.albedo[c][p] - pass.albedo[c][q];
+        normal_distance2 += dn * dn;
+        albedo_distance2 += da * da;
+      }
+      const float exponent =
+          std::abs(pass.intensity[p] - pass.intensity[q]) *
+              pass.color_scale[p] +
+          std::abs(pass.depth[p] - pass.depth[q]) * depth_scale *
+              pass.distance_scale[dy + 2][dx + 2] +
+          normal_distance2 * pass.normal_scale +
+          albedo_distance2 * pass.albedo_scale;
+      const float weight = kKernel[dy + 2] * kKernel[dx + 2] *
+          float(Exp::Exp(std::max(-exponent, kMinExponent)));
+
+      for (std::size_t c = 0; c < 3; c++) {
+        sum_color[c] += weight * pass.color[c][q];
+      }
+      sum_variance += weight * weight * pass.variance[q];
+      sum_weight += weight;
+    }
+  }
+  // The center tap always counts, so the sum is never zero.
+  for (std::size_t c = 0; c < 3; c++) {
+    pass.out_color[c][p] = sum_color[c] / sum_weight;
+  }
+  pass.out_variance[p] = sum_variance / (sum_weight * sum_weight);
+}
+
+#ifdef __SSE2__
+// FilterPixel for the four pixels from col on, whose taps must all lie
+// inside the row.
+void FilterFourPixels(const Pass &pass, std::size_t row, std::size_t col) {
+  const std::size_t p = row * pass.width + col;
+  const __m128 sign_mask = _mm_set1_ps(-0.0f);
+  auto load = [](const float *plane, std::size_t i) {
+    return _mm_loadu_ps(plane + i);
+  };
+  auto abs_difference = [&](__m128 a, __m128 b) {
+    return _mm_andnot_ps(sign_mask, _mm_sub_ps(a, b));
+  };
+
+  const __m128 intensity = load(pass.intensity, p);
+  const __m128 color_scale = load(pass.color_scale, p);
+  const __m128 depth = load(pass.depth, p);
+  const __m128 depth_scale = _mm_div_ps(_mm_set1_ps(1), _mm_add_ps(
+      _mm_mul_ps(_mm_set1_ps(pass.depth_sigma), depth),
+      _mm_set1_ps(kEpsilon)));
+  __m128 normal[3], albedo[3];
+  for (std::size_t c = 0; c < 3; c++) {
+    normal[c] = load(pass.normal[c], p);
+    albedo[c] = load(pass.albedo[c], p);
+  }
+  const __m128 normal_scale = _mm_set1_ps(pass.normal_scale);
+  const __m128 albedo_scale = _mm_set1_ps(pass.albedo_scale);
+  const __m128 min_exponent = _mm_set1_ps(kMinExponent);
+
+  __m128 sum_weight = _mm_setzero_ps(), sum_variance = _mm_setzero_ps();
+  __m128 sum_color[3] = {_mm_setzero_ps(), _mm_setzero_ps(),
+                         _mm_setzero_ps()};
+  for (int dy = -2; dy <= 2; dy++) {
+    const std::ptrdiff_t y = row + dy * std::ptrdiff_t(pass.step);
+    if (y < 0 || y >= std::ptrdiff_t(pass.height)) continue;
+    for (int dx = -2; dx <= 2; dx++) {
+      const std::size_t q = y * pass.width + col + dx * pass.step;
+
+      __m128 normal_distance2 = _mm_setzero_ps();
+      __m128 albedo_distance2 = _mm_setzero_ps();
+      for (std::size_t c = 0; c < 3; c++) {
+        const __m128 dn = _mm_sub_ps(normal[c], load(pass.normal[c], q));
+        const __m128 da = _mm_sub_ps(albedo[c], load(pass.albedo[c], q));
+        normal_distance2 = _mm_add_ps(normal_distance2, _mm_mul_ps(dn, dn));
+        albedo_distance2 = _mm_add_ps(albedo_distance2, _mm_mul_ps(da, da));
+      }
+      __m128 exponent = _mm_mul_ps(
+          abs_difference(intensity, load(pass.intensity, q)), color_scale);
+      exponent = _mm_add_ps(exponent, _mm_mul_ps(
+          _mm_mul_ps(abs_difference(depth, load(pass.depth, q)),
+                     depth_scale),
+          _mm_set1_ps(pass.distance_scale[dy + 2][dx + 2])));
+      exponent = _mm_add_ps(exponent,
+                            _mm_mul_ps(normal_distance2, normal_scale));
+      exponent = _mm_add_ps(exponent,
+                            _mm_mul_ps(albedo_distance2, albedo_scale));
+      const __m128 weight = _mm_mul_ps(
+          _mm_set1_ps(kKernel[dy + 2] * kKernel[dx + 2]),
+          Exp::Exp(_mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), exponent),
+                              min_exponent)));
+
+      for (std::size_t c = 0; c < 3; c++) {
+        sum_color[c] = _mm_add_ps(sum_color[c],
+            _mm_mul_ps(weight, load(pass.color[c], q)));
+      }
+      sum_variance = _mm_add_ps(sum_variance, _mm_mul_ps(
+          _mm_mul_ps(weight, weight), load(pass.variance, q)));
+      sum_weight = _mm_add_ps(sum_weight, weight);
+    }
+  }
+  for (std::size_t c = 0; c < 3; c++) {
+    _mm_storeu_ps(pass.out_color[c] + p, _mm_div_ps(sum_color[c],
+                                                    sum_weight));
+  }
+  _mm_storeu_ps(pass.out_variance + p, _mm_div_ps(
+      sum_variance, _mm_mul_ps(sum_weight, sum_weight)));
+}
+#endif  // __SSE2__
+
+// A 3x3 binomial blur, clamped to the image.
+Plane Blur(const Plane &plane, std::size_t width, std::size_t height) {
+  constexpr float kWeights[3] = {0.25f, 0.5f, 0.25f};
+  Plane result(plane.size());
+#pragma omp parallel for
+  for (std::size_t row = 0; row < height; row++) {
+    for (std::size_t col = 0; col < width; col++) {
+      float sum = 0, sum_weight = 0;
+      for (int dy = -1; dy <= 1; dy++) {
+        if ((row == 0 && dy < 0) || (row + 1 == height && dy > 0)) continue;
+        for (int dx = -1; dx <= 1; dx++) {
+          if ((col == 0 && dx < 0) || (col + 1 == width && dx > 0)) continue;
+          const float weight = kWeights[dy + 1] * kWeights[dx + 1];
+          sum += weight * plane[(row + dy) * width + col + dx];
+          sum_weight += weight;
+        }
+      }
+      result[row * width + col] = sum / sum_weight;
+    }
+  }
+  return result;
+}
+
+// The variance of the intensity over the 3x3 neighbourhood of every
+// pixel, for when the samples did not tell.
+Plane NeighbourhoodVariance(const Plane &intensity, std::size_t width,
+                            std::size_t height) {
+  Plane result(intensity.size());
+#pragma omp parallel for
+  for (std::size_t row = 0; row < height; row++) {
+    for (std::size_t col = 0; col < width; col++) {
+      float sum = 0, sum2 = 0;
+      int n = 0;
+      for (std::size_t y = row > 0 ? row - 1 : 0;
+           y < std::min(row + 2, height); y++) {
+        for (std::size_t x = col > 0 ? col - 1 : 0;
+             x < std::min(col + 2, width); x++) {
+          const float v = intensity[y * width + x];
+          sum += v;
+          sum2 += v * v;
+          n++;
+        }
+      }
+      result[row * width + col] = std::max(0.0f, sum2 / n -
+                                                 (sum / n) * (sum / n));
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+void Denoiser::Denoise(const DenoiserGuides &guides,
+                       Framebuffer *image) const {
+  const std::size_t width = image->width(), height = image->height();
+  const std::size_t n = width * height;
+  if (n == 0 || options.passes == 0) return;
+
+  // Planes, so that four neighbouring pixels make one vector.
+  std::array<Plane, 3> color, next_color, normal, albedo;
+  for (std::size_t c = 0; c < 3; c++) {
+    color[c].resize(n);
+    next_color[c].resize(n);
+    normal[c].resize(n);
+    albedo[c].resize(n);
+  }
+#pragma omp parallel for
+  for (std::size_t i = 0; i < n; i++) {
+    for (std::size_t c = 0; c < 3; c++) {
+      color[c][i] = image->data()[i * 3 + c];
+      normal[c][i] = guides.normal[i * 3 + c];
+      albedo[c][i] = guides.albedo[i * 3 + c];
+    }
+  }
+  Plane intensity(n), color_scale(n), next_variance(n);
+  auto update_intensity = [&] {
+#pragma omp parallel for
+    for (std::size_t i = 0; i < n; i++) {
+      intensity[i] = (color[0][i] + color[1][i] + color[2][i]) / 3;
+    }
+  };
+  update_intensity();
+  Plane variance = guides.variance.empty()
+      ? NeighbourhoodVariance(intensity, width, height) : guides.variance;
+
+  Pass pass;
+  pass.width = width;
+  pass.height = height;
+  pass.depth = guides.depth.data();
+  pass.depth_sigma = options.depth_sigma;
+  pass.normal_scale = 1 / (options.normal_sigma * options.normal_sigma);
+  pass.albedo_scale = 1 / (options.albedo_sigma * options.albedo_sigma);
+  for (std::size_t c = 0; c < 3; c++) {
+    pass.normal[c] = normal[c].data();
+    pass.albedo[c] = albedo[c].data();
+  }
+  pass.intensity = intensity.data();
+  pass.color_scale = color_scale.data();
+
+  for (std::size_t i = 0; i < options.passes; i++) {
+    pass.step = std::size_t(1) << i;
+    for (int dy = -2; dy <= 2; dy++) {
+      for (int dx = -2; dx <= 2; dx++) {
+        pass.distance_scale[dy + 2][dx + 2] = dx || dy
+            ? 1 / (pass.step * std::sqrt(float(dx * dx + dy * dy))) : 0;
+      }
+    }
+
+    // The variance itself is noisy, so the weights take it blurred.
+    const Plane blurred_variance = Blur(variance, width, height);
+#pragma omp parallel for
+    for (std::size_t j = 0; j < n; j++) {
+      color_scale[j] = 1 / (options.color_sigma *
+                            std::sqrt(blurred_variance[j]) + kEpsilon);
+    }
+
+    for (std::size_t c = 0; c < 3; c++) {
+      pass.color[c] = color[c].data();
+      pass.out_color[c] = next_color[c].data();
+    }
+    pass.variance = variance.data();
+    pass.out_variance = next_variance.data();
+
+#pragma omp parallel for
+    for (std::size_t row = 0; row < height; row++) {
+      std::size_t col = 0;
+#ifdef __SSE2__
+      const std::size_t reach = 2 * pass.step;
+      for (; col < std::min(reach, width); col++) {
+        FilterPixel(pass, row, col);
+      }
+      for (; col + 4 + reach <= width; col += 4) {
+        FilterFourPixels(pass, row, col);
+      }
+#endif
+      for (; col < width; col++) FilterPixel(pass, row, col);
+    }
+
+    std::swap(color, next_color);
+    std::swap(variance, next_variance);
+    update_intensity();
+  }
+
+#pragma omp parallel for
+  for (std::size_t i = 0; i < n; i++) {
+    for (std::size_t c = 0; c < 3; c++) {
+      image->data()[i * 3 + c] = color[c][i];
+    }
+  }
+}
+
+}  // namespace deer
@@ -0,0 +1,70 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#ifndef DEER_DENOISER_H_
+#define DEER_DENOISER_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "framebuffer.h"
+
+namespace deer {
+
+// Features of the first hits of every pixel's samples, averaged over the
+// samples, which tell the edges in an image from its noise. Row-major,
+// like a Framebuffer of the same size.
+struct DenoiserGuides {
+  // Of rays that hit nothing.
+  static constexpr float kSkyDepth = 1e30f;
+
+  DenoiserGuides() = default;
+  DenoiserGuides(std::size_t width, std::size_t height)
+      : depth(width * height), normal(width * height * 3),
+        albedo(width * height * 3) {}
+
+  std::vector<float> depth;  // distance to the first hit
+  std::vector<float> normal;  // x, y, z, facing the camera
+  std::vector<float> albedo;  // r, g, b of the diffuse colour
+  // Of the pixel mean, as the mean of the channels' variances; if empty,
+  // estimated from the neighbourhood of every pixel instead.
+  std::vector<float> variance;
+};
+
+// The edge-avoiding a-trous wavelet filter of Dammertz et al., with the
+// noise-scaled colour weights of Schied et al.'s SVGF. Every pass blurs
+// with a 5x5 B3-spline kernel whose taps are spread twice as far apart
+// as in the pass before, and weighs each tap down by how much its
+// colour, normal, depth and albedo differ from the pixel's.
+//
+// Runs on the float framebuffer, before quantization; rows go to all the
+// OpenMP threads, four pixels at a time with SSE2.
+class Denoiser {
+ public:
+  struct Options {
+    // The kernel reaches 2^(passes + 1) pixels out in the last pass.
+    // More passes take out coarser noise, but blur smooth gradients.
+    // The defaults are tuned for 1 to 16 samples per pixel: a third pass,
+    // or a colour sigma of 3, already blurs more than it takes out at 8.
+    std::size_t passes = 2;
+    // How far a tap may differ before it stops counting: in colour, in
+    // standard deviations of the pixel's noise; in depth, relative to the
+    // pixel's depth per pixel of distance between them.
+    float color_sigma = 2;
+    float normal_sigma = 0.125f;
+    float depth_sigma = 0.1f;
+    float albedo_sigma = 0.1f;
+  };
+  const Options options;
+
+  Denoiser() : options() {}
+  explicit Denoiser(const Options &opts) : options(opts) {}
+
+  // The guides must be of the framebuffer's size.
+  void Denoise(const DenoiserGuides &, Framebuffer *) const;
+};
+
+}  // namespace deer
+
+#endif  // DEER_DENOISER_H_
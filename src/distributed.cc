@@ -0,0 +1,310 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "distributed.h"
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <deque>
+#include <thread>
+#include <vector>
+
+#include "color_conversion.h"
+#include "framebuffer.h"
+#include "scheduler.h"
+#include "tile_job.h"
+
+namespace deer {
+
+namespace {
+
+// What goes over a socket: a region to trace, from the coordinator; or
+// ahead of its pixels, the region traced, from a worker, with the camera
+// rays that took.
+struct RegionHeader {
+  std::uint64_t row, col, height, width;
+  std::uint64_t primary_rays;
+};
+
+bool SendAll(int socket, const void *data, std::size_t size) {
+  const char *p = static_cast<const char *>(data);
+  while (size > 0) {
+    // A worker that is gone must not take the coordinator with it.
+    const ssize_t n = send(socket, p, size, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+// False if the other end hangs up first.
+bool ReceiveAll(int socket, void *data, std::size_t size) {
+  char *p = static_cast<char *>(data);
+  while (size > 0) {
+    const ssize_t n = recv(socket, p, size, 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+// Returns the camera rays traced; the pixels are row-major, as in a
+// Framebuffer of the region's size.
+std::size_t TraceRegion(const RayTracer::Options &options,
+                        const Scene &scene, const Camera &camera,
+                        const Tile &region, std::vector<float> *pixels) {
+  RayTracer::Options region_options = options;
+  region_options.crop = region;
+  region_options.paste_crop = false;
+  auto job = RayTracer(region_options).Render(scene, camera);
+  job->result.wait();
+  pixels->assign(job->image.data(), job->image.data() + job->image.size());
+  return job->statistics.primary_rays;
+}
+
+// The worker's side: traces the regions that come in until the
+// coordinator hangs up.
+void ServeRegions(int socket, const RayTracer::Options &options,
+                  const Scene &scene, const Camera &camera) {
+  RegionHeader header;
+  std::vector<float> pixels;
+  while (ReceiveAll(socket, &header, sizeof(header))) {
+    const Tile region{header.row, header.col, header.height, header.width};
+    header.primary_rays =
+        TraceRegion(options, scene, camera, region, &pixels);
+    if (!SendAll(socket, &header, sizeof(header)) ||
+        !SendAll(socket, pixels.data(), pixels.size() * sizeof(float))) {
+      return;
+    }
+  }
+}
+
+// Of the regions, which are traced whole, without the deadline, which the
+// coordinator keeps, and without what needs the whole image.
+RayTracer::Options RegionOptions(const RayTracer::Options &options) {
+  RayTracer::Options region_options = options;
+  region_options.crop.reset();
+  region_options.time_limit = 0;
+  region_options.denoise = false;
+  region_options.output_depth = false;
+  region_options.output_normal = false;
+  region_options.output_albedo = false;
+  region_options.output_object_id = false;
+  region_options.output_hit_count = false;
+  return region_options;
+}
+
+struct Worker {
+  pid_t pid;
+  int socket;  // the coordinator's end; -1 once the worker is gone
+  std::deque<Tile> regions;  // sent, in the order they come back
+};
+
+// Returns a worker whose socket is -1 if it could not be started.
+Worker SpawnWorker(std::size_t index,
+                   const DistributedRenderer::Options &options,
+                   const RayTracer::Options &worker_options,
+                   const Scene &scene, const Camera &camera,
+                   const std::vector<Worker> &others) {
+  int sockets[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+    return Worker{-1, -1, {}};
+  }
+  const pid_t pid = fork();
+  if (pid < 0) {
+    close(sockets[0]);
+    close(sockets[1]);
+    return Worker{-1, -1, {}};
+  }
+  if (pid == 0) {
+    // Holding on to the others' sockets would keep them from seeing the
+    // coordinator hang up.
+    close(sockets[0]);
+    for (const Worker &other : others) {
+      if (other.socket >= 0) close(other.socket);
+    }
+    if (options.worker_init) options.worker_init(index);
+    ServeRegions(sockets[1], worker_options, scene, camera);
+    // Skips the destructors and exit handlers of the coordinator's copy.
+    _exit(0);
+  }
+  close(sockets[1]);
+  return Worker{pid, sockets[0], {}};
+}
+
+void Drop(Worker *worker, bool kill_process) {
+  close(worker->socket);
+  worker->socket = -1;
+  if (kill_process) kill(worker->pid, SIGKILL);
+  waitpid(worker->pid, nullptr, 0);
+}
+
+std::vector<std::uint8_t> Coordinate(const DistributedRenderer &renderer,
+    const Scene scene, const Camera camera, std::vector<Worker> workers,
+    std::shared_ptr<SharedFramebuffer> framebuffer,
+    std::shared_ptr<Renderer::JobStatus> job_status) {
+  const RayTracer::Options &tracer_options = renderer.tracer_options;
+  const RayTracer::Options own_options = RegionOptions(tracer_options);
+  const std::size_t width = tracer_options.image_width;
+  const std::size_t height = tracer_options.image_height;
+  const std::size_t tile_size = ClampTileSize(tracer_options.tile_size);
+  const std::size_t region_size =
+      (std::max<std::size_t>(renderer.options.region_size, 1) +
+       tile_size - 1) / tile_size * tile_size;
+  const std::size_t regions_in_flight =
+      std::max<std::size_t>(renderer.options.regions_in_flight, 1);
+  std::deque<Tile> pending;
+  for (const Tile &region : MakeTiles(width, height, region_size,
+                                      tracer_options.tile_order)) {
+    pending.push_back(region);
+  }
+
+  // Tiles are handed out here rather than to threads, so the job runs
+  // on a single one.
+  TileJob job(job_status, 1, false, tracer_options.time_limit);
+  Renderer::Statistics &statistics = job_status->statistics;
+  std::vector<Tile> finished;
+  std::size_t pixels_done = 0;
+  std::vector<float> pixels;
+
+  // Its regions go back to the front of the queue.
+  auto lose = [&](Worker *worker) {
+    Drop(worker, true);
+    statistics.workers_lost++;
+    statistics.regions_retraced += worker->regions.size();
+    pending.insert(pending.begin(), worker->regions.begin(),
+                   worker->regions.end());
+    worker->regions.clear();
+  };
+  auto finish = [&](const Tile &region, std::size_t primary_rays) {
+    framebuffer->WriteTile(region, pixels.data());
+    finished.push_back(region);
+    statistics.primary_rays += primary_rays;
+    pixels_done += region.width * region.height;
+    job_status->amount_done = double(pixels_done) / (width * height);
+  };
+
+  while (pixels_done < width * height) {
+    if (job.ShouldStop()) break;
+
+    for (Worker &worker : workers) {
+      while (worker.socket >= 0 && !pending.empty() &&
+             worker.regions.size() < regions_in_flight) {
+        const Tile region = pending.front();
+        const RegionHeader header{region.row, region.col, region.height,
+                                  region.width, 0};
+        if (!SendAll(worker.socket, &header, sizeof(header))) {
+          lose(&worker);
+          break;
+        }
+        worker.regions.push_back(region);
+        pending.pop_front();
+      }
+    }
+
+    std::vector<pollfd> sockets;
+    std::vector<Worker *> busy;
+    for (Worker &worker : workers) {
+      if (worker.socket >= 0 && !worker.regions.empty()) {
+        sockets.push_back(pollfd{worker.socket, POLLIN, 0});
+        busy.push_back(&worker);
+      }
+    }
+    if (busy.empty()) {
+      // Every worker is gone; the coordinator takes over, a region at a
+      // time so as to notice a cancellation.
+      const Tile region = pending.front();
+      pending.pop_front();
+      finish(region, TraceRegion(own_options, scene, camera, region,
+                                 &pixels));
+      continue;
+    }
+
+    // Wakes up now and then to look at the cancellation and the deadline.
+    if (poll(sockets.data(), sockets.size(), 100) <= 0) continue;
+    for (std::size_t i = 0; i < sockets.size(); i++) {
+      if (sockets[i].revents == 0) continue;
+      Worker *worker = busy[i];
+      const Tile region = worker->regions.front();
+      RegionHeader header;
+      pixels.resize(region.width * region.height * 3);
+      if (!ReceiveAll(worker->socket, &header, sizeof(header)) ||
+          header.row != region.row || header.col != region.col ||
+          header.height != region.height || header.width != region.width ||
+          !ReceiveAll(worker->socket, pixels.data(),
+                      pixels.size() * sizeof(float))) {
+        lose(worker);
+        continue;
+      }
+      worker->regions.pop_front();
+      finish(region, header.primary_rays);
+    }
+  }
+
+  job.EndTracing();
+  // Idle workers see the coordinator hang up and exit; busy ones would
+  // only finish regions nobody waits for.
+  const bool stopped = job_status->outcome != Renderer::Outcome::kCompleted;
+  for (Worker &worker : workers) {
+    if (worker.socket >= 0) Drop(&worker, stopped);
+  }
+  if (stopped) {
+    statistics.finished_tiles = finished;
+  } else {
+    job_status->passes_done++;
+  }
+
+  const ColorConverter converter(tracer_options.color_profile,
+                                 tracer_options.gamma,
+                                 tracer_options.tone_mapping,
+                                 tracer_options.exposure);
+  return job.Finish(framebuffer->Snapshot(), converter,
+                    tracer_options.pixel_layout);
+}
+
+}  // namespace
+
+std::shared_ptr<Renderer::JobStatus> DistributedRenderer::Render(
+    const Scene &scene, const Camera &camera) {
+  auto job_status = std::make_shared<JobStatus>();
+  job_status->amount_done = 0;
+
+  RayTracer::Options worker_options = RegionOptions(tracer_options);
+  if (worker_options.n_threads == 0) {
+    worker_options.n_threads = std::max<std::size_t>(
+        std::thread::hardware_concurrency() /
+            std::max<std::size_t>(options.n_workers, 1), 1);
+  }
+  std::vector<Worker> workers;
+  for (std::size_t i = 0; i < options.n_workers; i++) {
+    Worker worker = SpawnWorker(i, options, worker_options, scene, camera,
+                                workers);
+    if (worker.socket >= 0) workers.push_back(worker);
+  }
+
+  auto framebuffer = std::make_shared<SharedFramebuffer>(
+      tracer_options.image_width, tracer_options.image_height);
+  job_status->snapshot = ConvertingSnapshot(framebuffer,
+      ColorConverter(tracer_options.color_profile, tracer_options.gamma,
+                     tracer_options.tone_mapping, tracer_options.exposure),
+      tracer_options.pixel_layout);
+  job_status->result = std::async(std::launch::async, Coordinate, *this,
+      scene, camera,
+      std::move(workers), framebuffer, job_status);
+  return job_status;
+}
+
+}  // namespace deer
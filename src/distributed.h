@@ -0,0 +1,69 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#ifndef DEER_DISTRIBUTED_H_
+#define DEER_DISTRIBUTED_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+#include "renderer.h"
+#include "scene.h"
+
+namespace deer {
+
+// Renders with a RayTracer in several processes on one host. The calling
+// process coordinates: it forks worker processes, each with its own copy
+// of the scene, and hands them square regions of the image over Unix
+// sockets, a few at a time, as they finish the ones before. A worker
+// traces each region as a crop window and streams its linear pixels
+// back; the coordinator puts the image together and converts it.
+//
+// Regions are made of whole tiles of the image, and adaptive
+// anti-aliasing looks for contrast only inside the tile of a pixel, so
+// the image is the same as RayTracer's. The crop, the denoiser and the
+// output buffers of the tracer options are ignored.
+//
+// A worker that dies, or sends back anything but the region it was
+// given, is dropped, and its unfinished regions go to the others; if all
+// of them are gone, the coordinator traces the rest itself. A job that
+// is cancelled or runs out of time kills the workers at once.
+//
+// Needs POSIX. Workers are forked from the thread that starts the job,
+// and only that thread goes on in them, so no other thread may be in the
+// middle of changing the scene then.
+class DistributedRenderer : public Renderer {
+ public:
+  struct Options {
+    std::size_t n_workers = 4;
+    // Of the side of a region, in pixels; rounded up to a multiple of the
+    // tile size. Smaller regions balance better, but every region is a
+    // job of its own in a worker, with the scene prepared anew.
+    std::size_t region_size = 64;
+    // Regions sent to a worker ahead of the one it is on, so that it does
+    // not wait for the next one.
+    std::size_t regions_in_flight = 2;
+    // Called in every worker process with its index before it takes any
+    // region, as to lower its priority.
+    std::function<void(std::size_t)> worker_init;
+  };
+
+  DistributedRenderer(const RayTracer::Options &tracer_opts,
+                      const Options &opts)
+      : tracer_options(tracer_opts), options(opts) {}
+  explicit DistributedRenderer(const RayTracer::Options &tracer_opts)
+      : DistributedRenderer(tracer_opts, Options()) {}
+
+  // Unless set, the workers split the hardware threads between them;
+  // the coordinator uses all of them when it has to trace itself.
+  const RayTracer::Options tracer_options;
+  const Options options;
+
+  std::shared_ptr<JobStatus> Render(const Scene &, const Camera &) override;
+};
+
+}  // namespace deer
+
+#endif  // DEER_DISTRIBUTED_H_
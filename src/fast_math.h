@@ -0,0 +1,270 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#ifndef DEER_FAST_MATH_H_
+#define DEER_FAST_MATH_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace deer {
+
+enum struct MathAccuracy {
+  kExact,  // the <cmath> functions, in double precision
+  kFast,  // about single precision
+  kFastest,  // about three decimal digits
+};
+
+// Numeric kernels for shading, specialized per accuracy tier. Scalar and
+// SIMD versions of a tier use the same algorithm, so they share the
+// documented maximum relative errors (tests/fast_math.cc checks them):
+//
+//            Rsqrt   Rcp     Exp(x)              Pow(x, y)
+//   kFast    5e-6    2e-7    2e-7 * (1 + |x|)    2e-7 * (1 + |y| (1 + |ln x|))
+//   kFastest 2e-3    3e-3    6e-4 * (1 + |x|)    6e-4 * (1 + |y| (1 + |ln x|))
+//
+// The growth with |x| and |y ln x| comes from rounding the exponent to
+// single precision. Exp and Pow bounds hold for results within
+// [2^-126, 2^127]; Pow is defined for x > 0 only. Out of their domains
+// the functions return unspecified values, so callers must check.
+template<MathAccuracy kAccuracy>
+struct FastMath;
+
+namespace fast_math_internal {
+
+inline std::int32_t FloatBits(float x) {
+  std::int32_t i;
+  std::memcpy(&i, &x, sizeof(i));
+  return i;
+}
+
+inline float BitsFloat(std::int32_t i) {
+  float x;
+  std::memcpy(&x, &i, sizeof(x));
+  return x;
+}
+
+constexpr float kLog2E = 1.44269504088896341f;
+constexpr float kLn2 = 0.693147180559945309f;
+constexpr float kSqrt2 = 1.41421356237309505f;
+
+// 2^t; n = round(t), then e^(f * ln 2) for f in [-0.5, 0.5] by its Taylor
+// series, which has (kDegree + 1)! in the error term denominator. Halves
+// round to even, as _mm_cvtps_epi32 rounds them.
+template<int kDegree>
+inline float Exp2(float t) {
+  t = std::min(std::max(t, -126.0f), 127.0f);
+  const std::int32_t n = static_cast<std::int32_t>(std::nearbyint(t));
+  const float g = (t - n) * kLn2;
+  float p = 1;
+  for (int k = kDegree; k >= 1; k--) p = 1 + p * g * (1.0f / k);
+  return p * BitsFloat((n + 127) << 23);
+}
+
+// ln(x) = e * ln 2 + 2 atanh(u), u = (m - 1) / (m + 1), with the mantissa
+// m in [sqrt(1/2), sqrt(2)), so that |u| < 0.172.
+template<int kTerms>
+inline float Log(float x) {
+  std::int32_t bits = FloatBits(x);
+  std::int32_t e = ((bits >> 23) & 0xFF) - 127;
+  float m = BitsFloat((bits & 0x007FFFFF) | 0x3F800000);
+  if (m > kSqrt2) { m *= 0.5f; e += 1; }
+  const float u = (m - 1) / (m + 1);
+  const float u2 = u * u;
+  float s = 0;
+  for (int k = kTerms - 1; k >= 0; k--) s = 1.0f / (2*k + 1) + u2 * s;
+  return e * kLn2 + 2 * u * s;
+}
+
+template<int kIterations>
+inline float RsqrtNewton(float x) {
+  float y = BitsFloat(0x5F375A86 - (FloatBits(x) >> 1));
+  for (int k = 0; k < kIterations; k++) y = y * (1.5f - 0.5f * x * y * y);
+  return y;
+}
+
+template<int kIterations>
+inline float RcpNewton(float x) {
+  float y = BitsFloat(0x7EF311C3 - FloatBits(x));
+  for (int k = 0; k < kIterations; k++) y = y * (2 - x * y);
+  return y;
+}
+
+#ifdef __SSE2__
+
+template<int kDegree>
+inline __m128 Exp2(__m128 t) {
+  t = _mm_min_ps(_mm_max_ps(t, _mm_set1_ps(-126)), _mm_set1_ps(127));
+  const __m128i n = _mm_cvtps_epi32(t);  // rounds to nearest
+  const __m128 g = _mm_mul_ps(_mm_sub_ps(t, _mm_cvtepi32_ps(n)),
+                              _mm_set1_ps(kLn2));
+  __m128 p = _mm_set1_ps(1);
+  for (int k = kDegree; k >= 1; k--) {
+    p = _mm_add_ps(_mm_set1_ps(1),
+                   _mm_mul_ps(p, _mm_mul_ps(g, _mm_set1_ps(1.0f / k))));
+  }
+  const __m128i scale = _mm_slli_epi32(
+      _mm_add_epi32(n, _mm_set1_epi32(127)), 23);
+  return _mm_mul_ps(p, _mm_castsi128_ps(scale));
+}
+
+template<int kTerms>
+inline __m128 Log(__m128 x) {
+  const __m128i bits = _mm_castps_si128(x);
+  __m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(
+      _mm_and_si128(_mm_srli_epi32(bits, 23), _mm_set1_epi32(0xFF)),
+      _mm_set1_epi32(127)));
+  __m128 m = _mm_castsi128_ps(_mm_or_si128(
+      _mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)),
+      _mm_set1_epi32(0x3F800000)));
+  const __m128 big = _mm_cmpgt_ps(m, _mm_set1_ps(kSqrt2));
+  m = _mm_sub_ps(m, _mm_and_ps(big, _mm_mul_ps(m, _mm_set1_ps(0.5f))));
+  e = _mm_add_ps(e, _mm_and_ps(big, _mm_set1_ps(1)));
+  const __m128 one = _mm_set1_ps(1);
+  const __m128 u = _mm_div_ps(_mm_sub_ps(m, one), _mm_add_ps(m, one));
+  const __m128 u2 = _mm_mul_ps(u, u);
+  __m128 s = _mm_setzero_ps();
+  for (int k = kTerms - 1; k >= 0; k--) {
+    s = _mm_add_ps(_mm_set1_ps(1.0f / (2*k + 1)), _mm_mul_ps(u2, s));
+  }
+  return _mm_add_ps(_mm_mul_ps(e, _mm_set1_ps(kLn2)),
+                    _mm_mul_ps(_mm_set1_ps(2), _mm_mul_ps(u, s)));
+}
+
+template<int kIterations>
+inline __m128 RsqrtNewton(__m128 x) {
+  __m128 y = _mm_castsi128_ps(_mm_sub_epi32(_mm_set1_epi32(0x5F375A86),
+      _mm_srli_epi32(_mm_castps_si128(x), 1)));
+  const __m128 half_x = _mm_mul_ps(_mm_set1_ps(0.5f), x);
+  for (int k = 0; k < kIterations; k++) {
+    y = _mm_mul_ps(y, _mm_sub_ps(_mm_set1_ps(1.5f),
+                                 _mm_mul_ps(half_x, _mm_mul_ps(y, y))));
+  }
+  return y;
+}
+
+template<int kIterations>
+inline __m128 RcpNewton(__m128 x) {
+  __m128 y = _mm_castsi128_ps(_mm_sub_epi32(_mm_set1_epi32(0x7EF311C3),
+                                            _mm_castps_si128(x)));
+  for (int k = 0; k < kIterations; k++) {
+    y = _mm_mul_ps(y, _mm_sub_ps(_mm_set1_ps(2), _mm_mul_ps(x, y)));
+  }
+  return y;
+}
+
+template<class F>
+inline __m128 PerLane(__m128 x, F f) {
+  alignas(16) float v[4];
+  _mm_store_ps(v, x);
+  for (float &lane : v) lane = f(lane);
+  return _mm_load_ps(v);
+}
+
+#endif  // __SSE2__
+
+// Shared by the approximate tiers; they differ only in the parameters.
+template<int kRsqrtIterations, int kRcpIterations,
+         int kExpDegree, int kLogTerms>
+struct ApproximateMath {
+  static double Rsqrt(double x) {
+    return RsqrtNewton<kRsqrtIterations>(float(x));
+  }
+  static double Rcp(double x) {
+    return RcpNewton<kRcpIterations>(float(x));
+  }
+  static double Exp(double x) {
+    return Exp2<kExpDegree>(float(x) * kLog2E);
+  }
+  static double Pow(double x, double y) {
+    return Exp2<kExpDegree>(float(y) * Log<kLogTerms>(float(x)) * kLog2E);
+  }
+
+#ifdef __SSE2__
+  static __m128 Rsqrt(__m128 x) {
+    return RsqrtNewton<kRsqrtIterations>(x);
+  }
+  static __m128 Rcp(__m128 x) {
+    return RcpNewton<kRcpIterations>(x);
+  }
+  static __m128 Exp(__m128 x) {
+    return Exp2<kExpDegree>(_mm_mul_ps(x, _mm_set1_ps(kLog2E)));
+  }
+  static __m128 Pow(__m128 x, __m128 y) {
+    return Exp2<kExpDegree>(_mm_mul_ps(
+        _mm_mul_ps(y, Log<kLogTerms>(x)), _mm_set1_ps(kLog2E)));
+  }
+#endif
+};
+
+}  // namespace fast_math_internal
+
+// x^kN by repeated squaring, for exponents known at compile time.
+template<int kN>
+inline double IntPow(double x) {
+  static_assert(kN >= 0);
+  if constexpr (kN == 0) {
+    return 1;
+  } else if constexpr (kN % 2 == 0) {
+    const double half = IntPow<kN / 2>(x);
+    return half * half;
+  } else {
+    return x * IntPow<kN - 1>(x);
+  }
+}
+
+template<>
+struct FastMath<MathAccuracy::kExact> {
+  static double Rsqrt(double x) { return 1 / std::sqrt(x); }
+  static double Rcp(double x) { return 1 / x; }
+  static double Exp(double x) { return std::exp(x); }
+  static double Pow(double x, double y) { return std::pow(x, y); }
+
+#ifdef __SSE2__
+  static __m128 Rsqrt(__m128 x) {
+    return _mm_div_ps(_mm_set1_ps(1), _mm_sqrt_ps(x));
+  }
+  static __m128 Rcp(__m128 x) { return _mm_div_ps(_mm_set1_ps(1), x); }
+  static __m128 Exp(__m128 x) {
+    return fast_math_internal::PerLane(x, [](float v) {
+      return std::exp(v);
+    });
+  }
+  static __m128 Pow(__m128 x, __m128 y) {
+    alignas(16) float vx[4], vy[4];
+    _mm_store_ps(vx, x);
+    _mm_store_ps(vy, y);
+    for (int i = 0; i < 4; i++) vx[i] = std::pow(vx[i], vy[i]);
+    return _mm_load_ps(vx);
+  }
+#endif
+};
+
+template<>
+struct FastMath<MathAccuracy::kFast>
+    : fast_math_internal::ApproximateMath<2, 3, 6, 4> {
+  static constexpr double kRsqrtError = 5e-6;
+  static constexpr double kRcpError = 2e-7;
+  static constexpr double kExpError = 2e-7;
+  static constexpr double kPowError = 2e-7;
+};
+
+template<>
+struct FastMath<MathAccuracy::kFastest>
+    : fast_math_internal::ApproximateMath<1, 1, 3, 2> {
+  static constexpr double kRsqrtError = 2e-3;
+  static constexpr double kRcpError = 3e-3;
+  static constexpr double kExpError = 6e-4;
+  static constexpr double kPowError = 6e-4;
+};
+
+}  // namespace deer
+
+#endif  // DEER_FAST_MATH_H_
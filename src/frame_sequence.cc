@@ -0,0 +1,89 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "frame_sequence.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <optional>
+
+#include "compiled_scene.h"
+#include "ray_tracer_job.h"
+#include "renderer.h"
+#include "scene.h"
+#include "scheduler.h"
+#include "vector.h"
+
+namespace deer {
+
+double SampleAnchor(const RayTracer::Options &options) {
+  return std::max(options.min_samples, options.max_samples) > 1 ? 0.5 : 0;
+}
+
+std::optional<std::size_t> ReprojectedPixel(
+    const FrameSequence::Frame &previous, const CompiledScene::Hit &hit,
+    const RayTracer::Options &options, const Tile &window,
+    double depth_tolerance, double max_drift, double2 *drift) {
+  // In camera space, a ray through the screen point (x, y) goes along
+  // (x, y, 1). The pixel is the one with the nearest anchor.
+  const double4 point = previous.camera.transform.ApplyInverse(hit.point);
+  if (point.z() <= 0) return {};
+  const double anchor = SampleAnchor(options);
+  const double col = (point.x() / point.z() + 1) * options.image_width / 2;
+  const double row = (1 - point.y() / point.z()) * options.image_height / 2;
+  const double nearest_col = std::floor(col - anchor + 0.5);
+  const double nearest_row = std::floor(row - anchor + 0.5);
+  if (!(nearest_col >= window.col &&
+        nearest_col < window.col + window.width &&
+        nearest_row >= window.row &&
+        nearest_row < window.row + window.height)) {
+    return {};
+  }
+
+  const std::size_t pixel =
+      (static_cast<std::size_t>(nearest_row) - window.row) * window.width +
+      static_cast<std::size_t>(nearest_col) - window.col;
+  if (previous.object[pixel] != hit.object) return {};
+  const double distance = length(hit.point - previous.camera.position());
+  if (std::abs(previous.distance[pixel] - distance) >
+      depth_tolerance * distance) {
+    return {};
+  }
+  *drift = double2{
+      nearest_col + anchor + previous.drift[pixel * 2] - col,
+      nearest_row + anchor + previous.drift[pixel * 2 + 1] - row};
+  if (std::abs((*drift)[0]) > max_drift ||
+      std::abs((*drift)[1]) > max_drift) {
+    return {};
+  }
+  return pixel;
+}
+
+std::shared_ptr<Renderer::JobStatus> FrameSequence::RenderFrame(
+    const Scene &scene, const Camera &camera) {
+  // Unless the caller has taken the result already.
+  if (last_job_ && last_job_->result.valid()) last_job_->result.wait();
+  const bool refresh = n_frames_ == 0 ||
+      (options.refresh_interval > 0 &&
+       n_frames_ % options.refresh_interval == 0);
+
+  auto reprojection = std::make_shared<Reprojection>();
+  // A frame that stopped early has holes.
+  if (!refresh && last_job_->outcome == Renderer::Outcome::kCompleted) {
+    reprojection->previous = last_frame_;
+  }
+  reprojection->next = std::make_shared<Frame>();
+  reprojection->depth_tolerance = options.depth_tolerance;
+  reprojection->max_drift = options.max_drift;
+
+  last_frame_ = reprojection->next;
+  last_job_ = StartRayTracerJob(tracer, scene, {camera}, reprojection,
+                                nullptr);
+  n_frames_++;
+  return last_job_;
+}
+
+}  // namespace deer
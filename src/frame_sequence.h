@@ -0,0 +1,64 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#ifndef DEER_FRAME_SEQUENCE_H_
+#define DEER_FRAME_SEQUENCE_H_
+
+#include <cstddef>
+#include <memory>
+
+#include "renderer.h"
+#include "scene.h"
+
+namespace deer {
+
+// Renders the frames of a camera fly-through one after another, and
+// copies into each frame the pixels that the one before already has.
+// Every pixel first casts a single ray through where its samples go on
+// average; where that hits the same object as the previous frame's ray
+// through the pixel it projects to, at the same distance, the old colour
+// is reused, and only the pixels that come out from behind something,
+// left the view, or see mirrors and glass are traced.
+//
+// The scene must not change between frames. Reused pixels keep their
+// old highlights and sampling noise, so every refresh_interval-th frame
+// is traced in full to keep them from drifting.
+class FrameSequence {
+ public:
+  struct Options {
+    // Zero traces only the first frame in full.
+    std::size_t refresh_interval = 16;
+    // Of the distance from the camera.
+    double depth_tolerance = 0.01;
+    // In pixels. Copying a colour to the pixel nearest to where it moved
+    // shifts it by up to half a pixel each frame, and over several frames
+    // the shifts add up; a pixel whose colour would end up further than
+    // this from where it was traced is traced again.
+    double max_drift = 0.5;
+  };
+  // What a frame leaves for the next one.
+  struct Frame;
+
+  FrameSequence(const RayTracer::Options &tracer_options,
+                const Options &opts)
+      : tracer(tracer_options), options(opts) {}
+  explicit FrameSequence(const RayTracer::Options &tracer_options)
+      : FrameSequence(tracer_options, Options()) {}
+
+  const RayTracer tracer;
+  const Options options;
+
+  // Waits for the previous frame to be done, if it is not.
+  std::shared_ptr<Renderer::JobStatus> RenderFrame(const Scene &,
+                                                   const Camera &);
+
+ private:
+  std::size_t n_frames_ = 0;
+  std::shared_ptr<Renderer::JobStatus> last_job_;
+  std::shared_ptr<Frame> last_frame_;
+};
+
+}  // namespace deer
+
+#endif  // DEER_FRAME_SEQUENCE_H_
@@ -0,0 +1,95 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#ifndef DEER_FRAMEBUFFER_H_
+#define DEER_FRAMEBUFFER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+#include "scheduler.h"
+#include "vector.h"
+
+namespace deer {
+
+// Linear per-channel intensities (as they come out of a SpectralSampler,
+// before any RgbColorProfile normalization), stored as row-major RGB
+// float triplets.
+class Framebuffer {
+ public:
+  Framebuffer() = default;
+  Framebuffer(std::size_t width, std::size_t height)
+      : width_(width), height_(height), data_(width * height * 3) {}
+
+  std::size_t width() const { return width_; }
+  std::size_t height() const { return height_; }
+
+  float *data() { return data_.data(); }
+  const float *data() const { return data_.data(); }
+  std::size_t size() const { return data_.size(); }
+
+  double3 Get(std::size_t row, std::size_t col) const {
+    const float *p = &data_[(row * width_ + col) * 3];
+    return double3{p[0], p[1], p[2]};
+  }
+  void Set(std::size_t row, std::size_t col, const double3 &rgb) {
+    float *p = &data_[(row * width_ + col) * 3];
+    p[0] = static_cast<float>(rgb[0]);
+    p[1] = static_cast<float>(rgb[1]);
+    p[2] = static_cast<float>(rgb[2]);
+  }
+
+  // Copies a tile to or from a tightly packed buffer of its pixels.
+  void ReadTile(const Tile &tile, float *out) const {
+    for (std::size_t row = 0; row < tile.height; row++) {
+      const float *in = &data_[((tile.row + row) * width_ + tile.col) * 3];
+      out = std::copy(in, in + tile.width * 3, out);
+    }
+  }
+  void WriteTile(const Tile &tile, const float *in) {
+    for (std::size_t row = 0; row < tile.height; row++) {
+      float *out = &data_[((tile.row + row) * width_ + tile.col) * 3];
+      std::copy(in, in + tile.width * 3, out);
+      in += tile.width * 3;
+    }
+  }
+
+ private:
+  std::size_t width_ = 0, height_ = 0;
+  std::vector<float> data_;
+};
+
+// A framebuffer that is written a whole tile at a time by several
+// threads, and can be copied at any moment without tearing a tile.
+class SharedFramebuffer {
+ public:
+  SharedFramebuffer(std::size_t width, std::size_t height)
+      : framebuffer_(width, height) {}
+
+  // Tiles written concurrently must not overlap.
+  void ReadTile(const Tile &tile, float *out) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    framebuffer_.ReadTile(tile, out);
+  }
+  void WriteTile(const Tile &tile, const float *in) {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    framebuffer_.WriteTile(tile, in);
+  }
+
+  Framebuffer Snapshot() const {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    return framebuffer_;
+  }
+
+ private:
+  mutable std::shared_mutex mutex_;
+  Framebuffer framebuffer_;
+};
+
+}  // namespace deer
+
+#endif  // DEER_FRAMEBUFFER_H_
@@ -7,6 +7,7 @@
 #include <algorithm>
 #include <array>
 #include <cmath>
+#include <cstddef>
 #include <optional>
 #include <vector>
 
@@ -17,54 +18,6 @@
 namespace deer {
 
 
-std::optional<RayIntersection> XYPlaneGeometry::IntersectWithRay(
-    const Ray &ray) const {
-  double d = ray.origin.z() * ray.direction.z();
-  if (d >= 0) return {};
-
-  double4 r = ray.direction * ray.origin.z() / ray.direction.z();
-  double n = ray.origin.z() > 0 ? 1 : -1;
-  return RayIntersection{ray.origin - r, double4{0, 0, n, 0}};
-}
-
-
-std::optional<RayIntersection> UnitSphereGeometry::IntersectWithRay(
-    const Ray &ray) const {
-  double4 r = ray.origin - double4{0, 0, 0, 1};
-  double4 d = ray.direction;
-
-  // solving a*alpha^2 + b*alpha + c = 0
-  // where r + alpha*d is our intersection point
-
-  double a = d.x()*d.x() + d.y()*d.y() + d.z()*d.z();
-  double b = 2 * (r.x()*d.x() + r.y()*d.y() + r.z()*d.z());
-  double c = r.x()*r.x() + r.y()*r.y() + r.z()*r.z() - 1;
-
-  // we need only the positive roots
-  if (b > 0 && c > 0) return {};
-
-  double discriminant = b*b - 4*a*c;
-  if (discriminant < 0) return {};
-  double alpha1 = (-b - std::sqrt(discriminant)) / (2 * a);
-  double alpha2 = (-b + std::sqrt(discriminant)) / (2 * a);
-
-  double alpha;
-
-  // we want the closest intersection "in front" of the origin
-  if (alpha1 >= 0 && alpha2 >= 0) alpha = std::min(alpha1, alpha2);
-  else if (alpha1 >= 0) alpha = alpha1;
-  else if (alpha2 >= 0) alpha = alpha2;
-  else return {};
-
-  double4 isec_point = ray.origin + alpha * d;
-  double4 isec_normal = r + alpha * d;
-  // we want an inner normal if we are inside the sphere
-  if (r.length2() < 1) isec_normal *= -1;
-
-  return RayIntersection{isec_point, isec_normal};
-}
-
-
 TrianglesGeometry::TrianglesGeometry(
     const std::vector<std::array<double4, 3>> &triangles) {
   for (const auto &triangle : triangles) {
@@ -76,32 +29,52 @@ TrianglesGeometry::TrianglesGeometry(
   }
 }
 
-std::optional<RayIntersection> TrianglesGeometry::IntersectWithRay(
+namespace {
+
+// The hit on the unit XY triangle that t transforms, and its squared
+// distance to the ray origin.
+std::optional<RayIntersection> HitTriangle(const AffineTransform &t,
+                                           const Ray &ray, double *len2) {
+  Ray t_ray = {t.ApplyInverse(ray.origin), t.ApplyInverse(ray.direction)};
+
+  double d = t_ray.origin.z() * t_ray.direction.z();
+  if (d >= 0) return {};
+
+  double4 r = t_ray.direction * t_ray.origin.z() / t_ray.direction.z();
+  double n = t_ray.origin.z() > 0 ? 1 : -1;
+  RayIntersection t_isec{t_ray.origin - r, double4{0, 0, n, 0}};
+
+  if (t_isec.point.x() < 0 || t_isec.point.y() < 0) return {};
+  if (t_isec.point.x() + t_isec.point.y() > 1) return {};
+  *len2 = length2(t.Apply(r));
+  return RayIntersection{t.Apply(t_isec.point), t.Apply(t_isec.normal)};
+}
+
+}  // namespace
+
+std::optional<RayIntersection> TrianglesGeometry::Intersect(
     const Ray &ray) const {
   std::optional<RayIntersection> isec;
   double len2;
 
   for (const auto &t: transforms_) {
-    Ray t_ray = {t.ApplyInverse(ray.origin), t.ApplyInverse(ray.direction)};
-
-    double d = t_ray.origin.z() * t_ray.direction.z();
-    if (d >= 0) continue;
-
-    double4 r = t_ray.direction * t_ray.origin.z() / t_ray.direction.z();
-    double n = t_ray.origin.z() > 0 ? 1 : -1;
-    RayIntersection t_isec{t_ray.origin - r, double4{0, 0, n, 0}};
-
-    if (t_isec.point.x() < 0 || t_isec.point.y() < 0) continue;
-    if (t_isec.point.x() + t_isec.point.y() > 1) continue;
-    double t_len2 = length2(t.Apply(r));
+    double t_len2;
+    auto t_isec = HitTriangle(t, ray, &t_len2);
+    if (!t_isec) continue;
     if (isec && t_len2 > len2) continue;
 
-    isec = {t.Apply(t_isec.point), t.Apply(t_isec.normal)};
+    isec = t_isec;
     len2 = t_len2;
   }
 
   return isec;
 }
 
+std::optional<RayIntersection> TrianglesGeometry::IntersectTriangle(
+    std::size_t index, const Ray &ray) const {
+  double len2;
+  return HitTriangle(transforms_[index], ray, &len2);
+}
+
 
 }  // namespace deer
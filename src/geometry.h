@@ -5,7 +5,10 @@
 #ifndef DEER_GEOMETRY_H_
 #define DEER_GEOMETRY_H_
 
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstddef>
 #include <optional>
 #include <vector>
 
@@ -16,33 +19,126 @@
 namespace deer {
 
 struct Geometry {
+  // Built-in geometries report their concrete type, so that a scene can be
+  // compiled into homogeneous buckets without RTTI. User geometries are
+  // kCustom and are always intersected through the virtual call.
+  enum struct Kind {
+    kCustom,
+    kXYPlane,
+    kUnitSphere,
+    kTriangles,
+  };
+
   virtual std::optional<RayIntersection> IntersectWithRay(
       const Ray &) const = 0;
+  virtual Kind kind() const { return Kind::kCustom; }
   virtual ~Geometry() {}
 };
 
+// The built-in geometries expose a non-virtual Intersect(), which is what
+// the compiled scene calls directly. They may be subclassed, but their
+// IntersectWithRay and kind() are final, so that a subclass intersects
+// exactly like its base; a geometry that intersects otherwise wraps one
+// instead.
+
 struct XYPlaneGeometry : public Geometry {
+  static constexpr Kind kKind = Kind::kXYPlane;
+
+  std::optional<RayIntersection> Intersect(const Ray &) const;
+
   std::optional<RayIntersection> IntersectWithRay(
-      const Ray &) const override;
+      const Ray &ray) const final {
+    return Intersect(ray);
+  }
+  Kind kind() const final { return kKind; }
 };
 
 struct UnitSphereGeometry : public Geometry {
+  static constexpr Kind kKind = Kind::kUnitSphere;
+
+  std::optional<RayIntersection> Intersect(const Ray &) const;
+
   std::optional<RayIntersection> IntersectWithRay(
-      const Ray &) const override;
+      const Ray &ray) const final {
+    return Intersect(ray);
+  }
+  Kind kind() const final { return kKind; }
 };
 
 class TrianglesGeometry : public Geometry {
  public:
+  static constexpr Kind kKind = Kind::kTriangles;
+
   explicit TrianglesGeometry(
       const std::vector<std::array<double4, 3>> &triangles);
 
+  std::optional<RayIntersection> Intersect(const Ray &) const;
+  // The hit on the index-th triangle alone.
+  std::optional<RayIntersection> IntersectTriangle(std::size_t index,
+                                                   const Ray &) const;
+
   std::optional<RayIntersection> IntersectWithRay(
-      const Ray &) const override;
+      const Ray &ray) const final {
+    return Intersect(ray);
+  }
+  Kind kind() const final { return kKind; }
+
+  // Each triangle is stored as a transform from the unit XY triangle.
+  const std::vector<AffineTransform> &transforms() const {
+    return transforms_;
+  }
 
  private:
   std::vector<AffineTransform> transforms_;
 };
 
+
+inline std::optional<RayIntersection> XYPlaneGeometry::Intersect(
+    const Ray &ray) const {
+  double d = ray.origin.z() * ray.direction.z();
+  if (d >= 0) return {};
+
+  double4 r = ray.direction * ray.origin.z() / ray.direction.z();
+  double n = ray.origin.z() > 0 ? 1 : -1;
+  return RayIntersection{ray.origin - r, double4{0, 0, n, 0}};
+}
+
+inline std::optional<RayIntersection> UnitSphereGeometry::Intersect(
+    const Ray &ray) const {
+  double4 r = ray.origin - double4{0, 0, 0, 1};
+  double4 d = ray.direction;
+
+  // solving a*alpha^2 + b*alpha + c = 0
+  // where r + alpha*d is our intersection point
+
+  double a = d.x()*d.x() + d.y()*d.y() + d.z()*d.z();
+  double b = 2 * (r.x()*d.x() + r.y()*d.y() + r.z()*d.z());
+  double c = r.x()*r.x() + r.y()*r.y() + r.z()*r.z() - 1;
+
+  // we need only the positive roots
+  if (b > 0 && c > 0) return {};
+
+  double discriminant = b*b - 4*a*c;
+  if (discriminant < 0) return {};
+  double alpha1 = (-b - std::sqrt(discriminant)) / (2 * a);
+  double alpha2 = (-b + std::sqrt(discriminant)) / (2 * a);
+
+  double alpha;
+
+  // we want the closest intersection "in front" of the origin
+  if (alpha1 >= 0 && alpha2 >= 0) alpha = std::min(alpha1, alpha2);
+  else if (alpha1 >= 0) alpha = alpha1;
+  else if (alpha2 >= 0) alpha = alpha2;
+  else return {};
+
+  double4 isec_point = ray.origin + alpha * d;
+  double4 isec_normal = r + alpha * d;
+  // we want an inner normal if we are inside the sphere
+  if (r.length2() < 1) isec_normal *= -1;
+
+  return RayIntersection{isec_point, isec_normal};
+}
+
 }  // namespace deer
 
 #endif  // DEER_GEOMETRY_H_
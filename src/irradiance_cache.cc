@@ -0,0 +1,232 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "irradiance_cache.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "vector.h"
+
+namespace deer {
+
+namespace {
+
+// Octree nodes deeper than this keep all their records themselves.
+constexpr int kMaxDepth = 40;
+
+std::size_t ChildIndex(const double4 &center, const double4 &point) {
+  return (point[0] >= center[0]) | (point[1] >= center[1]) << 1 |
+         (point[2] >= center[2]) << 2;
+}
+
+double4 ChildCenter(const double4 &center, double half_size,
+                    std::size_t index) {
+  const double offset = half_size / 2;
+  return double4{center[0] + (index & 1 ? offset : -offset),
+                 center[1] + (index & 2 ? offset : -offset),
+                 center[2] + (index & 4 ? offset : -offset), 1};
+}
+
+// Whether the point is inside the cube, grown by margin on every side.
+bool Inside(const double4 &center, double half_size, double margin,
+            const double4 &point) {
+  for (std::size_t i = 0; i < 3; i++) {
+    if (std::abs(point[i] - center[i]) > half_size + margin) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+IrradianceCache::Node::~Node() {
+  for (auto &child : children) delete child.load();
+  for (Entry *entry = entries.load(); entry;) {
+    Entry *next = entry->next;
+    delete entry;
+    entry = next;
+  }
+}
+
+IrradianceCache::IrradianceCache(double accuracy, const double4 &center,
+                                 double size)
+    : accuracy_(accuracy), root_(center, size / 2) {}
+
+IrradianceCache::~IrradianceCache() {}
+
+std::optional<double3> IrradianceCache::Lookup(const double4 &point,
+                                               const double4 &normal) const {
+  double3 sum{0, 0, 0};
+  double total_weight = 0;
+
+  auto use_records = [&](const Node &node) {
+    for (const Entry *entry = node.entries.load(std::memory_order_acquire);
+         entry; entry = entry->next) {
+      const Record &record = entry->record;
+      const double4 offset = point - record.point;
+      // Records in front of the point see another part of the scene.
+      if (dot(offset, normal + record.normal) < -0.1 * record.radius) {
+        continue;
+      }
+      const double error = length(offset) / record.radius +
+          std::sqrt(std::max(0.0, 1 - dot(normal, record.normal)));
+      if (error >= accuracy_) continue;
+      const double weight = 1 / std::max(error, 1e-9);
+      double3 irradiance = record.irradiance;
+      for (std::size_t axis = 0; axis < 3; axis++) {
+        irradiance += record.gradient[axis] * offset[axis];
+      }
+      sum += irradiance.clamp(double3::zero(), irradiance) * weight;
+      total_weight += weight;
+    }
+  };
+
+  // Depth first, so that at most seven siblings wait on each of the
+  // kMaxDepth levels below the root, and one more on the deepest.
+  std::array<const Node *, 7 * kMaxDepth + 1> stack;
+  std::size_t stack_size = 0;
+  stack[stack_size++] = &root_;
+  while (stack_size > 0) {
+    const Node *node = stack[--stack_size];
+    use_records(*node);
+    for (const auto &child : node->children) {
+      const Node *child_node = child.load(std::memory_order_acquire);
+      // Records of a child reach at most a quarter of its side outside.
+      if (child_node && Inside(child_node->center, child_node->half_size,
+                               child_node->half_size / 2, point)) {
+        stack[stack_size++] = child_node;
+      }
+    }
+  }
+
+  if (total_weight <= 0) return {};
+  return sum / total_weight;
+}
+
+void IrradianceCache::Insert(const Record &record) {
+  Node *node = &root_;
+  if (Inside(root_.center, root_.half_size, 0, record.point)) {
+    for (int depth = 0; depth < kMaxDepth &&
+                        record.radius <= node->half_size / 4; depth++) {
+      const std::size_t index = ChildIndex(node->center, record.point);
+      Node *child = node->children[index].load(std::memory_order_acquire);
+      if (!child) {
+        Node *new_child = new Node(
+            ChildCenter(node->center, node->half_size, index),
+            node->half_size / 2);
+        if (node->children[index].compare_exchange_strong(
+                child, new_child, std::memory_order_acq_rel)) {
+          child = new_child;
+        } else {
+          delete new_child;  // another thread got there first
+        }
+      }
+      node = child;
+    }
+  }
+
+  Entry *entry = new Entry{record, node->entries.load()};
+  while (!node->entries.compare_exchange_weak(
+      entry->next, entry, std::memory_order_acq_rel)) {}
+  size_++;
+}
+
+IrradianceCache::Record IrradianceCache::Sample(
+    const double4 &point, const double4 &normal,
+    std::size_t m, std::size_t n, double min_radius, double max_radius,
+    const std::function<double2(std::size_t)> &jitter,
+    const std::function<Incoming(const double4 &, std::size_t)>
+        &incoming) {
+  m = std::max<std::size_t>(m, 1);
+  n = std::max<std::size_t>(n, 1);
+  const double pi = std::acos(-1);
+
+  // Duff et al.'s branchless orthonormal basis.
+  const double sign = std::copysign(1.0, normal[2]);
+  const double a = -1 / (sign + normal[2]);
+  const double b = normal[0] * normal[1] * a;
+  const double4 tangent{1 + sign * normal[0] * normal[0] * a, sign * b,
+                        -sign * normal[0], 0};
+  const double4 bitangent{b, sign + normal[1] * normal[1] * a, -normal[1], 0};
+
+  std::vector<double3> radiance(m * n);
+  std::vector<double> distance(m * n);
+  double3 sum{0, 0, 0};
+  double inverse_distance_sum = 0;
+  for (std::size_t j = 0; j < m; j++) {
+    for (std::size_t k = 0; k < n; k++) {
+      const std::size_t stratum = j * n + k;
+      const double2 u = jitter(stratum);
+      const double sin2 = (j + u[0]) / m;
+      const double sin_theta = std::sqrt(sin2);
+      const double cos_theta = std::sqrt(std::max(0.0, 1 - sin2));
+      const double phi = 2 * pi * (k + u[1]) / n;
+      const double4 direction = sin_theta * std::cos(phi) * tangent +
+          sin_theta * std::sin(phi) * bitangent + cos_theta * normal;
+      const Incoming in = incoming(direction, stratum);
+      radiance[stratum] = in.radiance;
+      distance[stratum] = in.distance;
+      sum += in.radiance;
+      inverse_distance_sum += 1 / in.distance;
+    }
+  }
+
+  Record record;
+  record.point = point;
+  record.normal = normal;
+  record.irradiance = sum / static_cast<double>(m * n);
+  record.radius = std::clamp(inverse_distance_sum > 0
+      ? m * n / inverse_distance_sum : max_radius, min_radius, max_radius);
+
+  // Ward and Heckbert's translational gradient of the irradiance, from
+  // how fast the polar and the azimuthal stratum borders sweep over the
+  // surfaces around as the point moves.
+  double4 gradient[3] = {double4::zero(), double4::zero(), double4::zero()};
+  for (std::size_t k = 0; k < n; k++) {
+    const double phi = 2 * pi * (k + 0.5) / n;
+    const double phi_border = 2 * pi * k / n;
+    const double4 u_k = std::cos(phi) * tangent + std::sin(phi) * bitangent;
+    const double4 v_k = -std::sin(phi_border) * tangent +
+                        std::cos(phi_border) * bitangent;
+    const std::size_t previous_k = (k + n - 1) % n;
+    for (std::size_t j = 0; j < m; j++) {
+      const std::size_t stratum = j * n + k;
+      if (j > 0) {
+        const std::size_t below = (j - 1) * n + k;
+        const double sin_theta = std::sqrt(double(j) / m);
+        const double cos2_theta = 1 - double(j) / m;
+        const double scale = 2 * pi / n * sin_theta * cos2_theta /
+            std::min(distance[stratum], distance[below]);
+        const double3 change = (radiance[stratum] - radiance[below]) * scale;
+        for (std::size_t c = 0; c < 3; c++) gradient[c] += u_k * change[c];
+      }
+      if (n > 1) {
+        const std::size_t before = j * n + previous_k;
+        // The integral of cos(theta) sin(theta) over the stratum's polar
+        // range, where Ward and Heckbert leave out the cosine; with it
+        // the gradient matches finite differences much more closely.
+        const double sin_middle = std::sqrt((j + 0.5) / m);
+        const double scale = 0.5 / m /
+            (sin_middle * std::min(distance[stratum], distance[before]));
+        const double3 change = (radiance[stratum] - radiance[before]) * scale;
+        for (std::size_t c = 0; c < 3; c++) gradient[c] += v_k * change[c];
+      }
+    }
+  }
+  // The sums are of the irradiance itself, not over pi.
+  for (std::size_t axis = 0; axis < 3; axis++) {
+    for (std::size_t c = 0; c < 3; c++) {
+      record.gradient[axis][c] = gradient[c][axis] / pi;
+    }
+  }
+  return record;
+}
+
+}  // namespace deer
@@ -0,0 +1,104 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#ifndef DEER_IRRADIANCE_CACHE_H_
+#define DEER_IRRADIANCE_CACHE_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <optional>
+
+#include "vector.h"
+
+namespace deer {
+
+// Sparse samples of the diffuse indirect light, after Ward et al. Every
+// record holds the irradiance at a point, the radius within which it
+// can be trusted, from the harmonic mean distance to the surfaces around
+// it, and its gradient along the surface. A point near enough to records
+// with a similar normal takes their weighted average, extrapolated by
+// the gradients, instead of sampling the hemisphere itself.
+//
+// Records live in an octree. Lookups and inserts may run on any number
+// of threads at once; inserts are lock-free. A cache stays valid for as
+// long as the scene does not change, so it can be kept across frames.
+class IrradianceCache {
+ public:
+  struct Record {
+    double4 point;
+    double4 normal;  // of unit length
+    // The cosine-weighted mean of the incoming radiance, which is the
+    // irradiance over pi.
+    double3 irradiance;
+    double radius;
+    // Of the irradiance along the x, y and z axes.
+    std::array<double3, 3> gradient;
+  };
+
+  // The radiance coming from a direction, and from how far.
+  struct Incoming {
+    double3 radiance;
+    double distance;
+  };
+
+  // Ward's a: roughly the relative error allowed. Points within
+  // accuracy times its radius of a record use it. The octree covers a
+  // cube of the given size around the center; records outside it still
+  // work, just slower.
+  explicit IrradianceCache(double accuracy = 0.2,
+                           const double4 &center = double4{0, 0, 0, 1},
+                           double size = 1e4);
+  ~IrradianceCache();
+  IrradianceCache(const IrradianceCache &) = delete;
+  IrradianceCache &operator=(const IrradianceCache &) = delete;
+
+  double accuracy() const { return accuracy_; }
+  std::size_t size() const { return size_; }
+
+  // The interpolated irradiance at the point, if records cover it.
+  std::optional<double3> Lookup(const double4 &point,
+                                const double4 &normal) const;
+  void Insert(const Record &);
+
+  // Samples the hemisphere over the point in an m x n grid of
+  // cosine-weighted strata, m in the polar angle by n in the azimuth,
+  // jittered by jitter(stratum), where incoming(direction, stratum)
+  // traces each direction. The gradient is after Ward and Heckbert, from
+  // the differences between neighbouring strata. The radius is kept within
+  // [min_radius, max_radius].
+  static Record Sample(
+      const double4 &point, const double4 &normal,
+      std::size_t m, std::size_t n, double min_radius, double max_radius,
+      const std::function<double2(std::size_t)> &jitter,
+      const std::function<Incoming(const double4 &, std::size_t)>
+          &incoming);
+
+ private:
+  struct Entry {
+    Record record;
+    Entry *next;
+  };
+
+  // A cube of side 2 * half_size. Holds the records that are inside it
+  // and have a radius of at least a quarter of its children's side.
+  struct Node {
+    double4 center;
+    double half_size;
+    std::atomic<Entry *> entries{nullptr};
+    std::array<std::atomic<Node *>, 8> children{};
+
+    Node(const double4 &c, double h) : center(c), half_size(h) {}
+    ~Node();
+  };
+
+  double accuracy_;
+  Node root_;
+  std::atomic<std::size_t> size_{0};
+};
+
+}  // namespace deer
+
+#endif  // DEER_IRRADIANCE_CACHE_H_
@@ -0,0 +1,158 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "light_tree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "rgb.h"
+#include "scene.h"
+#include "spectrum.h"
+#include "vector.h"
+
+namespace deer {
+
+namespace {
+
+// Of the midpoint rule for the power of a light.
+constexpr int kPowerBins = 64;
+
+// The mean absolute intensity over the bands of the profile.
+double Power(const Spectrum &spectrum, const RgbColorProfile &profile) {
+  const double3 widths = profile.band_widths();
+  const double3 band_min = profile.wavelengths - widths / 2.0;
+  const double3 band_max = profile.wavelengths + widths / 2.0;
+  const double min_wavelength =
+      *std::min_element(band_min.begin(), band_min.end());
+  const double max_wavelength =
+      *std::max_element(band_max.begin(), band_max.end());
+  double sum = 0;
+  for (int i = 0; i < kPowerBins; i++) {
+    sum += std::abs(spectrum(min_wavelength + (max_wavelength -
+        min_wavelength) * (i + 0.5) / kPowerBins));
+  }
+  return sum / kPowerBins;
+}
+
+}  // namespace
+
+LightTree::LightTree(
+    const std::vector<std::shared_ptr<PointLightSource>> &lights,
+    const RgbColorProfile &profile) {
+  std::vector<Item> items;
+  for (std::size_t i = 0; i < lights.size(); i++) {
+    const PointLightSource &light = *lights[i];
+    const double3 center{light.position[0], light.position[1],
+                         light.position[2]};
+    const double3 radius{light.softness, light.softness, light.softness};
+    items.push_back(Item{center - radius, center + radius,
+                         Power(light.spectrum, profile), std::uint32_t(i)});
+  }
+  leaves_.resize(items.size());
+  if (items.empty()) return;
+  nodes_.reserve(2 * items.size() - 1);
+  Build(items.begin(), items.end());
+  nodes_[0].parent = kNone;
+}
+
+// Splits the lights in two halves along the longest side of the box of
+// their centers.
+std::uint32_t LightTree::Build(std::vector<Item>::iterator begin,
+                               std::vector<Item>::iterator end) {
+  const std::uint32_t index = nodes_.size();
+  nodes_.push_back(Node{begin->min, begin->max, 0, kNone, kNone, kNone,
+                        begin->light});
+  if (end - begin == 1) {
+    nodes_[index].power = begin->power;
+    leaves_[begin->light] = index;
+    return index;
+  }
+
+  double3 min_center = (begin->min + begin->max) / 2;
+  double3 max_center = min_center;
+  for (auto it = begin; it != end; it++) {
+    const double3 center = (it->min + it->max) / 2;
+    for (std::size_t axis = 0; axis < 3; axis++) {
+      min_center[axis] = std::min(min_center[axis], center[axis]);
+      max_center[axis] = std::max(max_center[axis], center[axis]);
+    }
+  }
+  const double3 extent = max_center - min_center;
+  const std::size_t axis = extent[0] >= extent[1] && extent[0] >= extent[2]
+      ? 0 : extent[1] >= extent[2] ? 1 : 2;
+  const auto middle = begin + (end - begin) / 2;
+  std::nth_element(begin, middle, end, [axis](const Item &a, const Item &b) {
+    return a.min[axis] + a.max[axis] < b.min[axis] + b.max[axis];
+  });
+
+  const std::uint32_t left = Build(begin, middle);
+  const std::uint32_t right = Build(middle, end);
+  Node &node = nodes_[index];
+  node.left = left;
+  node.right = right;
+  node.power = nodes_[left].power + nodes_[right].power;
+  for (std::size_t i = 0; i < 3; i++) {
+    node.min[i] = std::min(nodes_[left].min[i], nodes_[right].min[i]);
+    node.max[i] = std::max(nodes_[left].max[i], nodes_[right].max[i]);
+  }
+  nodes_[left].parent = nodes_[right].parent = index;
+  return index;
+}
+
+// Power over the squared distance to the center of the bounds, but no
+// more than over the squared half diagonal, so that points among the
+// lights do not single out whichever half is nearest.
+double LightTree::Importance(const Node &node, const double4 &point) const {
+  const double3 p{point[0], point[1], point[2]};
+  const double distance2 = length2((node.min + node.max) / 2 - p);
+  const double radius2 = length2(node.max - node.min) / 4;
+  const double scale2 = std::max(distance2, radius2);
+  return scale2 > 0 ? node.power / scale2 : node.power;
+}
+
+std::optional<LightTree::Choice> LightTree::Sample(const double4 &point,
+                                                   double u) const {
+  if (nodes_.empty() || nodes_[0].power <= 0) return {};
+  double probability = 1;
+  const Node *node = &nodes_[0];
+  while (!node->leaf()) {
+    const double left = Importance(nodes_[node->left], point);
+    const double right = Importance(nodes_[node->right], point);
+    if (left + right <= 0) return {};
+    const double p_left = left / (left + right);
+    if (u < p_left) {
+      u /= p_left;
+      probability *= p_left;
+      node = &nodes_[node->left];
+    } else {
+      u = std::min((u - p_left) / (1 - p_left), 1.0);
+      probability *= 1 - p_left;
+      node = &nodes_[node->right];
+    }
+  }
+  return Choice{node->light, probability};
+}
+
+double LightTree::Probability(const double4 &point,
+                              std::size_t light) const {
+  if (nodes_.empty() || nodes_[0].power <= 0) return 0;
+  double probability = 1;
+  for (std::uint32_t index = leaves_[light]; nodes_[index].parent != kNone;
+       index = nodes_[index].parent) {
+    const Node &parent = nodes_[nodes_[index].parent];
+    const double left = Importance(nodes_[parent.left], point);
+    const double right = Importance(nodes_[parent.right], point);
+    if (left + right <= 0) return 0;
+    probability *= (index == parent.left ? left : right) / (left + right);
+  }
+  return probability;
+}
+
+}  // namespace deer
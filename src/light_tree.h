@@ -0,0 +1,75 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#ifndef DEER_LIGHT_TREE_H_
+#define DEER_LIGHT_TREE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "rgb.h"
+#include "scene.h"
+#include "vector.h"
+
+namespace deer {
+
+// A binary tree over point light sources for picking one at random, with
+// a probability roughly proportional to how much it lights a given point.
+// Every node knows the total power of its lights and their bounds, and
+// the walk down the tree goes to either child in proportion to its power
+// over the squared distance to it, so a pick takes O(log n) steps.
+class LightTree {
+ public:
+  struct Choice {
+    std::size_t light;  // index into the list the tree was built from
+    double probability;
+  };
+
+  // Lights are weighed by their power over the bands of the colour
+  // profile, so that any wavelength a renderer samples counts, not only
+  // the profile's own three.
+  LightTree(const std::vector<std::shared_ptr<PointLightSource>> &lights,
+            const RgbColorProfile &profile);
+
+  std::size_t size() const { return leaves_.size(); }
+
+  // Picks a light for the point, with u uniform in [0, 1); nothing if
+  // there are no lights, or none of them has any power.
+  std::optional<Choice> Sample(const double4 &point, double u) const;
+
+  // The probability that Sample picks the light for the point.
+  double Probability(const double4 &point, std::size_t light) const;
+
+ private:
+  struct Node {
+    double3 min, max;  // bounds of the lights, softness included
+    double power;
+    // An inner node has both children, a leaf has neither.
+    std::uint32_t left, right;
+    std::uint32_t parent;
+    std::uint32_t light;  // of a leaf
+    bool leaf() const { return left == kNone; }
+  };
+  static constexpr std::uint32_t kNone = ~std::uint32_t{0};
+
+  struct Item {
+    double3 min, max;
+    double power;
+    std::uint32_t light;
+  };
+
+  std::uint32_t Build(std::vector<Item>::iterator begin,
+                      std::vector<Item>::iterator end);
+  double Importance(const Node &, const double4 &point) const;
+
+  std::vector<Node> nodes_;  // the root first
+  std::vector<std::uint32_t> leaves_;  // by light
+};
+
+}  // namespace deer
+
+#endif  // DEER_LIGHT_TREE_H_
@@ -5,12 +5,15 @@
 #include <array>
 #include <chrono>
 #include <cmath>
+#include <cstdlib>
 #include <iomanip>
 #include <iostream>
 #include <memory>
+#include <string>
 #include <utility>
 #include <vector>
 
+#include "distributed.h"
 #include "file_formats/tga.h"
 #include "geometry.h"
 #include "optics.h"
@@ -117,12 +120,24 @@ static Camera SetUpCamera() {
   return camera;
 }
 
-static RayTracer SetUpRayTracer() {
+static RayTracer::Options SetUpRayTracerOptions() {
   RayTracer::Options options;
   options.image_width = 640;
   options.image_height = 360;
   options.color_profile = SetUpColorProfile();
-  return RayTracer(options);
+  options.pixel_layout = PixelLayout::kBgr;  // as TGA stores it
+  return options;
+}
+
+// With workers, renders in that many processes besides this one.
+static std::unique_ptr<Renderer> SetUpRenderer(std::size_t n_workers) {
+  if (n_workers == 0) {
+    return std::make_unique<RayTracer>(SetUpRayTracerOptions());
+  }
+  DistributedRenderer::Options options;
+  options.n_workers = n_workers;
+  return std::make_unique<DistributedRenderer>(SetUpRayTracerOptions(),
+                                               options);
 }
 
 static TgaImageFile::Header SetUpTgaImageFileHeader() {
@@ -149,16 +164,22 @@ static TgaImageFile::Header SetUpTgaImageFileHeader() {
 }
 
 int main(int argc, char **argv) {
-  if (argc <= 1) {
-    std::cout << "Usage: " << argv[0] << " <filename>\n";
+  std::size_t n_workers = 0;
+  int filename_arg = 1;
+  if (argc > 2 && std::string(argv[1]) == "--workers") {
+    n_workers = std::strtoul(argv[2], nullptr, 10);
+    filename_arg = 3;
+  }
+  if (argc <= filename_arg) {
+    std::cout << "Usage: " << argv[0] << " [--workers <n>] <filename>\n";
     return 0;
   }
 
   Scene scene = SetUpScene();
   Camera camera = SetUpCamera();
-  RayTracer renderer = SetUpRayTracer();
+  std::unique_ptr<Renderer> renderer = SetUpRenderer(n_workers);
 
-  auto job_status = renderer.Render(scene, camera);
+  auto job_status = renderer->Render(scene, camera);
 
   std::cout << "Rendering...  0% done";
   while (job_status->amount_done < 1.0) {
@@ -171,10 +192,14 @@ int main(int argc, char **argv) {
   std::cout << "\b\b\b\b\b\b\b\b100% done\n";
 
   auto image_data = job_status->result.get();
+  std::cout << "Tracing: " << job_status->statistics.tracing_seconds
+            << " s, conversion: " << job_status->statistics.conversion_seconds
+            << " s\n";
 
-  TgaImageFile image_file(argv[1], std::ios::out | std::ios::binary);
+  TgaImageFile image_file(argv[filename_arg],
+                          std::ios::out | std::ios::binary);
   image_file.header = SetUpTgaImageFileHeader();
-  image_file.image_data = TgaImageFile::RgbToBgr(std::move(image_data));
+  image_file.image_data = std::move(image_data);
   image_file.Write();
 
   return 0;
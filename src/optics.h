@@ -5,8 +5,12 @@
 #ifndef DEER_OPTICS_H_
 #define DEER_OPTICS_H_
 
+#include <array>
+#include <cmath>
+#include <cstddef>
 #include <optional>
 #include <memory>
+#include <vector>
 
 #include "spectrum.h"
 #include "vector.h"
@@ -18,8 +22,50 @@ struct Material {
   Spectrum diffusion_spectrum;
   Spectrum specular_spectrum;
   double shininess;
+
+  // Fractions of the light that is mirrored and that passes through, with
+  // the refractive index relative to the outside; the rest is shaded by
+  // the terms above.
+  double reflectivity = 0;
+  double transparency = 0;
+  double refractive_index = 1;
+};
+
+// The terms of the Phong model a material actually needs, so that the
+// renderer can shade it with a kernel specialized for them.
+struct MaterialFeatures {
+  static constexpr int kDynamicShininess = -1;
+  static constexpr int kMaxStaticShininess = 8;
+
+  bool diffuse = true;
+  bool specular = true;
+  // A small integer shininess is baked into the kernel.
+  int shininess = kDynamicShininess;
+
+  friend bool operator==(const MaterialFeatures &a,
+                         const MaterialFeatures &b) {
+    return a.diffuse == b.diffuse && a.specular == b.specular &&
+        a.shininess == b.shininess;
+  }
 };
 
+inline MaterialFeatures ClassifyMaterial(const Material &material) {
+  auto is_zero = [](const Spectrum &spectrum) {
+    auto value = spectrum.constant_value();
+    return value && *value == 0;
+  };
+
+  MaterialFeatures features;
+  features.diffuse = !is_zero(material.diffusion_spectrum);
+  features.specular = !is_zero(material.specular_spectrum);
+  if (material.shininess >= 0 &&
+      material.shininess <= MaterialFeatures::kMaxStaticShininess &&
+      material.shininess == std::floor(material.shininess)) {
+    features.shininess = static_cast<int>(material.shininess);
+  }
+  return features;
+}
+
 struct RayIntersection {
   double4 point;
   double4 normal;
@@ -34,8 +80,45 @@ struct Ray {
   Ray ReflectOff(const RayIntersection &isec) const {
     return Ray{isec.point, direction.reflect_off(isec.normal), spectrum};
   }
+};
+
+// Rays in structure-of-arrays layout, to go through a scene together.
+class RayBatch {
+ public:
+  std::size_t size() const { return origin_[0].size(); }
+
+  double4 origin(std::size_t i) const {
+    return double4{origin_[0][i], origin_[1][i], origin_[2][i],
+                   origin_[3][i]};
+  }
+  double4 direction(std::size_t i) const {
+    return double4{direction_[0][i], direction_[1][i], direction_[2][i],
+                   direction_[3][i]};
+  }
+
+  // All the coordinates along one axis.
+  const double *origins(std::size_t axis) const {
+    return origin_[axis].data();
+  }
+  const double *directions(std::size_t axis) const {
+    return direction_[axis].data();
+  }
+
+  void PushBack(const double4 &origin, const double4 &direction) {
+    for (std::size_t k = 0; k < 4; k++) {
+      origin_[k].push_back(origin[k]);
+      direction_[k].push_back(direction[k]);
+    }
+  }
+  void Clear() {
+    for (std::size_t k = 0; k < 4; k++) {
+      origin_[k].clear();
+      direction_[k].clear();
+    }
+  }
 
-  // TODO(iliazeus): refraction
+ private:
+  std::array<std::vector<double>, 4> origin_, direction_;
 };
 
 }  // namespace deer
@@ -0,0 +1,376 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "path_tracer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "color_conversion.h"
+#include "compiled_scene.h"
+#include "framebuffer.h"
+#include "irradiance_cache.h"
+#include "optics.h"
+#include "sampler.h"
+#include "scene.h"
+#include "scheduler.h"
+#include "tile_job.h"
+#include "vector.h"
+
+namespace deer {
+
+namespace {
+
+// Sampler dimensions of the random decisions for a pixel sample: the
+// subpixel offset, then four per bounce.
+constexpr std::size_t kSubpixelDimension = 0;  // and 1
+constexpr std::size_t kBounceDimensions = 4;
+constexpr std::size_t kDirectionDimension = 2;  // and 3, plus 4 per bounce
+constexpr std::size_t kEventDimension = 4;
+constexpr std::size_t kRouletteDimension = 5;
+
+// A material with its spectra evaluated at the profile wavelengths.
+struct MaterialColors {
+  const Material *material = nullptr;
+  double3 ambiance, diffusion, specular;
+};
+
+MaterialColors EvaluateMaterial(const Material &material,
+                                const double3 &wavelengths) {
+  return MaterialColors{&material,
+                        material.ambiance_spectrum(wavelengths),
+                        material.diffusion_spectrum(wavelengths),
+                        material.specular_spectrum(wavelengths)};
+}
+
+struct LightColors {
+  double4 position;
+  double3 color;
+};
+
+// Everything a path needs from the scene, evaluated once per render.
+struct PathScene {
+  const CompiledScene &compiled_scene;
+  double max_distance2;
+  double3 sky, ambiance;
+  std::vector<LightColors> lights;
+  // By object index; custom objects are evaluated on every hit instead.
+  std::vector<MaterialColors> object_colors;
+};
+
+PathScene MakePathScene(const CompiledScene &compiled_scene,
+                        const PathTracer::Options &options) {
+  const Scene &scene = compiled_scene.scene();
+  const double3 &wavelengths = options.color_profile.wavelengths;
+  PathScene path_scene{compiled_scene,
+                       options.max_distance * options.max_distance,
+                       scene.sky_spectrum(wavelengths),
+                       scene.ambiance_spectrum(wavelengths), {}, {}};
+  for (const auto &light : scene.point_light_sources()) {
+    path_scene.lights.push_back(
+        LightColors{light->position, light->spectrum(wavelengths)});
+  }
+  for (const auto &object : scene.objects()) {
+    const GeometryObject *geometry_object = object->AsGeometryObject();
+    path_scene.object_colors.push_back(
+        geometry_object && geometry_object->material()
+            ? EvaluateMaterial(*geometry_object->material(), wavelengths)
+            : MaterialColors());
+  }
+  return path_scene;
+}
+
+// Direct light from the point light sources, with the Phong terms of
+// RayTracer, but only of the lights in front of the surface, and with
+// every light taken as a point. RayTracer also adds the terms of lights
+// behind the surface that no shadow ray blocks, negative as they are,
+// and samples the area of soft lights; so the two only agree without
+// bounces where every light is hard and in front of what it lights.
+double3 DirectLight(const PathScene &scene, const CompiledScene::Hit &hit,
+                    const double4 &normal, const MaterialColors &colors) {
+  const double kLightingEps = 1e-6;
+  double3 diffuse{0, 0, 0}, specular{0, 0, 0};
+  for (const auto &light : scene.lights) {
+    const double4 ray_origin = hit.point + kLightingEps * hit.normal;
+    const double4 ray_direction = light.position - ray_origin;
+    const double cos_light = dot(normal, ray_direction);
+    if (cos_light <= 0) continue;
+    if (scene.compiled_scene.Occluded(Ray{ray_origin, ray_direction},
+                                      length2(ray_direction))) {
+      continue;
+    }
+
+    const double4 nl = ray_direction / length(ray_direction);
+    diffuse += light.color * dot(normal, nl);
+    const double cos_reflected = dot(normal, -nl.reflect_off(normal));
+    if (cos_reflected > 0) {
+      specular += light.color *
+          std::pow(cos_reflected, colors.material->shininess);
+    }
+  }
+  return colors.diffusion * diffuse + colors.specular * specular;
+}
+
+// A direction around the normal with a density proportional to the
+// cosine to it; Duff et al.'s branchless orthonormal basis.
+double4 CosineWeightedDirection(const double4 &normal, const double2 &u) {
+  const double sign = std::copysign(1.0, normal[2]);
+  const double a = -1 / (sign + normal[2]);
+  const double b = normal[0] * normal[1] * a;
+  const double4 tangent{1 + sign * normal[0] * normal[0] * a, sign * b,
+                        -sign * normal[0], 0};
+  const double4 bitangent{b, sign + normal[1] * normal[1] * a, -normal[1], 0};
+
+  const double pi = std::acos(-1);
+  const double r = std::sqrt(u[0]);
+  const double phi = 2 * pi * u[1];
+  return r * std::cos(phi) * tangent + r * std::sin(phi) * bitangent +
+         std::sqrt(std::max(0.0, 1 - u[0])) * normal;
+}
+
+constexpr double kSecondaryEps = 1e-6;
+
+double3 TracePath(const PathScene &scene, const PathTracer::Options &options,
+                  const Sampler &sampler, std::size_t pixel,
+                  std::size_t sample, Ray ray, std::size_t first_bounce = 0,
+                  double *distance = nullptr);
+
+// The cosine-weighted mean radiance arriving at a diffuse hit, from the
+// irradiance cache, or from a new record if none covers the point. The
+// record's rays are samples of the pixel past samples_per_pixel.
+double3 CachedIrradiance(const PathScene &scene,
+                         const PathTracer::Options &options,
+                         const Sampler &sampler, std::size_t pixel,
+                         std::size_t sample, const double4 &point,
+                         const double4 &normal) {
+  IrradianceCache &cache = *options.irradiance_cache;
+  if (const auto irradiance = cache.Lookup(point, normal)) {
+    return *irradiance;
+  }
+
+  // Ward's n = pi m strata.
+  const double pi = std::acos(-1);
+  const std::size_t n_rays =
+      std::max<std::size_t>(1, options.irradiance_samples);
+  const std::size_t m = std::max<std::size_t>(1, std::lround(
+      std::sqrt(n_rays / pi)));
+  const std::size_t n = std::max<std::size_t>(1, n_rays / m);
+  const std::size_t first_sample =
+      std::max<std::size_t>(1, options.samples_per_pixel) + sample * m * n;
+  const double4 origin = point + kSecondaryEps * normal;
+
+  const auto record = IrradianceCache::Sample(point, normal, m, n,
+      options.min_irradiance_radius, options.max_irradiance_radius,
+      [&](std::size_t stratum) {
+        return sampler.Get2D(pixel, first_sample + stratum,
+                             kSubpixelDimension);
+      },
+      [&](const double4 &direction, std::size_t stratum) {
+        IrradianceCache::Incoming incoming;
+        incoming.radiance = TracePath(scene, options, sampler, pixel,
+                                      first_sample + stratum,
+                                      Ray{origin, direction}, 1,
+                                      &incoming.distance);
+        return incoming;
+      });
+  cache.Insert(record);
+  return record.irradiance;
+}
+
+// The radiance along one path through a pixel sample. Paths that start
+// at first_bounce > 0 continue others, so they get no ambient light and
+// no cached irradiance. The distance to the first hit, infinite on a
+// miss, goes to distance if given.
+double3 TracePath(const PathScene &scene, const PathTracer::Options &options,
+                  const Sampler &sampler, std::size_t pixel,
+                  std::size_t sample, Ray ray, std::size_t first_bounce,
+                  double *distance) {
+  const double3 &wavelengths = options.color_profile.wavelengths;
+  // Only ever used on the first diffuse hit, where the path is over.
+  const bool use_cache = options.irradiance_cache && first_bounce == 0;
+  double3 radiance{0, 0, 0};
+  double3 throughput{1, 1, 1};
+
+  for (std::size_t bounce = first_bounce; ; bounce++) {
+    const auto hit = scene.compiled_scene.Intersect(ray);
+    const bool missed = !hit || hit->distance2 > scene.max_distance2;
+    if (distance && bounce == first_bounce) {
+      *distance = missed ? std::numeric_limits<double>::infinity()
+                         : length(hit->point - ray.origin);
+    }
+    if (missed) {
+      radiance += throughput * scene.sky;
+      break;
+    }
+
+    MaterialColors colors = scene.object_colors[hit->object];
+    if (colors.material != hit->material) {
+      colors = EvaluateMaterial(*hit->material, wavelengths);
+    }
+    const Material &material = *hit->material;
+
+    const double4 direction = ray.direction / length(ray.direction);
+    double4 normal = hit->normal / length(hit->normal);
+    const bool entering = dot(direction, normal) < 0;
+    if (!entering) normal = -normal;
+
+    if (bounce == 0) radiance += throughput * colors.ambiance * scene.ambiance;
+    const double local = 1 - material.reflectivity - material.transparency;
+    if (local > 0) {
+      radiance += throughput * local *
+                  DirectLight(scene, *hit, normal, colors);
+      if (use_cache && bounce < options.max_bounces) {
+        radiance += throughput * local * colors.diffusion *
+            CachedIrradiance(scene, options, sampler, pixel, sample,
+                             hit->point, normal);
+      }
+    }
+    if (bounce == options.max_bounces) break;
+
+    // Picks a mirrored, refracted or diffuse continuation with the
+    // probability of its weight, so only the albedo changes throughput.
+    const std::size_t dimensions = bounce * kBounceDimensions;
+    const double event =
+        sampler.Get(pixel, sample, dimensions + kEventDimension);
+    double4 next_direction;
+    double offset = kSecondaryEps;
+    if (event < material.reflectivity) {
+      next_direction = direction.reflect_off(normal);
+    } else if (event < material.reflectivity + material.transparency) {
+      const double eta = entering ? 1 / material.refractive_index
+                                  : material.refractive_index;
+      next_direction = direction.refract_through(normal, eta);
+      if (next_direction == double4::zero()) {
+        next_direction = direction.reflect_off(normal);
+      } else {
+        offset = -kSecondaryEps;
+      }
+    } else {
+      if (use_cache) break;  // the cache has the diffuse light already
+      next_direction = CosineWeightedDirection(normal,
+          sampler.Get2D(pixel, sample, dimensions + kDirectionDimension));
+      throughput *= colors.diffusion;
+    }
+
+    if (bounce + 1 >= options.roulette_depth) {
+      const double survival = std::min(1.0, std::max(
+          {throughput[0], throughput[1], throughput[2]}));
+      if (sampler.Get(pixel, sample, dimensions + kRouletteDimension) >=
+          survival) {
+        break;
+      }
+      throughput /= survival;
+    }
+
+    ray = Ray{hit->point + offset * normal, next_direction};
+  }
+  return radiance;
+}
+
+std::vector<std::uint8_t> RenderPaths(
+    const PathTracer &tracer, const Scene &scene, const Camera &camera,
+    std::shared_ptr<SharedFramebuffer> framebuffer,
+    std::shared_ptr<Renderer::JobStatus> job_status) {
+  const auto &options = tracer.options;
+  const std::size_t width = options.image_width;
+  const std::size_t height = options.image_height;
+  const std::size_t samples_per_pixel =
+      std::max<std::size_t>(1, options.samples_per_pixel);
+  const std::size_t samples_per_pass = std::clamp<std::size_t>(
+      options.samples_per_pass, 1, samples_per_pixel);
+  const double amount_done_per_sample =
+      1.0 / (width * height * samples_per_pixel);
+
+  TileJob job(job_status, options.n_threads, options.work_stealing,
+              options.time_limit);
+  const CompiledScene compiled_scene(scene, options.geometry_dispatch);
+  const PathScene path_scene = MakePathScene(compiled_scene, options);
+  const Sampler sampler(options.sample_sequence, width, options.sample_seed);
+
+  const std::size_t tile_size = ClampTileSize(options.tile_size);
+  const auto tiles = MakeTiles(width, height, tile_size, options.tile_order);
+  // Every tile belongs to one thread at a time, so threads add their
+  // samples to the sums without synchronization.
+  std::vector<double3> sums(width * height, double3::zero());
+  std::vector<std::vector<float>> tile_buffers(job.n_threads(),
+      std::vector<float>(tile_size * tile_size * 3));
+  std::vector<std::size_t> n_samples(job.n_threads());
+
+  for (std::size_t first_sample = 0; first_sample < samples_per_pixel;
+       first_sample += samples_per_pass) {
+    const std::size_t last_sample =
+        std::min(first_sample + samples_per_pass, samples_per_pixel);
+
+    const bool done = job.RunPass(tiles, [&](const Tile &tile,
+                                             std::size_t thread) {
+      float *buffer = tile_buffers[thread].data();
+      for (std::size_t y = 0; y < tile.height; y++) {
+        for (std::size_t x = 0; x < tile.width; x++) {
+          const std::size_t row = tile.row + y, col = tile.col + x;
+          const std::size_t pixel = row * width + col;
+          double3 sum = sums[pixel];
+          for (std::size_t i = first_sample; i < last_sample; i++) {
+            const double2 offset =
+                sampler.Get2D(pixel, i, kSubpixelDimension);
+            const Ray ray = camera.RayThroughPixel(
+                row + offset[1], col + offset[0], width, height);
+            sum += TracePath(path_scene, options, sampler, pixel, i, ray);
+          }
+          sums[pixel] = sum;
+          const double3 mean = sum / static_cast<double>(last_sample);
+          float *out = buffer + (y * tile.width + x) * 3;
+          for (std::size_t c = 0; c < 3; c++) out[c] = mean[c];
+        }
+      }
+      framebuffer->WriteTile(tile, buffer);
+
+      const std::size_t n = tile.width * tile.height *
+                            (last_sample - first_sample);
+      n_samples[thread] += n;
+      // A race condition doesn't really bother us here
+      job_status->amount_done += amount_done_per_sample * n;
+    });
+    if (!done) break;
+  }
+  job.EndTracing();
+  for (std::size_t n : n_samples) job_status->statistics.primary_rays += n;
+
+  const ColorConverter converter(options.color_profile, options.gamma,
+                                 options.tone_mapping, options.exposure);
+  return job.Finish(framebuffer->Snapshot(), converter,
+                    options.pixel_layout);
+}
+
+}  // namespace
+
+std::shared_ptr<Renderer::JobStatus> PathTracer::Render(const Scene &scene,
+    const Camera &camera) {
+  auto job_status = std::make_shared<Renderer::JobStatus>();
+  job_status->amount_done = 0;
+  const std::size_t samples_per_pixel =
+      std::max<std::size_t>(1, options.samples_per_pixel);
+  const std::size_t samples_per_pass = std::clamp<std::size_t>(
+      options.samples_per_pass, 1, samples_per_pixel);
+  job_status->passes_total =
+      (samples_per_pixel + samples_per_pass - 1) / samples_per_pass;
+
+  auto framebuffer = std::make_shared<SharedFramebuffer>(
+      options.image_width, options.image_height);
+  job_status->snapshot = ConvertingSnapshot(framebuffer,
+      ColorConverter(options.color_profile, options.gamma,
+                     options.tone_mapping, options.exposure),
+      options.pixel_layout);
+
+  job_status->result = std::async(std::launch::async,
+      RenderPaths, *this, scene, camera, framebuffer, job_status);
+  return job_status;
+}
+
+}  // namespace deer
@@ -0,0 +1,94 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#ifndef DEER_PATH_TRACER_H_
+#define DEER_PATH_TRACER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "color_conversion.h"
+#include "compiled_scene.h"
+#include "irradiance_cache.h"
+#include "renderer.h"
+#include "rgb.h"
+#include "sampler.h"
+#include "scene.h"
+#include "scheduler.h"
+
+namespace deer {
+
+// A Monte Carlo path tracer for global illumination. Every bounce adds
+// the direct light of the point light sources (next-event estimation),
+// with the Phong terms of RayTracer for the lights in front of the
+// surface, taken as points whatever their softness, and continues into a
+// cosine-distributed diffuse direction, or into a mirrored or refracted
+// one with the probability given by the material. Ambient light is only
+// added at the first hit, where there is no indirect light yet.
+//
+// Spectra are evaluated once per render at the colour profile
+// wavelengths, so paths only carry three numbers and allocate nothing.
+// The image depends only on the options, never on how tiles are split
+// between threads.
+class PathTracer : public Renderer {
+ public:
+  struct Options {
+    std::size_t image_width, image_height;
+    RgbColorProfile color_profile;
+    PixelLayout pixel_layout = PixelLayout::kRgb;
+    double gamma = 1;  // applied during conversion to bytes
+    // Also applied during conversion to bytes; the linear image in
+    // JobStatus::image can be converted again with other settings.
+    ToneMapping tone_mapping = ToneMapping::kLinear;
+    double exposure = 1;
+    double max_distance = 1e6;
+    GeometryDispatch geometry_dispatch = GeometryDispatch::kBucketed;
+
+    std::size_t n_threads = 0;  // one per hardware thread
+    std::size_t tile_size = 16;
+    TileOrder tile_order = TileOrder::kMorton;
+    bool work_stealing = true;
+    // Seconds; zero means no limit. On running out, the job stops as if
+    // cancelled, with the samples of the passes done so far.
+    double time_limit = 0;
+
+    std::size_t samples_per_pixel = 16;
+    // Every pass adds this many samples to every pixel, and then updates
+    // the image that JobStatus::snapshot() shows.
+    std::size_t samples_per_pass = 4;
+    // Paths end after max_bounces, and from roulette_depth bounces on
+    // play Russian roulette with their throughput.
+    std::size_t max_bounces = 8;
+    std::size_t roulette_depth = 3;
+
+    SampleSequence sample_sequence = SampleSequence::kSobol;
+    std::uint32_t sample_seed = 0;
+
+    // When set, the diffuse indirect light at the first diffuse hit of a
+    // path comes from this cache instead of from the path going on.
+    // Records are sampled as they are needed; since they hold for as long
+    // as the scene doesn't change, one cache may serve several frames.
+    // That is where it pays off: filling a cold cache costs more than it
+    // saves, so in the same time a single frame comes out noisier than
+    // with brute-force paths.
+    // With more than one thread, which records get made depends on
+    // timing, so the image does too.
+    std::shared_ptr<IrradianceCache> irradiance_cache;
+    // Hemisphere rays per new record, and the bounds of record radii.
+    std::size_t irradiance_samples = 256;
+    double min_irradiance_radius = 0.1;
+    double max_irradiance_radius = 10;
+  };
+  const Options options;
+
+  explicit PathTracer(const Options &opts) : options(opts) {}
+
+  std::shared_ptr<JobStatus> Render(const Scene &,
+                                    const Camera &) override;
+};
+
+}  // namespace deer
+
+#endif  // DEER_PATH_TRACER_H_
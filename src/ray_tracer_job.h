@@ -0,0 +1,86 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#ifndef DEER_RAY_TRACER_JOB_H_
+#define DEER_RAY_TRACER_JOB_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "compiled_scene.h"
+#include "frame_sequence.h"
+#include "framebuffer.h"
+#include "relighter.h"
+#include "renderer.h"
+#include "scene.h"
+#include "scheduler.h"
+#include "vector.h"
+
+namespace deer {
+
+struct FrameSequence::Frame {
+  Camera camera;
+  Framebuffer image;  // before denoising
+  // Of the hits of the rays through the sample anchor of every pixel;
+  // infinity and CompiledScene::kNoObject for misses.
+  std::vector<float> distance;
+  std::vector<std::size_t> object;
+  // x, y, in pixels, of where the colour of each pixel was traced,
+  // relative to its sample anchor; reusing a colour moves it.
+  std::vector<float> drift;
+};
+
+// Every slot is written by the one thread that has the pixel's tile.
+struct Relighter::HitCache {
+  std::size_t samples_per_pixel = 0;  // zero until the first render
+  // Samples are looked up by their pixels in the full image, but only
+  // those of the crop window are kept.
+  std::size_t image_width;
+  Tile window;
+  std::vector<std::uint8_t> known;
+  std::vector<std::optional<CompiledScene::Hit>> hits;
+
+  std::size_t Slot(std::size_t pixel, std::size_t sample) const {
+    const std::size_t row = pixel / image_width - window.row;
+    const std::size_t col = pixel % image_width - window.col;
+    return (row * window.width + col) * samples_per_pixel + sample;
+  }
+};
+
+// Carries a frame sequence from one frame to the next.
+struct Reprojection {
+  std::shared_ptr<const FrameSequence::Frame> previous;  // null to refresh
+  std::shared_ptr<FrameSequence::Frame> next;  // filled in by the job
+  double depth_tolerance;
+  double max_drift;
+};
+
+// Where the samples of a pixel go on average, relative to its top left
+// corner: a single sample goes through the corner, more are spread over
+// the pixel.
+double SampleAnchor(const RayTracer::Options &options);
+
+// The pixel of the previous frame whose anchor ray hit what a hit hit,
+// if it is in view, hit the same object at about the same distance, and
+// has a colour traced close enough to the hit; the drift of the colour
+// from the hit goes into *drift.
+std::optional<std::size_t> ReprojectedPixel(
+    const FrameSequence::Frame &previous, const CompiledScene::Hit &hit,
+    const RayTracer::Options &options, const Tile &window,
+    double depth_tolerance, double max_drift, double2 *drift);
+
+// The job of RayTracer::Render for the views; with a reprojection, of a
+// frame of a sequence; with a hit cache, of a Relighter.
+std::shared_ptr<Renderer::JobStatus> StartRayTracerJob(
+    const RayTracer &tracer, const Scene &scene,
+    const std::vector<Camera> &cameras,
+    std::shared_ptr<const Reprojection> reprojection,
+    std::shared_ptr<Relighter::HitCache> hit_cache);
+
+}  // namespace deer
+
+#endif  // DEER_RAY_TRACER_JOB_H_
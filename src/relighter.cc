@@ -0,0 +1,26 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "relighter.h"
+
+#include <memory>
+
+#include "ray_tracer_job.h"
+#include "renderer.h"
+#include "scene.h"
+
+namespace deer {
+
+Relighter::Relighter(const RayTracer::Options &tracer_options)
+    : tracer(tracer_options), hits_(std::make_shared<HitCache>()) {}
+
+std::shared_ptr<Renderer::JobStatus> Relighter::Render(const Scene &scene,
+                                                       const Camera &camera) {
+  // Unless the caller has taken the result already.
+  if (last_job_ && last_job_->result.valid()) last_job_->result.wait();
+  last_job_ = StartRayTracerJob(tracer, scene, {camera}, nullptr, hits_);
+  return last_job_;
+}
+
+}  // namespace deer
@@ -0,0 +1,44 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#ifndef DEER_RELIGHTER_H_
+#define DEER_RELIGHTER_H_
+
+#include <memory>
+
+#include "renderer.h"
+#include "scene.h"
+
+namespace deer {
+
+// Renders a view over and over while only its lights and materials
+// change, as when lighting a shot. The camera rays of every pixel sample
+// are only traced once; later renders take their hits from a cache, and
+// trace just the shadow rays and the rays off mirrors and glass. The
+// images are the same as RayTracer's.
+//
+// Lights may be moved, added and removed, and materials edited in
+// place, but the objects, their geometry and the camera must stay as
+// they are. The cache takes about 100 bytes per pixel and max_samples.
+class Relighter {
+ public:
+  // The hits of the camera rays, by pixel and sample.
+  struct HitCache;
+
+  explicit Relighter(const RayTracer::Options &tracer_options);
+
+  const RayTracer tracer;
+
+  // Waits for the previous render to be done, if it is not.
+  std::shared_ptr<Renderer::JobStatus> Render(const Scene &,
+                                              const Camera &);
+
+ private:
+  std::shared_ptr<HitCache> hits_;
+  std::shared_ptr<Renderer::JobStatus> last_job_;
+};
+
+}  // namespace deer
+
+#endif  // DEER_RELIGHTER_H_
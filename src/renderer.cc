@@ -5,19 +5,37 @@
 #include "renderer.h"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cmath>
 #include <cstdint>
+#include <functional>
 #include <future>
+#include <limits>
 #include <memory>
 #include <optional>
 #include <queue>
 #include <utility>
 #include <vector>
 
+#include "color_conversion.h"
+#include "compiled_scene.h"
+#include "denoiser.h"
+#include "fast_math.h"
+#include "frame_sequence.h"
+#include "framebuffer.h"
+#include "light_tree.h"
 #include "optics.h"
+#include "ray_tracer_job.h"
+#include "relighter.h"
 #include "rgb.h"
+#include "sampler.h"
 #include "spectrum.h"
 #include "scene.h"
+#include "scheduler.h"
+#include "spectral_sampling.h"
+#include "tile_job.h"
 #include "transform.h"
 #include "vector.h"
 
@@ -25,106 +43,1560 @@ namespace deer {
 
 namespace {
 
+// Through the top left corner of the pixel, or any point inside it
+// for a fractional row and column.
 Ray RayThroughPixel(const RayTracer &tracer,
                     const Camera &camera,
-                    std::size_t row, std::size_t col) {
-  const double  image_width  = tracer.options.image_width;
-  const double  image_height = tracer.options.image_height;
-  const double  screen_x =    col / (image_width  / 2) - 1;
-  const double  screen_y = - (row / (image_height / 2) - 1);
-  const double4 camera_space_direction = double4{screen_x, screen_y, 1, 0};
-  const double4 direction = camera.transform.Apply(camera_space_direction);
-  return Ray{camera.position(), direction};
+                    double row, double col) {
+  return camera.RayThroughPixel(row, col, tracer.options.image_width,
+                                tracer.options.image_height);
 }
 
-Spectrum TraceRay(const RayTracer &tracer,
-                  const Scene &scene,
-                  const Ray &ray) {
-  // TODO(iliazeus): a whole bunch of proper rendering
+template<MathAccuracy kAccuracy>
+double4 Normalize(const double4 &v) {
+  if constexpr (kAccuracy == MathAccuracy::kExact) {
+    return v / length(v);
+  } else {
+    return v * FastMath<kAccuracy>::Rsqrt(length2(v));
+  }
+}
+
+// cos_angle^shininess; kShininess is either the shininess itself,
+// or MaterialFeatures::kDynamicShininess.
+template<MathAccuracy kAccuracy, int kShininess>
+double SpecularPower(double cos_angle, double shininess) {
+  if constexpr (kShininess == 0) {
+    return 1;
+  } else if constexpr (kShininess == 1) {
+    return cos_angle;
+  } else if constexpr (kAccuracy == MathAccuracy::kExact) {
+    // Repeated multiplication would round differently.
+    return std::pow(cos_angle, shininess);
+  } else if constexpr (kShininess > 1) {
+    return IntPow<kShininess>(cos_angle);
+  } else if (cos_angle <= 0) {
+    // The approximations are only defined for positive bases.
+    return std::pow(cos_angle, shininess);
+  } else {
+    return FastMath<kAccuracy>::Pow(cos_angle, shininess);
+  }
+}
 
-  // Find a closest (if any) intersection.
-  auto isec = scene.TraceRay(ray);
+// Sampler dimensions of the random decisions for a pixel sample.
+constexpr std::size_t kSubpixelDimension = 0;  // and 1
+constexpr std::size_t kWavelengthDimension = 2;
+// For the s-th light picked from the light tree for pixel sample t, at
+// sample index t * light_samples + s.
+constexpr std::size_t kLightDimension = 3;
+// And 5, for the k-th shadow ray to a light from pixel sample s at
+// sample index s * max_shadow_samples + k.
+constexpr std::size_t kShadowDimension = 4;
+constexpr std::size_t kRouletteDimension = 6;  // and on, one per round
 
-  // If an intersection is farther than max_distance, drop it.
-  const double max_distance2 = std::pow(tracer.options.max_distance, 2);
-  if (isec && length2(isec->point - ray.origin) > max_distance2) {
-    isec = {};
+// Bounds the secondary rays of a path, and so the stack in TraceRay.
+constexpr std::size_t kMaxBounces = 16;
+
+// What last blocked a shadow ray to each light, for one thread: the
+// object, and for a mesh the triangle, to try before the rest of it.
+struct OccluderCache {
+  std::vector<CompiledScene::Occluder> occluders;  // by light
+  std::size_t n_shadow_rays = 0;
+  std::size_t n_occluded = 0;
+  std::size_t n_hits = 0;
+};
+
+// What the output buffers and the denoiser guides need from a path: where
+// its camera ray first hit, and how many of its rays hit anything.
+struct PathRecord {
+  bool hit = false;
+  double distance = 0;
+  double4 normal = double4::zero();  // of unit length, facing the ray
+  const Material *material = nullptr;
+  std::size_t object = CompiledScene::kNoObject;
+  std::size_t n_hits = 0;
+};
+
+// Starts the record of a path with its camera ray.
+void RecordFirstHit(const Ray &ray,
+                    const std::optional<CompiledScene::Hit> &isec,
+                    PathRecord *record) {
+  *record = PathRecord();
+  if (!isec) return;
+  record->hit = true;
+  record->distance = length(isec->point - ray.origin);
+  record->normal = isec->normal / length(isec->normal);
+  if (dot(ray.direction, record->normal) > 0) {
+    record->normal = -record->normal;
+  }
+  record->material = isec->material;
+  record->object = isec->object;
+}
+
+// A light that shades a point, with the part of it that is visible from
+// there times the weight of its pick.
+struct VisibleLight {
+  std::uint32_t light;
+  double visibility;
+};
+
+// What TraceRay needs besides the scene and the ray.
+struct TraceContext {
+  double max_distance2;
+  std::size_t max_bounces;  // at most kMaxBounces
+  double path_weight_threshold;
+  bool russian_roulette;
+  std::size_t min_shadow_samples, max_shadow_samples;
+  // Zero to shade with every light, without a tree.
+  const LightTree *light_tree;
+  std::size_t light_samples;
+  // For picking lights, soft shadows and Russian roulette.
+  const Sampler *sampler;
+  std::size_t pixel, sample;
+  // Of the thread, if it has one.
+  OccluderCache *occluder_cache;
+  // Where to record the path, if anywhere.
+  PathRecord *path_record;
+  // Of a Relighter, if it is one.
+  Relighter::HitCache *hit_cache;
+  // Spectra are only ever evaluated at the n_wavelengths wavelengths of
+  // the sample, which the SpectralSampler picks. The lighting has room
+  // for twice as many values, for Shade; both are the thread's own.
+  const double *wavelengths;
+  std::size_t n_wavelengths;
+  double *lighting;
+  // Room for one per light, or per light sample, for Shade; the thread's.
+  VisibleLight *visible_lights;
+};
+
+// radiance += spectrum * weight at every wavelength.
+void AddSpectrum(const Spectrum &spectrum, double weight,
+                 const double *wavelengths, std::size_t n_wavelengths,
+                 double *radiance) {
+  for (std::size_t i = 0; i < n_wavelengths; i++) {
+    radiance[i] += spectrum(wavelengths[i]) * weight;
+  }
+}
+
+// The closest hit of the camera ray of a sample, from the cache if it is
+// there; otherwise it goes there.
+std::optional<CompiledScene::Hit> IntersectCameraRay(
+    const CompiledScene &compiled_scene, Relighter::HitCache *cache,
+    const Ray &ray, std::size_t pixel, std::size_t sample) {
+  if (!cache || sample >= cache->samples_per_pixel) {
+    return compiled_scene.Intersect(ray);
+  }
+  const std::size_t slot = cache->Slot(pixel, sample);
+  if (!cache->known[slot]) {
+    cache->hits[slot] = compiled_scene.Intersect(ray);
+    cache->known[slot] = 1;
+    return cache->hits[slot];
+  }
+  auto isec = cache->hits[slot];
+  // The material may have been edited since.
+  if (isec) {
+    isec->material_features = compiled_scene.material_features(isec->object);
+  }
+  return isec;
+}
+
+// Whether the shadow ray to the light is blocked, trying the cached
+// occluder first.
+bool ShadowRayOccluded(const CompiledScene &compiled_scene,
+                       const TraceContext &context, std::size_t light,
+                       const Ray &ray, double max_distance2) {
+  OccluderCache *cache = context.occluder_cache;
+  if (!cache) return compiled_scene.Occluded(ray, max_distance2);
+  cache->n_shadow_rays++;
+  CompiledScene::Occluder &occluder = cache->occluders[light];
+  const CompiledScene::Occluder cached = occluder;
+  const bool occluded =
+      compiled_scene.Occluded(ray, max_distance2, &occluder);
+  cache->n_occluded += occluded;
+  // A different occluder would not be the cached one, which is skipped
+  // after the miss.
+  if (occluded && cached.object != CompiledScene::kNoObject &&
+      occluder.object == cached.object) {
+    cache->n_hits++;
+  }
+  return occluded;
+}
+
+// Calls shade(light, weight, slot) for each light that shades a point:
+// every light, or light_samples picks from the light tree, weighted by the
+// inverse of the expected number of picks. The slot tells apart the
+// lights, or picks, of a point.
+template<class F>
+void ForEachShadingLight(const TraceContext &context, std::size_t n_lights,
+                         const double4 &point, F shade) {
+  if (context.light_samples == 0) {
+    for (std::size_t light = 0; light < n_lights; light++) {
+      shade(light, 1.0, light);
+    }
+    return;
+  }
+  for (std::size_t slot = 0; slot < context.light_samples; slot++) {
+    const double u = context.sampler->Get(context.pixel,
+        context.sample * context.light_samples + slot, kLightDimension);
+    if (auto choice = context.light_tree->Sample(point, u)) {
+      shade(choice->light,
+            1 / (choice->probability * context.light_samples), slot);
+    }
+  }
+}
+
+// Where the k-th shadow ray from the point goes on the light source in
+// the given slot.
+double4 ShadowRayTarget(const TraceContext &context,
+                        const PointLightSource &source, std::size_t slot,
+                        const double4 &origin, std::size_t k) {
+  if (source.softness <= 0) return source.position;
+  double2 u = context.sampler->Get2D(context.pixel,
+      context.sample * context.max_shadow_samples + k, kShadowDimension);
+  // Shifts the points of each slot by another step of the R2 sequence,
+  // so that the lights do not share their shadow patterns.
+  u[0] += 0.7548776662466927 * slot;
+  u[1] += 0.5698402909980532 * slot;
+  u[0] -= std::floor(u[0]);
+  u[1] -= std::floor(u[1]);
+  return source.SamplePoint(origin, u);
+}
+
+// The fraction of the light source that is visible from the point. A hard
+// light takes one shadow ray. A soft one takes min_shadow_samples, and
+// only if they disagree, which is in a penumbra, up to max_shadow_samples.
+double Visibility(const CompiledScene &compiled_scene,
+                  const TraceContext &context,
+                  const PointLightSource &source, std::size_t light,
+                  std::size_t slot, const double4 &origin) {
+  auto visible = [&](std::size_t k) {
+    const double4 direction =
+        ShadowRayTarget(context, source, slot, origin, k) - origin;
+    return !ShadowRayOccluded(compiled_scene, context, light,
+                              Ray{origin, direction}, length2(direction));
+  };
+  if (source.softness <= 0) return visible(0);
+
+  std::size_t n_visible = 0;
+  std::size_t n = 0;
+  for (; n < context.min_shadow_samples; n++) n_visible += visible(n);
+  if (n_visible == 0 || n_visible == n) return n_visible > 0;
+  for (; n < context.max_shadow_samples; n++) n_visible += visible(n);
+  return double(n_visible) / n;
+}
+
+// Phong shading of a point with the light that reaches it, specialized
+// for the terms the material has, added to the radiance with the given
+// weight. Skipping a term gives the same result, as the skipped term
+// would be zero. The origin is that of the shadow rays, just off the
+// surface. This is the shading of both execution modes.
+template<MathAccuracy kAccuracy, bool kDiffuse, bool kSpecular,
+         int kShininess>
+void ShadeLit(const Scene &scene, const Material &material,
+              const double4 &normal, const double4 &origin,
+              const VisibleLight *lights, std::size_t n_lights,
+              const TraceContext &context, double weight,
+              double *radiance) {
+  const double *wavelengths = context.wavelengths;
+  const std::size_t n_wavelengths = context.n_wavelengths;
+
+  if constexpr (!kDiffuse && !kSpecular) {
+    for (std::size_t i = 0; i < n_wavelengths; i++) {
+      radiance[i] += material.ambiance_spectrum(wavelengths[i]) *
+                     scene.ambiance_spectrum(wavelengths[i]) * weight;
+    }
+    return;
+  }
+
+  double *diffuse_lighting = context.lighting;
+  double *specular_lighting = context.lighting + n_wavelengths;
+  std::fill(diffuse_lighting, diffuse_lighting + 2 * n_wavelengths, 0.0);
+
+  const double4 nn = Normalize<kAccuracy>(normal);
+  const auto &light_sources = scene.point_light_sources();
+  for (std::size_t j = 0; j < n_lights; j++) {
+    const double visibility = lights[j].visibility;
+    if (visibility <= 0) continue;
+    const PointLightSource &source = *light_sources[lights[j].light];
+
+    // Phong reflection model, towards the middle of the light
+    const double4 nl = Normalize<kAccuracy>(source.position - origin);
+    if constexpr (kDiffuse) {
+      const double diffuse = dot(nn, nl) * visibility;
+      for (std::size_t i = 0; i < n_wavelengths; i++) {
+        diffuse_lighting[i] += source.spectrum(wavelengths[i]) * diffuse;
+      }
+    }
+    if constexpr (kSpecular) {
+      const double4 nr = -nl.reflect_off(nn);
+      const double specular = SpecularPower<kAccuracy, kShininess>(
+          dot(nn, nr), material.shininess) * visibility;
+      for (std::size_t i = 0; i < n_wavelengths; i++) {
+        specular_lighting[i] += source.spectrum(wavelengths[i]) * specular;
+      }
+    }
+  }
+
+  for (std::size_t i = 0; i < n_wavelengths; i++) {
+    double result = material.ambiance_spectrum(wavelengths[i]) *
+                    scene.ambiance_spectrum(wavelengths[i]);
+    if constexpr (kDiffuse) {
+      result += material.diffusion_spectrum(wavelengths[i]) *
+                diffuse_lighting[i];
+    }
+    if constexpr (kSpecular) {
+      result += material.specular_spectrum(wavelengths[i]) *
+                specular_lighting[i];
+    }
+    radiance[i] += result * weight;
   }
+}
 
-  // If no intersection found, then we hit the sky.
-  if (!isec) return scene.sky_spectrum;
+using ShadeFunction = void (*)(const Scene &, const Material &,
+                               const double4 &normal, const double4 &origin,
+                               const VisibleLight *lights,
+                               std::size_t n_lights, const TraceContext &,
+                               double weight, double *radiance);
 
+constexpr std::size_t kShadeTableSize =
+    4 * (MaterialFeatures::kMaxStaticShininess + 2);
+
+constexpr std::size_t ShadeTableIndex(const MaterialFeatures &features) {
+  const int shininess = features.specular ? features.shininess
+                                          : MaterialFeatures::kDynamicShininess;
+  return features.diffuse | features.specular << 1 | (shininess + 1) << 2;
+}
+
+template<MathAccuracy kAccuracy, std::size_t... kIndices>
+constexpr std::array<ShadeFunction, kShadeTableSize> MakeShadeTable(
+    std::index_sequence<kIndices...>) {
+  return {ShadeLit<kAccuracy, bool(kIndices & 1), bool(kIndices & 2),
+                   int(kIndices >> 2) - 1>...};
+}
+
+template<MathAccuracy kAccuracy>
+constexpr auto kShadeTable = MakeShadeTable<kAccuracy>(
+    std::make_index_sequence<kShadeTableSize>());
+
+// Shades a hit of a path traced on its own: casts the shadow rays to the
+// lights that shade it as it goes, then shades it with ShadeLit.
+template<MathAccuracy kAccuracy>
+void Shade(const CompiledScene &compiled_scene,
+           const TraceContext &context,
+           const CompiledScene::Hit &isec, double weight,
+           double *radiance) {
   const double kLightingEps = 1e-6;
-  auto ambient_lighting_spectrum = scene.ambiance_spectrum;
-  auto diffuse_lighting_spectrum = Spectrum::MakeConstant(0);
-  auto specular_lighting_spectrum = Spectrum::MakeConstant(0);
-
-  // Check if each of the point light sources is reachable, modifying
-  // the total lighting_spectrum.
-  for (const auto &source : scene.point_light_sources()) {
-    const double4 ray_origin = isec->point + kLightingEps * isec->normal;
-    const double4 ray_direction = source->position - ray_origin;
-    const Ray ray{ray_origin, ray_direction};
-
-    // Cast shadows
-    const auto light_isec = scene.TraceRay(ray);
-    if (light_isec) {
-      if (length2(light_isec->point - ray_origin) < length2(ray_direction)) {
+  const Scene &scene = compiled_scene.scene();
+  const MaterialFeatures &features = isec.material_features;
+
+  // Check how much of each of the point light sources is reachable.
+  const auto &light_sources = scene.point_light_sources();
+  const double4 ray_origin = isec.point + kLightingEps * isec.normal;
+  std::size_t n_lights = 0;
+  if (features.diffuse || features.specular) {
+    ForEachShadingLight(context, light_sources.size(), ray_origin,
+        [&](std::size_t light, double weight, std::size_t slot) {
+      // Cast shadows
+      const double visibility = Visibility(compiled_scene, context,
+          *light_sources[light], light, slot, ray_origin) * weight;
+      if (visibility <= 0) return;
+      context.visible_lights[n_lights++] =
+          VisibleLight{std::uint32_t(light), visibility};
+    });
+  }
+
+  kShadeTable<kAccuracy>[ShadeTableIndex(features)](scene, *isec.material,
+      isec.normal, ray_origin, context.visible_lights, n_lights, context,
+      weight, radiance);
+}
+
+// Leaves the radiance along the ray at the context's wavelengths in
+// radiance[0, n_wavelengths). Needs no memory of its own.
+template<MathAccuracy kAccuracy>
+void TraceRay(const CompiledScene &compiled_scene,
+              const TraceContext &context,
+              const Ray &ray, double *radiance) {
+  const double kSecondaryEps = 1e-6;
+
+  // Rays still to trace, depth first. A bounce pops one and pushes at
+  // most two, so there is never more than one waiting ray per level below
+  // the current one.
+  struct PathRay {
+    double4 origin, direction;
+    double weight;  // of its contribution to the pixel
+    std::size_t depth;
+  };
+  std::array<PathRay, kMaxBounces + 2> stack;
+  std::size_t stack_size = 0;
+  std::size_t n_roulette_rounds = 0;
+
+  // Paths lighter than the threshold are dropped, or play Russian
+  // roulette: they survive with a probability proportional to their
+  // weight, and get the threshold weight if they do, which keeps the
+  // image unbiased.
+  auto push = [&](PathRay path) {
+    if (path.weight < context.path_weight_threshold) {
+      if (!context.russian_roulette) return;
+      const double survival = path.weight / context.path_weight_threshold;
+      const double u = context.sampler->Get(context.pixel, context.sample,
+          kRouletteDimension + n_roulette_rounds++);
+      if (u >= survival) return;
+      path.weight = context.path_weight_threshold;
+    }
+    stack[stack_size++] = path;
+  };
+
+  std::fill(radiance, radiance + context.n_wavelengths, 0.0);
+  stack[stack_size++] = PathRay{ray.origin, ray.direction, 1, 0};
+  while (stack_size > 0) {
+    const PathRay path = stack[--stack_size];
+
+    // Find a closest (if any) intersection.
+    const Ray path_ray{path.origin, path.direction};
+    auto isec = path.depth == 0
+        ? IntersectCameraRay(compiled_scene, context.hit_cache, path_ray,
+                             context.pixel, context.sample)
+        : compiled_scene.Intersect(path_ray);
+
+    // If an intersection is farther than max_distance, drop it.
+    if (isec && isec->distance2 > context.max_distance2) {
+      isec = {};
+    }
+    if (context.path_record) {
+      if (path.depth == 0) {
+        RecordFirstHit(path_ray, isec,
+                       context.path_record);
+      }
+      if (isec) context.path_record->n_hits++;
+    }
+
+    // If no intersection found, then we hit the sky.
+    if (!isec) {
+      AddSpectrum(compiled_scene.scene().sky_spectrum, path.weight,
+                  context.wavelengths, context.n_wavelengths, radiance);
+      continue;
+    }
+
+    const Material &material = *isec->material;
+    const double local = 1 - material.reflectivity - material.transparency;
+    if (local > 0) {
+      Shade<kAccuracy>(compiled_scene, context, *isec, path.weight * local,
+                       radiance);
+    }
+    if (path.depth >= context.max_bounces) continue;
+    if (material.reflectivity <= 0 && material.transparency <= 0) continue;
+
+    const double4 direction = Normalize<kAccuracy>(path.direction);
+    double4 normal = Normalize<kAccuracy>(isec->normal);
+    const bool entering = dot(direction, normal) < 0;
+    if (!entering) normal = -normal;
+
+    double reflected_weight = path.weight * material.reflectivity;
+    if (material.transparency > 0) {
+      const double eta = entering ? 1 / material.refractive_index
+                                  : material.refractive_index;
+      const double4 refracted = direction.refract_through(normal, eta);
+      if (refracted == double4::zero()) {
+        reflected_weight += path.weight * material.transparency;
+      } else {
+        push(PathRay{isec->point - kSecondaryEps * normal, refracted,
+                     path.weight * material.transparency, path.depth + 1});
+      }
+    }
+    if (reflected_weight > 0) {
+      push(PathRay{isec->point + kSecondaryEps * normal,
+                   direction.reflect_off(normal), reflected_weight,
+                   path.depth + 1});
+    }
+  }
+}
+
+using TraceRayFunction = void (*)(const CompiledScene &,
+                                  const TraceContext &, const Ray &,
+                                  double *radiance);
+
+TraceRayFunction SelectTraceRay(MathAccuracy accuracy) {
+  switch (accuracy) {
+    case MathAccuracy::kExact: return TraceRay<MathAccuracy::kExact>;
+    case MathAccuracy::kFast: return TraceRay<MathAccuracy::kFast>;
+    case MathAccuracy::kFastest: return TraceRay<MathAccuracy::kFastest>;
+  }
+  return TraceRay<MathAccuracy::kExact>;
+}
+
+// Queues and path state of the wavefront mode, kept between tiles so
+// that their storage is reused.
+struct Wavefront {
+  // Rays to find the closest hits for, each of some path.
+  struct RayQueue {
+    RayBatch rays;
+    std::vector<double> weight;  // of its contribution to the path
+    std::vector<std::uint32_t> path, depth;
+
+    std::size_t size() const { return path.size(); }
+    void Clear() {
+      rays.Clear();
+      weight.clear();
+      path.clear();
+      depth.clear();
+    }
+  };
+
+  // Rays from the hits towards the point light sources.
+  struct ShadowQueue {
+    RayBatch rays;
+    std::vector<double> max_distance2;
+    std::vector<std::uint32_t> group;  // index into shadow_groups
+    // As CompiledScene finds them.
+    std::vector<CompiledScene::Occluder> occluders;
+
+    std::size_t size() const { return group.size(); }
+    void Clear() {
+      rays.Clear();
+      max_distance2.clear();
+      group.clear();
+    }
+  };
+
+  // The shadow rays from a hit to one of the lights that shade it, as
+  // ForEachShadingLight gives them.
+  struct ShadowGroup {
+    std::uint32_t hit;  // index into shaded_hits
+    std::uint32_t light, slot;
+    double weight;
+    std::uint32_t n_rays, n_visible;
+  };
+
+  // A hit that gets Phong shading, with its shadow groups if it needs any.
+  struct ShadedHit {
+    std::uint32_t ray;
+    double4 origin;  // of its shadow rays
+    std::uint32_t first_shadow_group, end_shadow_group;
+    double weight;
+  };
+
+  RayQueue rays, next_rays;
+  std::vector<std::optional<CompiledScene::Hit>> hits;  // by ray
+  std::vector<ShadedHit> shaded_hits;
+  std::vector<ShadowGroup> shadow_groups;
+  std::vector<VisibleLight> visible_lights;  // by shadow group
+  ShadowQueue shadow_rays;
+
+  // By path, that is by pixel sample, n_wavelengths values each: the
+  // wavelengths the path is traced at, and the radiance along it there.
+  std::size_t n_wavelengths = 0;
+  std::vector<double> wavelengths, radiance;
+  std::vector<std::size_t> pixels, samples;
+  std::vector<std::size_t> n_roulette_rounds;
+  // Only kept with record_paths.
+  std::vector<PathRecord> path_records;
+  bool record_paths = false;
+
+  std::size_t n_paths() const { return pixels.size(); }
+
+  void Clear() {
+    rays.Clear();
+    wavelengths.clear();
+    radiance.clear();
+    pixels.clear();
+    samples.clear();
+    n_roulette_rounds.clear();
+    path_records.clear();
+  }
+
+  // The generate stage: starts a path with a camera ray. Returns where
+  // its wavelengths go.
+  double *AddCameraRay(const Ray &ray, std::size_t pixel,
+                       std::size_t sample) {
+    rays.rays.PushBack(ray.origin, ray.direction);
+    rays.weight.push_back(1);
+    rays.path.push_back(n_paths());
+    rays.depth.push_back(0);
+    wavelengths.resize(wavelengths.size() + n_wavelengths);
+    radiance.resize(radiance.size() + n_wavelengths, 0.0);
+    pixels.push_back(pixel);
+    samples.push_back(sample);
+    n_roulette_rounds.push_back(0);
+    if (record_paths) path_records.emplace_back();
+    return &wavelengths[wavelengths.size() - n_wavelengths];
+  }
+};
+
+// Traces all the paths of the wavefront to the end, leaving their
+// radiance in wavefront->radiance. Each stage takes all the rays of its
+// queue through the scene at once, and the hits are shaded by the same
+// kernels as in TraceRay, so the terms add up the same.
+template<MathAccuracy kAccuracy>
+void TraceWavefront(const CompiledScene &compiled_scene,
+                    const TraceContext &context,
+                    Wavefront *wavefront) {
+  const double kLightingEps = 1e-6;
+  const double kSecondaryEps = 1e-6;
+  const Scene &scene = compiled_scene.scene();
+  const auto &light_sources = scene.point_light_sources();
+
+  auto &rays = wavefront->rays;
+  auto &next_rays = wavefront->next_rays;
+  auto &hits = wavefront->hits;
+  auto &shaded_hits = wavefront->shaded_hits;
+  auto &shadow_groups = wavefront->shadow_groups;
+  auto &visible_lights = wavefront->visible_lights;
+  auto &shadow_rays = wavefront->shadow_rays;
+
+  const std::size_t n_wavelengths = wavefront->n_wavelengths;
+  auto path_context = [&](std::uint32_t path) {
+    TraceContext result = context;
+    result.pixel = wavefront->pixels[path];
+    result.sample = wavefront->samples[path];
+    result.wavelengths = &wavefront->wavelengths[path * n_wavelengths];
+    return result;
+  };
+
+  // Queues the shadow rays from first to end of a group.
+  auto push_shadow_rays = [&](const TraceContext &ray_context,
+                              std::uint32_t group, std::size_t first,
+                              std::size_t end) {
+    const Wavefront::ShadowGroup &shadow_group = shadow_groups[group];
+    const PointLightSource &source = *light_sources[shadow_group.light];
+    const double4 origin = shaded_hits[shadow_group.hit].origin;
+    for (std::size_t k = first; k < end; k++) {
+      const double4 direction = ShadowRayTarget(ray_context, source,
+          shadow_group.slot, origin, k) - origin;
+      shadow_rays.rays.PushBack(origin, direction);
+      shadow_rays.max_distance2.push_back(length2(direction));
+      shadow_rays.group.push_back(group);
+    }
+    shadow_groups[group].n_rays += end - first;
+  };
+
+  // Shadow: any hit on the way to each light source. With an occluder
+  // cache, every ray first tries what blocked the last ray to its light
+  // in the batch before.
+  auto trace_shadow_rays = [&] {
+    const std::size_t n_shadow_rays = shadow_rays.size();
+    auto &occluders = shadow_rays.occluders;
+    occluders.assign(n_shadow_rays, CompiledScene::Occluder{});
+    OccluderCache *cache = context.occluder_cache;
+    if (cache) {
+      for (std::size_t i = 0; i < n_shadow_rays; i++) {
+        CompiledScene::Occluder cached =
+            cache->occluders[shadow_groups[shadow_rays.group[i]].light];
+        if (cached.object != CompiledScene::kNoObject &&
+            compiled_scene.OccludedBy(&cached,
+                Ray{shadow_rays.rays.origin(i),
+                    shadow_rays.rays.direction(i)},
+                shadow_rays.max_distance2[i])) {
+          occluders[i] = cached;
+          cache->n_hits++;
+        }
+      }
+    }
+    compiled_scene.FindOccluders(shadow_rays.rays,
+                                 shadow_rays.max_distance2.data(),
+                                 occluders.data());
+    for (std::size_t i = 0; i < n_shadow_rays; i++) {
+      Wavefront::ShadowGroup &group = shadow_groups[shadow_rays.group[i]];
+      const bool occluded =
+          occluders[i].object != CompiledScene::kNoObject;
+      group.n_visible += !occluded;
+      if (cache) {
+        cache->n_shadow_rays++;
+        cache->n_occluded += occluded;
+        if (occluded) cache->occluders[group.light] = occluders[i];
+      }
+    }
+    shadow_rays.Clear();
+  };
+
+  auto add = [&](std::size_t path, const Spectrum &spectrum, double weight) {
+    AddSpectrum(spectrum, weight,
+                &wavefront->wavelengths[path * n_wavelengths],
+                n_wavelengths, &wavefront->radiance[path * n_wavelengths]);
+  };
+
+  // As in TraceRay.
+  auto push = [&](std::uint32_t path, const double4 &origin,
+                  const double4 &direction, double weight,
+                  std::uint32_t depth) {
+    if (weight < context.path_weight_threshold) {
+      if (!context.russian_roulette) return;
+      const double survival = weight / context.path_weight_threshold;
+      const double u = context.sampler->Get(wavefront->pixels[path],
+          wavefront->samples[path],
+          kRouletteDimension + wavefront->n_roulette_rounds[path]++);
+      if (u >= survival) return;
+      weight = context.path_weight_threshold;
+    }
+    next_rays.rays.PushBack(origin, direction);
+    next_rays.weight.push_back(weight);
+    next_rays.path.push_back(path);
+    next_rays.depth.push_back(depth);
+  };
+
+  while (rays.size() > 0) {
+    const std::size_t n_rays = rays.size();
+
+    // Extend: the closest hits of all the rays. Only the first queue has
+    // camera rays, which a Relighter looks up in its cache one by one.
+    hits.resize(n_rays);
+    if (context.hit_cache && rays.depth[0] == 0) {
+      for (std::size_t i = 0; i < n_rays; i++) {
+        hits[i] = IntersectCameraRay(compiled_scene, context.hit_cache,
+            Ray{rays.rays.origin(i), rays.rays.direction(i)},
+            wavefront->pixels[rays.path[i]],
+            wavefront->samples[rays.path[i]]);
+      }
+    } else {
+      compiled_scene.Intersect(rays.rays, hits.data());
+    }
+    for (std::size_t i = 0; i < n_rays; i++) {
+      auto &isec = hits[i];
+      if (isec && isec->distance2 > context.max_distance2) isec = {};
+      if (wavefront->record_paths) {
+        PathRecord &record = wavefront->path_records[rays.path[i]];
+        if (rays.depth[i] == 0) {
+          RecordFirstHit(Ray{rays.rays.origin(i), rays.rays.direction(i)},
+                         isec, &record);
+        }
+        if (isec) record.n_hits++;
+      }
+    }
+
+    // Shade: the sky for the misses; shadow rays, mirrored and refracted
+    // rays for the hits.
+    shaded_hits.clear();
+    shadow_groups.clear();
+    shadow_rays.Clear();
+    next_rays.Clear();
+    for (std::size_t i = 0; i < n_rays; i++) {
+      const std::uint32_t path = rays.path[i];
+      const auto &isec = hits[i];
+      if (!isec) {
+        add(path, scene.sky_spectrum, rays.weight[i]);
         continue;
       }
+
+      const Material &material = *isec->material;
+      const double local = 1 - material.reflectivity - material.transparency;
+      if (local > 0) {
+        const std::uint32_t hit = shaded_hits.size();
+        const std::uint32_t first_group = shadow_groups.size();
+        shaded_hits.push_back(Wavefront::ShadedHit{std::uint32_t(i),
+            isec->point + kLightingEps * isec->normal, first_group,
+            first_group, rays.weight[i] * local});
+        const MaterialFeatures &features = isec->material_features;
+        if (features.diffuse || features.specular) {
+          const TraceContext ray_context = path_context(path);
+          ForEachShadingLight(ray_context, light_sources.size(),
+              shaded_hits[hit].origin,
+              [&](std::size_t light, double weight, std::size_t slot) {
+            const std::uint32_t group = shadow_groups.size();
+            shadow_groups.push_back(Wavefront::ShadowGroup{hit,
+                std::uint32_t(light), std::uint32_t(slot), weight, 0, 0});
+            push_shadow_rays(ray_context, group, 0,
+                light_sources[light]->softness > 0
+                    ? context.min_shadow_samples : 1);
+          });
+        }
+        shaded_hits[hit].end_shadow_group = shadow_groups.size();
+      }
+      if (rays.depth[i] >= context.max_bounces) continue;
+      if (material.reflectivity <= 0 && material.transparency <= 0) continue;
+
+      const double weight = rays.weight[i];
+      const double4 direction =
+          Normalize<kAccuracy>(rays.rays.direction(i));
+      double4 normal = Normalize<kAccuracy>(isec->normal);
+      const bool entering = dot(direction, normal) < 0;
+      if (!entering) normal = -normal;
+
+      double reflected_weight = weight * material.reflectivity;
+      if (material.transparency > 0) {
+        const double eta = entering ? 1 / material.refractive_index
+                                    : material.refractive_index;
+        const double4 refracted = direction.refract_through(normal, eta);
+        if (refracted == double4::zero()) {
+          reflected_weight += weight * material.transparency;
+        } else {
+          push(path, isec->point - kSecondaryEps * normal, refracted,
+               weight * material.transparency, rays.depth[i] + 1);
+        }
+      }
+      if (reflected_weight > 0) {
+        push(path, isec->point + kSecondaryEps * normal,
+             direction.reflect_off(normal), reflected_weight,
+             rays.depth[i] + 1);
+      }
+    }
+
+    // Then more shadow rays where a soft light is partly visible.
+    trace_shadow_rays();
+    for (std::uint32_t group = 0; group < shadow_groups.size(); group++) {
+      const auto &shadow_group = shadow_groups[group];
+      if (light_sources[shadow_group.light]->softness > 0 &&
+          shadow_group.n_visible > 0 &&
+          shadow_group.n_visible < shadow_group.n_rays) {
+        push_shadow_rays(
+            path_context(rays.path[shaded_hits[shadow_group.hit].ray]),
+            group, shadow_group.n_rays, context.max_shadow_samples);
+      }
+    }
+    trace_shadow_rays();
+
+    // The visible part of each light, as Visibility has it.
+    visible_lights.resize(shadow_groups.size());
+    for (std::size_t group = 0; group < shadow_groups.size(); group++) {
+      const auto &shadow_group = shadow_groups[group];
+      visible_lights[group] = VisibleLight{shadow_group.light,
+          (shadow_group.n_visible == shadow_group.n_rays
+               ? 1 : double(shadow_group.n_visible) / shadow_group.n_rays) *
+          shadow_group.weight};
+    }
+
+    TraceContext shade_context = context;
+    for (const auto &shaded : shaded_hits) {
+      const std::uint32_t path = rays.path[shaded.ray];
+      const CompiledScene::Hit &isec = *hits[shaded.ray];
+      shade_context.wavelengths =
+          &wavefront->wavelengths[path * n_wavelengths];
+      kShadeTable<kAccuracy>[ShadeTableIndex(isec.material_features)](
+          scene, *isec.material, isec.normal, shaded.origin,
+          visible_lights.data() + shaded.first_shadow_group,
+          shaded.end_shadow_group - shaded.first_shadow_group,
+          shade_context, shaded.weight,
+          &wavefront->radiance[path * n_wavelengths]);
     }
 
-    // Phong reflection model
-    const double4 nn = isec->normal / length(isec->normal);
-    const double4 nl = ray_direction / length(ray_direction);
-    const double4 nr = -nl.reflect_off(nn);
-    diffuse_lighting_spectrum += source->spectrum * dot(nn, nl);
-    specular_lighting_spectrum += source->spectrum *
-        std::pow(dot(nn, nr), isec->material->shininess);
+    std::swap(rays, next_rays);
   }
+}
 
-  const auto result_spectrum =
-      isec->material->ambiance_spectrum * ambient_lighting_spectrum +
-      isec->material->diffusion_spectrum * diffuse_lighting_spectrum +
-      isec->material->specular_spectrum * specular_lighting_spectrum;
+using TraceWavefrontFunction = void (*)(const CompiledScene &,
+                                        const TraceContext &, Wavefront *);
 
-  return result_spectrum;
+TraceWavefrontFunction SelectTraceWavefront(MathAccuracy accuracy) {
+  switch (accuracy) {
+    case MathAccuracy::kExact: return TraceWavefront<MathAccuracy::kExact>;
+    case MathAccuracy::kFast: return TraceWavefront<MathAccuracy::kFast>;
+    case MathAccuracy::kFastest:
+      return TraceWavefront<MathAccuracy::kFastest>;
+  }
+  return TraceWavefront<MathAccuracy::kExact>;
 }
 
+struct PixelSamples {
+  double3 sum{0, 0, 0}, sum2{0, 0, 0};
+  std::size_t n = 0;
+  bool contrasting = false;
+  // Of the paths, for the output buffers and the denoiser.
+  std::size_t n_paths = 0;
+  double depth = 0;
+  double4 normal = double4::zero();
+  double3 albedo{0, 0, 0};
+  std::size_t n_hits = 0;  // of camera rays
+  std::size_t n_path_hits = 0;  // of all rays
+  std::size_t object = CompiledScene::kNoObject;  // of the first path
+  // Of the subpixel offsets, for a frame sequence.
+  double2 offset{0, 0};
+
+  void Store(float *pixel) const {
+    for (std::size_t i = 0; i < 3; i++) pixel[i] = sum[i] / n;
+  }
+
+  void AddPath(const PathRecord &record, const double3 &wavelengths) {
+    if (n_paths++ == 0) object = record.object;
+    n_path_hits += record.n_hits;
+    if (!record.hit) return;
+    const Material &material = *record.material;
+    // Mirrors and glass count as white.
+    const double local = 1 - material.reflectivity - material.transparency;
+    depth += record.distance;
+    normal += record.normal;
+    albedo += material.diffusion_spectrum(wavelengths) * local +
+              double3{1, 1, 1} * (1 - local);
+    n_hits++;
+  }
+
+  void StoreOutputs(std::size_t pixel,
+                    Renderer::OutputBuffers *outputs) const {
+    if (!outputs->depth.empty() && n_hits > 0) {
+      outputs->depth[pixel] = depth / n_hits;
+    }
+    if (!outputs->normal.empty() && n_hits > 0) {
+      const double4 mean = normal / length(normal);
+      for (std::size_t i = 0; i < 3; i++) {
+        outputs->normal[pixel * 3 + i] = mean[i];
+      }
+    }
+    if (!outputs->albedo.empty()) {
+      for (std::size_t i = 0; i < 3; i++) {
+        outputs->albedo[pixel * 3 + i] = albedo[i] / n_paths;
+      }
+    }
+    if (!outputs->object_id.empty()) {
+      outputs->object_id[pixel] = object == CompiledScene::kNoObject
+          ? Renderer::OutputBuffers::kNoObject : object;
+    }
+    if (!outputs->hit_count.empty()) {
+      outputs->hit_count[pixel] = n_path_hits;
+    }
+  }
+
+  void StoreGuides(std::size_t pixel, DenoiserGuides *guides) const {
+    guides->depth[pixel] = n_hits > 0
+        ? depth / n_hits : DenoiserGuides::kSkyDepth;
+    for (std::size_t i = 0; i < 3; i++) {
+      guides->normal[pixel * 3 + i] = normal[i] / n;
+      guides->albedo[pixel * 3 + i] = albedo[i] / n;
+    }
+    if (!guides->variance.empty()) {
+      double variance = 0;
+      for (std::size_t i = 0; i < 3; i++) {
+        variance += std::max(0.0,
+            (sum2[i] - sum[i] * sum[i] / n) / (n - 1)) / n;
+      }
+      guides->variance[pixel] = variance / 3;
+    }
+  }
+};
+
+// Whether the mean of the samples is known closely enough: the standard
+// error of every channel, relative to the colour profile range, is
+// within aa_threshold.
+bool SamplesConverged(const PixelSamples &samples,
+                      const RayTracer::Options &options) {
+  const std::size_t n = samples.n;
+  if (n < 2) return false;
+  const double3 range = options.color_profile.max_intensities -
+                        options.color_profile.min_intensities;
+  for (std::size_t i = 0; i < 3; i++) {
+    const double variance = std::max(0.0,
+        (samples.sum2[i] - samples.sum[i] * samples.sum[i] / n) / (n - 1));
+    const double error = options.aa_threshold * range[i];
+    if (variance / n > error * error) return false;
+  }
+  return true;
+}
+
+// Whether a pixel of a tile buffer differs from one of its neighbours at
+// the given stride by more than aa_contrast of the colour profile range.
+// Samples inside a pixel can all miss an edge that its neighbours show.
+bool HasContrastingNeighbor(const float *buffer, const Tile &tile,
+                            std::size_t y, std::size_t x, std::size_t stride,
+                            const RayTracer::Options &options) {
+  const double3 range = options.color_profile.max_intensities -
+                        options.color_profile.min_intensities;
+  const float *pixel = buffer + (y * tile.width + x) * 3;
+  auto contrasts = [&](std::size_t ny, std::size_t nx) {
+    const float *neighbor = buffer + (ny * tile.width + nx) * 3;
+    for (std::size_t i = 0; i < 3; i++) {
+      if (std::abs(pixel[i] - neighbor[i]) > options.aa_contrast * range[i]) {
+        return true;
+      }
+    }
+    return false;
+  };
+  return (y >= stride && contrasts(y - stride, x)) ||
+         (x >= stride && contrasts(y, x - stride)) ||
+         (y + stride < tile.height && contrasts(y + stride, x)) ||
+         (x + stride < tile.width && contrasts(y, x + stride));
+}
+
+// The part of the image that is rendered: the crop, cut down to the
+// image, if there is one.
+Tile CropWindow(const RayTracer::Options &options) {
+  if (!options.crop) {
+    return Tile{0, 0, options.image_height, options.image_width};
+  }
+  const Tile &crop = *options.crop;
+  const std::size_t row = std::min(crop.row, options.image_height);
+  const std::size_t col = std::min(crop.col, options.image_width);
+  return Tile{row, col,
+              std::min(crop.height, options.image_height - row),
+              std::min(crop.width, options.image_width - col)};
+}
+
+// The crops of the views, each pasted into a black full-size image.
+Framebuffer PasteCrop(const Framebuffer &cropped,
+                      const RayTracer::Options &options,
+                      std::size_t n_views) {
+  const Tile window = CropWindow(options);
+  Framebuffer full(options.image_width, options.image_height * n_views);
+  std::vector<float> buffer(window.width * window.height * 3);
+  for (std::size_t view = 0; view < n_views; view++) {
+    cropped.ReadTile(Tile{view * window.height, 0, window.height,
+                          window.width}, buffer.data());
+    full.WriteTile(Tile{view * options.image_height + window.row,
+                        window.col, window.height, window.width},
+                   buffer.data());
+  }
+  return full;
+}
+
+// Strides of progressive passes: powers of two, down to one pixel.
+std::vector<std::size_t> PassStrides(const RayTracer::Options &options) {
+  std::vector<std::size_t> strides;
+  if (options.progressive) {
+    const std::size_t max_stride =
+        std::min(options.progressive_stride,
+                 ClampTileSize(options.tile_size));
+    std::size_t stride = 1;
+    while (stride * 2 <= max_stride) stride *= 2;
+    for (; stride > 1; stride /= 2) strides.push_back(stride);
+  }
+  strides.push_back(1);
+  return strides;
+}
+
+// The views are stacked from top to bottom; rows, pixel indices, tiles
+// and buffers are all of the stack of their crop windows.
 std::vector<std::uint8_t> RenderPixels(const RayTracer &tracer,
                           const Scene &scene,
-                          const Camera &camera,
-                          std::shared_ptr<Renderer::JobStatus> job_status) {
-  const std::size_t result_size =
-      tracer.options.image_width * tracer.options.image_height * 3;
-  std::vector<std::uint8_t> result(result_size);
-  const double amount_done_per_pixel = 1.0 / (result_size / 3.0);
-#pragma omp parallel for
-  for (std::size_t row = 0; row < tracer.options.image_height; row++) {
-    for (std::size_t col = 0; col < tracer.options.image_width; col++) {
-      Ray ray = RayThroughPixel(tracer, camera, row, col);
-      auto spectrum = TraceRay(tracer, scene, ray);
-      auto rgb_bytes = tracer.options.color_profile.ToRgbBytes(spectrum);
-      result[row*tracer.options.image_width*3 + col*3 + 0] = rgb_bytes[0];
-      result[row*tracer.options.image_width*3 + col*3 + 1] = rgb_bytes[1];
-      result[row*tracer.options.image_width*3 + col*3 + 2] = rgb_bytes[2];
+                          const std::vector<Camera> &cameras,
+                          std::shared_ptr<SharedFramebuffer> framebuffer,
+                          std::shared_ptr<Renderer::JobStatus> job_status,
+                          std::shared_ptr<const Reprojection> reprojection,
+                          std::shared_ptr<Relighter::HitCache> hit_cache) {
+  const Tile window = CropWindow(tracer.options);
+  const std::size_t width = window.width;
+  const std::size_t view_height = window.height;
+  const std::size_t n_views = cameras.size();
+  const std::size_t height = view_height * n_views;
+  const double amount_done_per_pixel = 1.0 / (width * height);
+
+  TileJob job(job_status, tracer.options.n_threads,
+              tracer.options.work_stealing, tracer.options.time_limit);
+  const CompiledScene compiled_scene(scene, tracer.options.geometry_dispatch);
+  const auto &color_profile = tracer.options.color_profile;
+  const SpectralSampler spectral_sampler(color_profile,
+      tracer.options.spectral_sampling, tracer.options.spectral_samples,
+      tracer.options.wavelengths_per_sample, tracer.options.spectral_bins);
+  const Sampler sampler(tracer.options.sample_sequence,
+                        tracer.options.image_width,
+                        tracer.options.sample_seed);
+
+  const double max_distance2 = std::pow(tracer.options.max_distance, 2);
+  const TraceRayFunction trace_ray =
+      SelectTraceRay(tracer.options.math_accuracy);
+  // Only sampled lights need the tree.
+  std::optional<LightTree> light_tree;
+  if (tracer.options.light_samples > 0) {
+    light_tree.emplace(scene.point_light_sources(), color_profile);
+  }
+  const std::size_t min_shadow_samples =
+      std::max<std::size_t>(1, tracer.options.min_shadow_samples);
+  const std::size_t max_shadow_samples =
+      std::max(min_shadow_samples, tracer.options.max_shadow_samples);
+  const TraceContext trace_context{max_distance2,
+      std::min(tracer.options.max_bounces, kMaxBounces),
+      tracer.options.path_weight_threshold, tracer.options.russian_roulette,
+      min_shadow_samples, max_shadow_samples,
+      light_tree ? &*light_tree : nullptr,
+      tracer.options.light_samples, &sampler, 0, 0, nullptr, nullptr,
+      hit_cache.get(), nullptr, 0, nullptr, nullptr};
+
+  // The tiles of the full image, cut down to the crop window, so that
+  // the pixels inside it are sampled as in a full render. The n-th tiles
+  // of all the views come first, then the (n + 1)-th ones, and so on.
+  const std::size_t tile_size = ClampTileSize(tracer.options.tile_size);
+  std::vector<Tile> view_tiles;
+  for (const Tile &tile : MakeTiles(tracer.options.image_width,
+           tracer.options.image_height, tile_size,
+           tracer.options.tile_order)) {
+    const std::size_t row = std::max(tile.row, window.row);
+    const std::size_t col = std::max(tile.col, window.col);
+    const std::size_t end_row = std::min(tile.row + tile.height,
+                                         window.row + window.height);
+    const std::size_t end_col = std::min(tile.col + tile.width,
+                                         window.col + window.width);
+    if (row >= end_row || col >= end_col) continue;
+    view_tiles.push_back(Tile{row - window.row, col - window.col,
+                              end_row - row, end_col - col});
+  }
+  std::vector<Tile> tiles;
+  tiles.reserve(view_tiles.size() * n_views);
+  for (const Tile &tile : view_tiles) {
+    for (std::size_t view = 0; view < n_views; view++) {
+      tiles.push_back(tile);
+      tiles.back().row += view * view_height;
+    }
+  }
+  std::vector<std::vector<float>> tile_buffers(job.n_threads(),
+      std::vector<float>(tile_size * tile_size * 3));
+  std::vector<std::size_t> n_rays(job.n_threads());
+  std::vector<OccluderCache> occluder_caches(
+      tracer.options.occluder_cache ? job.n_threads() : 0);
+  for (auto &cache : occluder_caches) {
+    cache.occluders.assign(scene.point_light_sources().size(),
+                           CompiledScene::Occluder{});
+  }
+  // A sample's wavelengths, the radiance there, and the lighting, and
+  // the lights that reach a hit, by thread, so that tracing allocates
+  // nothing.
+  const std::size_t n_wavelengths = spectral_sampler.cost();
+  std::vector<std::vector<double>> spectral_scratch(job.n_threads(),
+      std::vector<double>(n_wavelengths * 4));
+  std::vector<std::vector<VisibleLight>> visible_lights(job.n_threads(),
+      std::vector<VisibleLight>(tracer.options.light_samples > 0
+          ? tracer.options.light_samples
+          : scene.point_light_sources().size()));
+  auto thread_context = [&](std::size_t thread) {
+    TraceContext context = trace_context;
+    if (!occluder_caches.empty()) {
+      context.occluder_cache = &occluder_caches[thread];
+    }
+    context.wavelengths = spectral_scratch[thread].data();
+    context.n_wavelengths = n_wavelengths;
+    context.lighting = spectral_scratch[thread].data() + n_wavelengths * 2;
+    context.visible_lights = visible_lights[thread].data();
+    return context;
+  };
+
+  // Pixel samples are taken at subpixel offsets, except for a single one
+  // per pixel, which goes through the corner.
+  const std::size_t min_samples =
+      std::max<std::size_t>(1, tracer.options.min_samples);
+  const std::size_t max_samples =
+      std::max(min_samples, tracer.options.max_samples);
+  if (hit_cache && hit_cache->samples_per_pixel == 0) {
+    hit_cache->samples_per_pixel = max_samples;
+    hit_cache->image_width = tracer.options.image_width;
+    hit_cache->window = window;
+    hit_cache->known.assign(width * height * max_samples, 0);
+    hit_cache->hits.resize(width * height * max_samples);
+  }
+  std::vector<std::size_t> n_cached_rays(job.n_threads());
+  std::vector<std::vector<PixelSamples>> tile_samples(job.n_threads(),
+      std::vector<PixelSamples>(tile_size * tile_size));
+  // Runs of samples for pixels of a tile, traced together.
+  struct SampleRun {
+    std::size_t row, col, count;
+    PixelSamples *samples;
+  };
+  std::vector<std::vector<SampleRun>> tile_runs(job.n_threads());
+  const bool wavefront_mode =
+      tracer.options.execution_mode == ExecutionMode::kWavefront;
+  const TraceWavefrontFunction trace_wavefront =
+      SelectTraceWavefront(tracer.options.math_accuracy);
+  std::vector<Wavefront> wavefronts(
+      wavefront_mode ? job.n_threads() : 0);
+
+  // Every pixel belongs to one tile, and so to one thread at a time.
+  const bool denoise = tracer.options.denoise;
+  DenoiserGuides guides = denoise
+      ? DenoiserGuides(width, height) : DenoiserGuides();
+  // Single samples tell nothing of the noise.
+  if (denoise && min_samples > 1) guides.variance.resize(width * height);
+  Renderer::OutputBuffers &outputs = job_status->outputs;
+  const std::size_t n_pixels = width * height;
+  if (tracer.options.output_depth) {
+    outputs.depth.assign(n_pixels, std::numeric_limits<float>::infinity());
+  }
+  if (tracer.options.output_normal) outputs.normal.assign(n_pixels * 3, 0);
+  if (tracer.options.output_albedo) outputs.albedo.assign(n_pixels * 3, 0);
+  if (tracer.options.output_object_id) {
+    outputs.object_id.assign(n_pixels, Renderer::OutputBuffers::kNoObject);
+  }
+  if (tracer.options.output_hit_count) outputs.hit_count.assign(n_pixels, 0);
+  const bool has_outputs = !outputs.depth.empty() ||
+      !outputs.normal.empty() || !outputs.albedo.empty() ||
+      !outputs.object_id.empty() || !outputs.hit_count.empty();
+  const bool record_paths = denoise || has_outputs;
+  for (auto &wavefront : wavefronts) {
+    wavefront.n_wavelengths = n_wavelengths;
+    wavefront.record_paths = record_paths;
+  }
+
+  auto sample_offset = [&](std::size_t pixel, std::size_t sample) {
+    return max_samples > 1
+        ? sampler.Get2D(pixel, sample, kSubpixelDimension) : double2{0, 0};
+  };
+  auto sample_ray = [&](std::size_t row, std::size_t col,
+                        std::size_t pixel, std::size_t sample) {
+    const double2 offset = sample_offset(pixel, sample);
+    const std::size_t view = row / view_height;
+    return RayThroughPixel(tracer, cameras[view],
+                           window.row + row - view * view_height + offset[1],
+                           window.col + col + offset[0]);
+  };
+  auto add_sample = [&](const double *wavelengths, const double *radiance,
+                        const PathRecord &record, PixelSamples *samples) {
+    const double3 intensities =
+        spectral_sampler.Resolve(wavelengths, radiance);
+    samples->sum += intensities;
+    samples->sum2 += intensities * intensities;
+    if (record_paths) samples->AddPath(record, color_profile.wavelengths);
+  };
+  // Samples are drawn by the pixel's index within its full view, so that
+  // each view, and each crop, comes out the same as it would on its own.
+  auto sample_pixel = [&](const SampleRun &run) {
+    return (window.row + run.row % view_height) * tracer.options.image_width
+        + window.col + run.col;
+  };
+  auto add_samples = [&](const std::vector<SampleRun> &runs,
+                         std::size_t thread) {
+    if (hit_cache) {
+      for (const auto &run : runs) {
+        const std::size_t slot =
+            hit_cache->Slot(sample_pixel(run), run.samples->n);
+        n_cached_rays[thread] += std::count(
+            hit_cache->known.begin() + slot,
+            hit_cache->known.begin() + slot + run.count, 1);
+      }
+    }
+    if (wavefront_mode) {
+      Wavefront &wavefront = wavefronts[thread];
+      wavefront.Clear();
+      for (const auto &run : runs) {
+        const std::size_t pixel = sample_pixel(run);
+        for (std::size_t i = run.samples->n; i < run.samples->n + run.count;
+             i++) {
+          spectral_sampler.Wavelengths(sampler, pixel, i,
+              kWavelengthDimension, wavefront.AddCameraRay(
+                  sample_ray(run.row, run.col, pixel, i), pixel, i));
+        }
+      }
+      trace_wavefront(compiled_scene, thread_context(thread), &wavefront);
+      std::size_t path = 0;
+      for (const auto &run : runs) {
+        for (std::size_t i = 0; i < run.count; i++) {
+          add_sample(&wavefront.wavelengths[path * n_wavelengths],
+                     &wavefront.radiance[path * n_wavelengths],
+                     record_paths ? wavefront.path_records[path]
+                                  : PathRecord(),
+                     run.samples);
+          path++;
+        }
+      }
+    } else {
+      for (const auto &run : runs) {
+        const std::size_t pixel = sample_pixel(run);
+        TraceContext context = thread_context(thread);
+        context.pixel = pixel;
+        PathRecord record;
+        if (record_paths) context.path_record = &record;
+        double *wavelengths = spectral_scratch[thread].data();
+        double *radiance = wavelengths + n_wavelengths;
+        for (std::size_t i = run.samples->n; i < run.samples->n + run.count;
+             i++) {
+          context.sample = i;
+          spectral_sampler.Wavelengths(sampler, pixel, i,
+                                       kWavelengthDimension, wavelengths);
+          trace_ray(compiled_scene, context,
+                    sample_ray(run.row, run.col, pixel, i), radiance);
+          add_sample(wavelengths, radiance, record, run.samples);
+        }
+      }
+    }
+    for (const auto &run : runs) {
+      if (reprojection) {
+        const std::size_t pixel = sample_pixel(run);
+        for (std::size_t i = run.samples->n;
+             i < run.samples->n + run.count; i++) {
+          run.samples->offset += sample_offset(pixel, i);
+        }
+      }
+      run.samples->n += run.count;
+      n_rays[thread] += run.count;
+    }
+  };
+
+  // Of a frame sequence, a ray through the sample anchor of every pixel
+  // finds the pixels to copy from the previous frame, and leaves its hits
+  // for the next one. The copies need no tracing in any pass.
+  std::vector<std::uint8_t> reused;
+  bool stopped = false;
+  if (reprojection) {
+    const double anchor = SampleAnchor(tracer.options);
+    const FrameSequence::Frame *previous = reprojection->previous.get();
+    FrameSequence::Frame &next = *reprojection->next;
+    next.camera = cameras[0];
+    next.distance.assign(n_pixels, std::numeric_limits<float>::infinity());
+    next.object.assign(n_pixels, CompiledScene::kNoObject);
+    next.drift.assign(n_pixels * 2, 0);
+    reused.assign(n_pixels, 0);
+    std::vector<std::size_t> n_reused(job.n_threads());
+    stopped = !job.RunTiles(tiles, [&](const Tile &tile,
+                                       std::size_t thread) {
+      float *buffer = tile_buffers[thread].data();
+      std::fill(buffer, buffer + tile.height * tile.width * 3, 0.0f);
+      for (std::size_t y = 0; y < tile.height; y++) {
+        for (std::size_t x = 0; x < tile.width; x++) {
+          const std::size_t pixel = (tile.row + y) * width + tile.col + x;
+          const Ray ray = RayThroughPixel(tracer, cameras[0],
+                                          window.row + tile.row + y + anchor,
+                                          window.col + tile.col + x + anchor);
+          const auto isec = compiled_scene.Intersect(ray);
+          if (!isec) continue;
+          next.distance[pixel] = length(isec->point - ray.origin);
+          next.object[pixel] = isec->object;
+          // What mirrors and glass show moves differently from them.
+          if (!previous || isec->material->reflectivity > 0 ||
+              isec->material->transparency > 0) {
+            continue;
+          }
+          double2 drift;
+          const auto previous_pixel = ReprojectedPixel(*previous, *isec,
+              tracer.options, window, reprojection->depth_tolerance,
+              reprojection->max_drift, &drift);
+          if (!previous_pixel) continue;
+          next.drift[pixel * 2] = drift[0];
+          next.drift[pixel * 2 + 1] = drift[1];
+
+          reused[pixel] = 1;
+          n_reused[thread]++;
+          const float *color = previous->image.data() + *previous_pixel * 3;
+          std::copy(color, color + 3, buffer + (y * tile.width + x) * 3);
+          if (record_paths) {
+            PathRecord record;
+            RecordFirstHit(ray, isec, &record);
+            record.n_hits = 1;
+            PixelSamples probe;
+            probe.n = 1;
+            probe.AddPath(record, color_profile.wavelengths);
+            if (denoise) probe.StoreGuides(pixel, &guides);
+            if (has_outputs) probe.StoreOutputs(pixel, &outputs);
+          }
+        }
+      }
+      framebuffer->WriteTile(tile, buffer);
+    });
+    std::size_t total_reused = 0;
+    for (std::size_t n : n_reused) total_reused += n;
+    job_status->statistics.reused_pixel_fraction =
+        double(total_reused) / n_pixels;
+    job_status->amount_done += amount_done_per_pixel * total_reused;
+  }
+
+  // Each pass traces the pixels of a grid with the given stride (relative
+  // to the tile corner) that the coarser grid of the previous pass did
+  // not have, and fills every pixel with the value of its grid cell.
+  const auto strides = PassStrides(tracer.options);
+  for (std::size_t pass = 0; !stopped && pass < strides.size(); pass++) {
+    const std::size_t stride = strides[pass];
+    const std::size_t traced_stride = pass > 0 ? strides[pass - 1] : 0;
+
+    const bool done = job.RunPass(tiles, [&](const Tile &tile,
+                                             std::size_t thread) {
+      float *buffer = tile_buffers[thread].data();
+      if (pass > 0 || !reused.empty()) framebuffer->ReadTile(tile, buffer);
+
+      // Every pixel first gets min_samples. Then the ones that vary, or
+      // differ from a neighbour in the tile, get twice as many at a time
+      // up to max_samples. Each round of samples for the tile is traced
+      // at once.
+      auto is_reused = [&](std::size_t y, std::size_t x) {
+        return !reused.empty() &&
+               reused[(tile.row + y) * width + tile.col + x];
+      };
+      auto traced = [&](std::size_t y, std::size_t x) {
+        return !(traced_stride &&
+                 y % traced_stride == 0 && x % traced_stride == 0) &&
+               !is_reused(y, x);
+      };
+      PixelSamples *samples = tile_samples[thread].data();
+      std::vector<SampleRun> &runs = tile_runs[thread];
+      runs.clear();
+      std::size_t n_traced = 0;
+      for (std::size_t y = 0; y < tile.height; y += stride) {
+        for (std::size_t x = 0; x < tile.width; x += stride) {
+          if (!traced(y, x)) continue;
+          PixelSamples &pixel_samples = samples[y * tile.width + x];
+          pixel_samples = PixelSamples();
+          runs.push_back(SampleRun{tile.row + y, tile.col + x, min_samples,
+                                   &pixel_samples});
+          n_traced++;
+        }
+      }
+      add_samples(runs, thread);
+      for (const auto &run : runs) {
+        run.samples->Store(buffer + ((run.row - tile.row) * tile.width +
+                                     (run.col - tile.col)) * 3);
+      }
+
+      if (max_samples > min_samples) {
+        for (std::size_t y = 0; y < tile.height; y += stride) {
+          for (std::size_t x = 0; x < tile.width; x += stride) {
+            if (!traced(y, x)) continue;
+            samples[y * tile.width + x].contrasting = HasContrastingNeighbor(
+                buffer, tile, y, x, stride, tracer.options);
+          }
+        }
+        while (true) {
+          runs.clear();
+          for (std::size_t y = 0; y < tile.height; y += stride) {
+            for (std::size_t x = 0; x < tile.width; x += stride) {
+              if (!traced(y, x)) continue;
+              PixelSamples &pixel_samples = samples[y * tile.width + x];
+              if (pixel_samples.n < max_samples &&
+                  (pixel_samples.contrasting ||
+                   !SamplesConverged(pixel_samples, tracer.options))) {
+                runs.push_back(SampleRun{tile.row + y, tile.col + x,
+                    std::min(pixel_samples.n, max_samples - pixel_samples.n),
+                    &pixel_samples});
+              }
+            }
+          }
+          if (runs.empty()) break;
+          add_samples(runs, thread);
+        }
+        for (std::size_t y = 0; y < tile.height; y += stride) {
+          for (std::size_t x = 0; x < tile.width; x += stride) {
+            if (!traced(y, x)) continue;
+            samples[y * tile.width + x].Store(
+                buffer + (y * tile.width + x) * 3);
+          }
+        }
+      }
+
+      if (reprojection) {
+        FrameSequence::Frame &next = *reprojection->next;
+        const double anchor = SampleAnchor(tracer.options);
+        for (std::size_t y = 0; y < tile.height; y += stride) {
+          for (std::size_t x = 0; x < tile.width; x += stride) {
+            if (!traced(y, x)) continue;
+            const std::size_t pixel = (tile.row + y) * width + tile.col + x;
+            const PixelSamples &pixel_samples = samples[y * tile.width + x];
+            for (std::size_t i = 0; i < 2; i++) {
+              next.drift[pixel * 2 + i] =
+                  pixel_samples.offset[i] / pixel_samples.n - anchor;
+            }
+          }
+        }
+      }
+
+      if (record_paths) {
+        for (std::size_t y = 0; y < tile.height; y += stride) {
+          for (std::size_t x = 0; x < tile.width; x += stride) {
+            if (!traced(y, x)) continue;
+            const std::size_t pixel = (tile.row + y) * width + tile.col + x;
+            const PixelSamples &pixel_samples = samples[y * tile.width + x];
+            if (denoise) pixel_samples.StoreGuides(pixel, &guides);
+            if (has_outputs) pixel_samples.StoreOutputs(pixel, &outputs);
+          }
+        }
+      }
+
+      if (stride > 1) {
+        for (std::size_t y = 0; y < tile.height; y++) {
+          for (std::size_t x = 0; x < tile.width; x++) {
+            if (is_reused(y, x)) continue;
+            const float *cell = buffer +
+                ((y - y % stride) * tile.width + (x - x % stride)) * 3;
+            std::copy(cell, cell + 3, buffer + (y * tile.width + x) * 3);
+          }
+        }
+      }
+
+      framebuffer->WriteTile(tile, buffer);
       // A race condition doesn't really bother us here
-      job_status->amount_done += amount_done_per_pixel;
+      job_status->amount_done += amount_done_per_pixel * n_traced;
+    });
+    if (!done) break;
+  }
+  job.EndTracing();
+  for (std::size_t n : n_rays) job_status->statistics.primary_rays += n;
+  for (std::size_t n : n_cached_rays) {
+    job_status->statistics.cached_camera_rays += n;
+  }
+  for (const auto &cache : occluder_caches) {
+    job_status->statistics.shadow_rays += cache.n_shadow_rays;
+    job_status->statistics.occluded_shadow_rays += cache.n_occluded;
+    job_status->statistics.occluder_cache_hits += cache.n_hits;
+  }
+
+  if (reprojection) reprojection->next->image = framebuffer->Snapshot();
+
+  // Only a finished image has guides for every pixel. Each view is
+  // denoised on its own, so that none bleeds into the next.
+  if (denoise && job_status->outcome == Renderer::Outcome::kCompleted) {
+    auto denoising_start = std::chrono::steady_clock::now();
+    const Denoiser denoiser(tracer.options.denoiser);
+    const std::size_t view_pixels = width * view_height;
+    for (std::size_t view = 0; view < n_views; view++) {
+      const Tile view_tile{view * view_height, 0, view_height, width};
+      Framebuffer image(width, view_height);
+      framebuffer->ReadTile(view_tile, image.data());
+      if (n_views == 1) {
+        denoiser.Denoise(guides, &image);
+      } else {
+        auto slice = [&](const std::vector<float> &buffer,
+                         std::size_t channels) {
+          if (buffer.empty()) return std::vector<float>();
+          const auto begin =
+              buffer.begin() + view * view_pixels * channels;
+          return std::vector<float>(begin, begin + view_pixels * channels);
+        };
+        DenoiserGuides view_guides;
+        view_guides.depth = slice(guides.depth, 1);
+        view_guides.normal = slice(guides.normal, 3);
+        view_guides.albedo = slice(guides.albedo, 3);
+        view_guides.variance = slice(guides.variance, 1);
+        denoiser.Denoise(view_guides, &image);
+      }
+      framebuffer->WriteTile(view_tile, image.data());
     }
+    job_status->statistics.denoising_seconds =
+        SecondsSince(denoising_start);
+  }
+
+  const ColorConverter converter(color_profile, tracer.options.gamma,
+                                 tracer.options.tone_mapping,
+                                 tracer.options.exposure);
+  Framebuffer image = framebuffer->Snapshot();
+  if (tracer.options.crop && tracer.options.paste_crop) {
+    image = PasteCrop(image, tracer.options, n_views);
   }
-  job_status->amount_done = 1.0;
-  return result;
+  return job.Finish(std::move(image), converter,
+                    tracer.options.pixel_layout);
 }
 
 }  // namespace
 
-std::shared_ptr<Renderer::JobStatus> RayTracer::Render(const Scene &scene,
-    const Camera &camera) {
+std::shared_ptr<Renderer::JobStatus> StartRayTracerJob(
+    const RayTracer &tracer, const Scene &scene,
+    const std::vector<Camera> &cameras,
+    std::shared_ptr<const Reprojection> reprojection,
+    std::shared_ptr<Relighter::HitCache> hit_cache) {
+  const RayTracer::Options &options = tracer.options;
   auto job_status = std::make_shared<Renderer::JobStatus>();
   job_status->amount_done = 0;
+  job_status->passes_total = PassStrides(options).size();
+
+  const Tile window = CropWindow(options);
+  auto framebuffer = std::make_shared<SharedFramebuffer>(
+      window.width, window.height * cameras.size());
+  std::function<Framebuffer(Framebuffer)> paste_crop;
+  if (options.crop && options.paste_crop) {
+    paste_crop = [options, n_views = cameras.size()](Framebuffer image) {
+      return PasteCrop(image, options, n_views);
+    };
+  }
+  job_status->snapshot = ConvertingSnapshot(framebuffer,
+      ColorConverter(options.color_profile, options.gamma,
+                     options.tone_mapping, options.exposure),
+      options.pixel_layout, std::move(paste_crop));
+
   job_status->result = std::async(std::launch::async,
-      RenderPixels, *this, scene, camera, job_status);
+      RenderPixels, tracer, scene, cameras, framebuffer, job_status,
+      reprojection, hit_cache);
   return job_status;
 }
 
+std::shared_ptr<Renderer::JobStatus> RayTracer::Render(const Scene &scene,
+    const Camera &camera) {
+  return Render(scene, std::vector<Camera>{camera});
+}
+
+std::shared_ptr<Renderer::JobStatus> RayTracer::RenderAll(
+    const Scene &scene) {
+  std::vector<Camera> cameras;
+  for (const auto &camera : scene.cameras()) cameras.push_back(*camera);
+  return Render(scene, cameras);
+}
+
+std::shared_ptr<Renderer::JobStatus> RayTracer::Render(const Scene &scene,
+    const std::vector<Camera> &cameras) {
+  return StartRayTracerJob(*this, scene, cameras, nullptr, nullptr);
+}
+
 }  // namespace deer
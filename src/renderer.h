@@ -5,22 +5,113 @@
 #ifndef DEER_RENDERER_H_
 #define DEER_RENDERER_H_
 
+#include <atomic>
 #include <cstdint>
+#include <functional>
 #include <future>
 #include <limits>
 #include <memory>
+#include <optional>
 #include <vector>
 
+#include "color_conversion.h"
+#include "compiled_scene.h"
+#include "denoiser.h"
+#include "fast_math.h"
+#include "framebuffer.h"
 #include "rgb.h"
+#include "sampler.h"
 #include "scene.h"
+#include "scheduler.h"
+#include "spectral_sampling.h"
 
 namespace deer {
 
 class Renderer {
  public:
+  struct Statistics {
+    double tracing_seconds = 0;
+    double conversion_seconds = 0;  // framebuffer to bytes
+    double denoising_seconds = 0;
+    std::size_t tiles_stolen = 0;
+    std::size_t primary_rays = 0;  // from the camera
+    // Counted with the occluder cache on. A hit is a shadow ray found
+    // blocked by the object that blocked the last one to the same light.
+    std::size_t shadow_rays = 0;
+    std::size_t occluded_shadow_rays = 0;
+    std::size_t occluder_cache_hits = 0;
+    // Of a FrameSequence frame, the pixels copied from the frame before.
+    double reused_pixel_fraction = 0;
+    // Of a Relighter render, the camera rays whose hits were kept from
+    // the renders before.
+    std::size_t cached_camera_rays = 0;
+    // Of a DistributedRenderer job, the workers that were dropped, and
+    // the regions they took along that had to be traced again.
+    std::size_t workers_lost = 0;
+    std::size_t regions_retraced = 0;
+
+    // The fraction of blocked shadow rays that the cache answered.
+    double occluder_cache_hit_rate() const {
+      return occluded_shadow_rays > 0
+          ? double(occluder_cache_hits) / occluded_shadow_rays : 0;
+    }
+    // Tiles of the pass that was interrupted which did get finished;
+    // the passes before it covered the whole image.
+    std::vector<Tile> finished_tiles;
+
+    // Pixel samples, that is primary rays, per second of tracing.
+    double samples_per_second() const {
+      return tracing_seconds > 0 ? primary_rays / tracing_seconds : 0;
+    }
+  };
+
+  // Per-pixel outputs besides the colour, for compositing, denoisers and
+  // debugging, from the same paths as the colour. Row-major; empty unless
+  // requested. Pixels not traced yet, when a job stops early, look as
+  // though their rays hit nothing.
+  struct OutputBuffers {
+    static constexpr std::uint32_t kNoObject = ~std::uint32_t{0};
+
+    // Along the camera rays to their first hits, over the samples that
+    // hit anything; infinity if none did.
+    std::vector<float> depth;
+    // x, y, z of the world-space normal at the first hits, facing the
+    // camera, averaged and of unit length; zero if no sample hit.
+    std::vector<float> normal;
+    // r, g, b of the diffuse colour at the first hits, at the colour
+    // profile wavelengths, where mirrors and glass count as white.
+    std::vector<float> albedo;
+    // The index into Scene::objects() of what the first sample hit.
+    std::vector<std::uint32_t> object_id;
+    // Camera, mirrored and refracted rays of the pixel's samples that hit
+    // anything; shadow rays are not counted.
+    std::vector<std::uint32_t> hit_count;
+  };
+
+  enum struct Outcome {
+    kCompleted,
+    kCancelled,  // through JobStatus::cancel_requested
+    kTimedOut,  // ran out of its time limit
+  };
+
   struct JobStatus {
-    std::future<std::vector<std::uint8_t>> result;  // RGB bytes
+    std::future<std::vector<std::uint8_t>> result;  // RGB bytes by default
     double amount_done;  // from 0.0 to 1.0
+    std::size_t passes_total = 1;
+    std::atomic<std::size_t> passes_done{0};
+    // The image as refined so far, in the same layout as the result.
+    // May be called from any thread at any time, even after the job is
+    // done; never tears a tile. Empty if the renderer does not support it.
+    std::function<std::vector<std::uint8_t>()> snapshot;
+    // Set to stop the job early. Threads finish the tiles they are on and
+    // quit, and the result holds the image as refined so far.
+    std::atomic<bool> cancel_requested{false};
+    Outcome outcome = Outcome::kCompleted;  // valid once the result is ready
+    Statistics statistics;  // valid once the result is ready
+    OutputBuffers outputs;  // valid once the result is ready
+    // The linear intensities that the result was converted from, before
+    // tone mapping and quantization; valid once the result is ready.
+    Framebuffer image;
     // TODO(iliazeus): 'error' field
   };
 
@@ -29,12 +120,120 @@ class Renderer {
   virtual ~Renderer() {}
 };
 
+enum struct ExecutionMode {
+  // Every pixel sample is traced to the end on its own, shading and
+  // casting shadow rays as it goes.
+  kPerPixel,
+  // All the samples a tile needs at a time go through each stage
+  // together: closest hits for all the rays, then shading, then shadow
+  // rays for all the hits, then the secondary rays. The rays of a stage
+  // go through the scene in chunks, each object against a whole chunk,
+  // where most misses are told apart by loops that vectorize. The image
+  // is kPerPixel's up to the rounding of sums over bounces.
+  kWavefront,
+};
+
 class RayTracer : public Renderer {
  public:
   struct Options {
     std::size_t image_width, image_height;
     RgbColorProfile color_profile;
+    PixelLayout pixel_layout = PixelLayout::kRgb;
+    double gamma = 1;  // applied during conversion to bytes
+    // Also applied during conversion to bytes; the linear image in
+    // JobStatus::image can be converted again with other settings.
+    ToneMapping tone_mapping = ToneMapping::kLinear;
+    double exposure = 1;
+    // Only the pixels of this rectangle of the image, cut down to the
+    // image, are traced and allocated. Their camera rays and samples are
+    // those of the full image, and so are the tiles, cut down as well;
+    // pixels by the edges of the crop may only differ when adaptive
+    // anti-aliasing misses their neighbours outside it. With paste_crop,
+    // the result, snapshots and JobStatus::image are of the full image,
+    // black outside the crop; the output buffers are always of the crop.
+    std::optional<Tile> crop;
+    bool paste_crop = false;
     double max_distance = 1e6;
+    // Mirrored and refracted rays go at most max_bounces (up to 16) deep.
+    // Before that, a path whose weight falls under path_weight_threshold
+    // ends, or with russian_roulette goes on only with a probability
+    // proportional to its weight.
+    std::size_t max_bounces = 8;
+    double path_weight_threshold = 0.05;
+    bool russian_roulette = true;
+    // A light with a softness casts min_shadow_samples shadow rays to
+    // points all over it, and where they disagree, in a penumbra, up to
+    // max_shadow_samples in all. A hard light casts just one.
+    std::size_t min_shadow_samples = 2;
+    std::size_t max_shadow_samples = 16;
+    // Zero shades every point with every light. Otherwise each point is
+    // shaded by light_samples lights picked at random from a light tree,
+    // about in proportion to their power over their squared distance,
+    // which keeps the cost the same however many lights there are.
+    std::size_t light_samples = 0;
+    // Every thread tries first the object that blocked its last shadow ray
+    // to the same light, and of a mesh the triangle, as neighbouring
+    // pixels tend to share occluders. Does not change the image. Off by
+    // default: it only pays where one occluder shadows many pixels in a
+    // scene of many objects, and then by not much.
+    bool occluder_cache = false;
+    MathAccuracy math_accuracy = MathAccuracy::kExact;  // for shading
+    GeometryDispatch geometry_dispatch = GeometryDispatch::kBucketed;
+    // Both modes give the same image, except that with secondary rays the
+    // terms of a path add up, and play Russian roulette, in another order.
+    ExecutionMode execution_mode = ExecutionMode::kPerPixel;
+
+    std::size_t n_threads = 0;  // one per hardware thread
+    std::size_t tile_size = 16;
+    TileOrder tile_order = TileOrder::kMorton;
+    bool work_stealing = true;
+    // Seconds; zero means no limit. On running out, the job stops as if
+    // cancelled. Best used with progressive rendering.
+    double time_limit = 0;
+
+    // Progressive rendering first traces one pixel in every
+    // progressive_stride x progressive_stride block of each tile, then
+    // halves the stride on every pass, so that snapshots show a coarse
+    // but complete image early on. The stride is capped by tile_size.
+    bool progressive = false;
+    std::size_t progressive_stride = 16;
+
+    // Adaptive anti-aliasing: every pixel gets min_samples rays at
+    // subpixel offsets. Then it gets twice as many at a time, up to
+    // max_samples, while the standard error of its mean is over
+    // aa_threshold of the colour profile range, or it differs from a
+    // neighbour by over aa_contrast of it. A single sample per pixel goes
+    // through the pixel corner.
+    std::size_t min_samples = 1;
+    std::size_t max_samples = 1;
+    double aa_threshold = 0.01;
+    double aa_contrast = 0.1;
+
+    // For subpixel offsets, hero wavelengths, picking lights and soft
+    // shadows.
+    SampleSequence sample_sequence = SampleSequence::kSobol;
+    std::uint32_t sample_seed = 0;
+
+    SpectralSampling spectral_sampling = SpectralSampling::kRgb;
+    int spectral_samples = 1;  // hero wavelengths per pixel
+    int wavelengths_per_sample = 4;  // the hero one and its companions
+    int spectral_bins = 256;  // for SpectralSampling::kDense
+
+    // Filters the noise of soft shadows and sampled lights out of the
+    // finished image, guided by the depth, normal and albedo of the
+    // pixels' first hits. With min_samples of two or more the samples
+    // tell how noisy every pixel is; otherwise it is estimated from its
+    // neighbours. Jobs that stop early are left as they are.
+    bool denoise = false;
+    Denoiser::Options denoiser;
+
+    // Output buffers to fill in along with the image, in
+    // JobStatus::outputs.
+    bool output_depth = false;
+    bool output_normal = false;
+    bool output_albedo = false;
+    bool output_object_id = false;
+    bool output_hit_count = false;
   };
   const Options options;
 
@@ -42,6 +241,16 @@ class RayTracer : public Renderer {
 
   std::shared_ptr<JobStatus> Render(const Scene &,
                                     const Camera &) override;
+  // Renders several views of a scene as one job: the scene is prepared
+  // once, and the tiles of all the views are interleaved over the same
+  // threads, so that a view that is cheap to trace does not leave threads
+  // idle. Everything the job returns stacks the views from top to bottom,
+  // as if they were one image cameras.size() times as tall; the result
+  // holds each view's bytes in turn, as Render would return them.
+  std::shared_ptr<JobStatus> Render(const Scene &,
+                                    const std::vector<Camera> &);
+  // From every camera of the scene, in order.
+  std::shared_ptr<JobStatus> RenderAll(const Scene &);
 };
 
 }  // namespace deer
@@ -10,14 +10,19 @@
 
 namespace deer {
 
-Spectrum RgbColorProfile::FromRgb(double3 rgb) const {
+double3 RgbColorProfile::band_widths() const {
   auto g_width = std::min(
       wavelengths.r() - wavelengths.g(), wavelengths.g() - wavelengths.b());
   auto r_width = 2 * (wavelengths.r() - wavelengths.g()) - g_width;
   auto b_width = 2 * (wavelengths.g() - wavelengths.b()) - g_width;
-  auto r_sp = Spectrum::MakeMonochrome(wavelengths.r(), r_width, rgb.r());
-  auto g_sp = Spectrum::MakeMonochrome(wavelengths.g(), g_width, rgb.g());
-  auto b_sp = Spectrum::MakeMonochrome(wavelengths.b(), b_width, rgb.b());
+  return double3{r_width, g_width, b_width};
+}
+
+Spectrum RgbColorProfile::FromRgb(double3 rgb) const {
+  auto widths = band_widths();
+  auto r_sp = Spectrum::MakeMonochrome(wavelengths.r(), widths.r(), rgb.r());
+  auto g_sp = Spectrum::MakeMonochrome(wavelengths.g(), widths.g(), rgb.g());
+  auto b_sp = Spectrum::MakeMonochrome(wavelengths.b(), widths.b(), rgb.b());
   return r_sp + g_sp + b_sp;
 }
 
@@ -23,11 +23,18 @@ struct RgbColorProfile {
     return FromRgb(double3{rgb.r()/255.0, rgb.g()/255.0, rgb.b()/255.0});
   }
 
-  double3 ToRgb(const Spectrum &spectrum) const {
-    return (spectrum(wavelengths) - min_intensities)
+  // Each channel responds to a band of wavelengths around its own one;
+  // the bands are adjacent and do not overlap.
+  double3 band_widths() const;
+
+  double3 ToRgb(double3 intensities) const {
+    return (intensities - min_intensities)
         .clamp(min_intensities, max_intensities)
         / (max_intensities - min_intensities);
   }
+  double3 ToRgb(const Spectrum &spectrum) const {
+    return ToRgb(spectrum(wavelengths));
+  }
   byte3 ToRgbBytes(double3 rgb) const {
     return byte3{
       static_cast<std::uint8_t>(rgb.r() * 255),
@@ -0,0 +1,238 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "sampler.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "vector.h"
+
+namespace deer {
+
+namespace {
+
+// splitmix64 finalizer
+std::uint64_t Hash(std::uint64_t x) {
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+std::uint32_t HashCombine(std::uint64_t a, std::uint64_t b) {
+  return static_cast<std::uint32_t>(
+      Hash(a * 0xd1342543de82ef95ull + b) >> 32);
+}
+
+double ToUnit(std::uint32_t x) {
+  return x * 0x1.0p-32;
+}
+
+std::uint32_t ReverseBits(std::uint32_t x) {
+  x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+  x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+  x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+  x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+  return (x >> 16) | (x << 16);
+}
+
+// Owen scrambling through a hash that only lets lower bits affect higher
+// ones (Laine and Karras, as improved by Burley), applied bit-reversed.
+std::uint32_t NestedUniformScramble(std::uint32_t x, std::uint32_t seed) {
+  x = ReverseBits(x);
+  x += seed;
+  x ^= x * 0x6c50b47cu;
+  x ^= x * 0xb82f1e52u;
+  x ^= x * 0xc7afe638u;
+  x ^= x * 0x8d22f6e6u;
+  return ReverseBits(x);
+}
+
+// The first two Sobol dimensions: van der Corput, and the one with the
+// primitive polynomial x + 1. Together they form a (0, 2)-sequence.
+// Stored as the XOR of the direction numbers for every byte value of the
+// index at every byte position, so that a point takes four lookups.
+struct SobolTables {
+  std::array<std::array<std::array<std::uint32_t, 256>, 4>, 2> t;
+
+  constexpr SobolTables() : t() {
+    std::uint32_t v[2][32] = {};
+    for (int i = 0; i < 32; i++) v[0][i] = 1u << (31 - i);
+    v[1][0] = 1u << 31;
+    for (int i = 1; i < 32; i++) v[1][i] = v[1][i - 1] ^ (v[1][i - 1] >> 1);
+
+    for (int d = 0; d < 2; d++) {
+      for (int byte = 0; byte < 4; byte++) {
+        for (int value = 0; value < 256; value++) {
+          std::uint32_t x = 0;
+          for (int bit = 0; bit < 8; bit++) {
+            if (value >> bit & 1) x ^= v[d][byte * 8 + bit];
+          }
+          t[d][byte][value] = x;
+        }
+      }
+    }
+  }
+};
+
+constexpr SobolTables kSobolTables;
+
+std::uint32_t Sobol(std::uint32_t index, std::size_t dimension) {
+  const auto &t = kSobolTables.t[dimension];
+  return t[0][index & 0xff] ^ t[1][index >> 8 & 0xff] ^
+         t[2][index >> 16 & 0xff] ^ t[3][index >> 24];
+}
+
+// Dimensions are padded in pairs: every pair takes the 2D Sobol points
+// in its own shuffled order, so that pairs are not correlated.
+std::uint32_t ScrambledSobol(std::uint32_t sample, std::size_t dimension,
+                             std::uint32_t seed) {
+  const std::uint32_t pair_seed = HashCombine(seed, dimension / 2);
+  const std::uint32_t index = NestedUniformScramble(sample, pair_seed);
+  return NestedUniformScramble(Sobol(index, dimension % 2),
+                               HashCombine(pair_seed, dimension));
+}
+
+constexpr std::size_t kBlueNoiseSize = 64;
+
+// A blue noise mask: a permutation of 0..size^2 - 1 over a toroidal
+// size x size tile, in which every threshold leaves evenly spread
+// points. Made by Ulichney's void-and-cluster method.
+std::vector<std::uint16_t> MakeBlueNoise() {
+  const std::size_t n = kBlueNoiseSize, n_pixels = n * n;
+
+  const double sigma = 1.5;
+  std::vector<double> kernel(n_pixels);
+  for (std::size_t dy = 0; dy < n; dy++) {
+    for (std::size_t dx = 0; dx < n; dx++) {
+      const double x = std::min(dx, n - dx), y = std::min(dy, n - dy);
+      kernel[dy * n + dx] = std::exp(-(x * x + y * y) / (2 * sigma * sigma));
+    }
+  }
+
+  std::vector<char> pattern(n_pixels);
+  std::vector<double> energy(n_pixels);
+  auto toggle = [&](std::size_t p, bool on) {
+    pattern[p] = on;
+    const std::size_t py = p / n, px = p % n;
+    for (std::size_t qy = 0; qy < n; qy++) {
+      const double *row = &kernel[((qy + n - py) % n) * n];
+      for (std::size_t qx = 0; qx < n; qx++) {
+        energy[qy * n + qx] += on ? row[(qx + n - px) % n]
+                                  : -row[(qx + n - px) % n];
+      }
+    }
+  };
+  // The set pixel with the most set neighbours nearby, or the unset one
+  // with the fewest.
+  auto tightest_cluster = [&] {
+    std::size_t best = 0;
+    double best_energy = -1;
+    for (std::size_t p = 0; p < n_pixels; p++) {
+      if (pattern[p] && energy[p] > best_energy) {
+        best = p;
+        best_energy = energy[p];
+      }
+    }
+    return best;
+  };
+  auto largest_void = [&] {
+    std::size_t best = 0;
+    double best_energy = n_pixels;
+    for (std::size_t p = 0; p < n_pixels; p++) {
+      if (!pattern[p] && energy[p] < best_energy) {
+        best = p;
+        best_energy = energy[p];
+      }
+    }
+    return best;
+  };
+
+  // A random tenth of the pixels, relaxed into an even pattern.
+  std::size_t n_initial = 0;
+  for (std::uint64_t i = 0; n_initial < n_pixels / 10; i++) {
+    const std::size_t p = Hash(i) % n_pixels;
+    if (!pattern[p]) {
+      toggle(p, true);
+      n_initial++;
+    }
+  }
+  while (true) {
+    const std::size_t cluster = tightest_cluster();
+    toggle(cluster, false);
+    const std::size_t void_ = largest_void();
+    toggle(void_, true);
+    if (void_ == cluster) break;
+  }
+
+  std::vector<std::uint16_t> ranks(n_pixels);
+  const auto initial_pattern = pattern;
+  const auto initial_energy = energy;
+  for (std::size_t rank = n_initial; rank-- > 0;) {
+    const std::size_t cluster = tightest_cluster();
+    toggle(cluster, false);
+    ranks[cluster] = rank;
+  }
+  // Past half full, the largest void of the set pixels is the tightest
+  // cluster of the unset ones, so one rule serves for the rest.
+  pattern = initial_pattern;
+  energy = initial_energy;
+  for (std::size_t rank = n_initial; rank < n_pixels; rank++) {
+    const std::size_t void_ = largest_void();
+    toggle(void_, true);
+    ranks[void_] = rank;
+  }
+  return ranks;
+}
+
+// The mask is shifted by a different toroidal offset for every dimension,
+// following the R2 sequence, so that dimensions are not correlated.
+double BlueNoise(std::size_t row, std::size_t col, std::size_t dimension) {
+  static const std::vector<std::uint16_t> mask = MakeBlueNoise();
+  const std::size_t n = kBlueNoiseSize;
+  const double g = 1.32471795724474602596;  // the plastic number
+  const double ox = dimension / g, oy = dimension / (g * g);
+  const std::size_t x =
+      (col + static_cast<std::size_t>((ox - std::floor(ox)) * n)) % n;
+  const std::size_t y =
+      (row + static_cast<std::size_t>((oy - std::floor(oy)) * n)) % n;
+  return (mask[y * n + x] + 0.5) / (n * n);
+}
+
+}  // namespace
+
+Sampler::Sampler(SampleSequence sequence, std::size_t image_width,
+                 std::uint32_t seed)
+    : sequence_(sequence)
+    , image_width_(std::max<std::size_t>(image_width, 1))
+    , seed_(seed) {}
+
+double Sampler::Get(std::size_t pixel, std::size_t sample,
+                    std::size_t dimension) const {
+  switch (sequence_) {
+    case SampleSequence::kRandom:
+      return ToUnit(HashCombine(HashCombine(seed_, pixel),
+                                HashCombine(sample, dimension)));
+
+    case SampleSequence::kSobol:
+      return ToUnit(ScrambledSobol(sample, dimension,
+                                   HashCombine(seed_, pixel)));
+
+    case SampleSequence::kBlueNoise: {
+      const double shift = BlueNoise(pixel / image_width_,
+                                     pixel % image_width_, dimension);
+      const double x = ToUnit(ScrambledSobol(sample, dimension, seed_)) +
+                       shift;
+      return x < 1 ? x : x - 1;
+    }
+  }
+  return 0;
+}
+
+}  // namespace deer
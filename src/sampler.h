@@ -0,0 +1,63 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#ifndef DEER_SAMPLER_H_
+#define DEER_SAMPLER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "vector.h"
+
+namespace deer {
+
+enum struct SampleSequence {
+  // Independent hashed random numbers; the baseline.
+  kRandom,
+  // Owen-scrambled Sobol points, scrambled differently for every pixel.
+  // Any first 2^k samples of a pixel are stratified over every pair of
+  // dimensions (2d, 2d + 1), so the error falls off faster than with
+  // kRandom.
+  kSobol,
+  // Owen-scrambled Sobol points shared by all pixels and shifted per
+  // pixel by a blue noise mask. Neighbouring pixels get very different
+  // shifts, so what error remains looks like fine, even grain rather
+  // than blotches.
+  kBlueNoise,
+};
+
+// Numbers in [0, 1) for stochastic rendering, indexed by pixel, sample
+// and dimension. A pure function of its arguments: cheap, thread-safe,
+// and reproducible however the pixels are split between threads.
+//
+// A path through the renderer should give each of its random decisions
+// its own dimension, and take 2D decisions from pairs starting at even
+// dimensions, which are stratified together.
+class Sampler {
+ public:
+  // The image width maps pixel indices onto the blue noise mask.
+  explicit Sampler(SampleSequence sequence = SampleSequence::kSobol,
+                   std::size_t image_width = 1,
+                   std::uint32_t seed = 0);
+
+  SampleSequence sequence() const { return sequence_; }
+
+  double Get(std::size_t pixel, std::size_t sample,
+             std::size_t dimension) const;
+  // Dimensions dimension and dimension + 1.
+  double2 Get2D(std::size_t pixel, std::size_t sample,
+                std::size_t dimension) const {
+    return double2{Get(pixel, sample, dimension),
+                   Get(pixel, sample, dimension + 1)};
+  }
+
+ private:
+  SampleSequence sequence_;
+  std::size_t image_width_;
+  std::uint32_t seed_;
+};
+
+}  // namespace deer
+
+#endif  // DEER_SAMPLER_H_
@@ -6,6 +6,7 @@
 #define DEER_SCENE_H_
 
 #include <algorithm>
+#include <cmath>
 #include <memory>
 #include <optional>
 #include <vector>
@@ -17,6 +18,8 @@
 
 namespace deer {
 
+class GeometryObject;
+
 class SceneObject {
  public:
   // Transforms from object coords to scene coords.
@@ -29,6 +32,9 @@ class SceneObject {
   virtual std::optional<RayIntersection> IntersectWithRay(
       const Ray &) const = 0;
 
+  // Lets CompiledScene flatten plain geometry objects without RTTI.
+  virtual const GeometryObject *AsGeometryObject() const { return nullptr; }
+
  protected:
   explicit SceneObject(const AffineTransform &t = {})
       : transform(t) {}
@@ -58,6 +64,11 @@ class GeometryObject : public SceneObject {
     return result;
   }
 
+  const GeometryObject *AsGeometryObject() const override { return this; }
+
+  const std::shared_ptr<Geometry> &geometry() const { return geometry_; }
+  const std::shared_ptr<Material> &material() const { return material_; }
+
  protected:
   std::shared_ptr<Geometry> geometry_;
   std::shared_ptr<Material> material_;
@@ -76,6 +87,16 @@ class Camera {
   double focal_length() const { return transform.matrix()[2].length(); }
   double4 line_of_sight() const { return transform.matrix()[2]; }
 
+  // Through a point of an image, given in pixels from its top left corner.
+  Ray RayThroughPixel(double row, double col,
+                      double image_width, double image_height) const {
+    const double  screen_x =    col / (image_width  / 2) - 1;
+    const double  screen_y = - (row / (image_height / 2) - 1);
+    const double4 camera_space_direction = double4{screen_x, screen_y, 1, 0};
+    const double4 direction = transform.Apply(camera_space_direction);
+    return Ray{position(), direction};
+  }
+
   AffineTransform transform;
 };
 
@@ -83,10 +104,30 @@ class PointLightSource {
  public:
   double4 position;
   Spectrum spectrum;
+  // The radius of the light, which casts soft shadows if it is not zero.
   double softness;
 
   PointLightSource(double4 p, Spectrum spec, double soft = 0)
       : position(p), spectrum(spec), softness(soft) {}
+
+  // A point of the disc of radius softness around the position that faces
+  // the given point, uniformly distributed for u uniform in [0, 1)^2.
+  double4 SamplePoint(const double4 &from, const double2 &u) const {
+    if (softness <= 0) return position;
+    const double4 axis = (position - from) / length(position - from);
+    // Duff et al.'s branchless orthonormal basis.
+    const double sign = std::copysign(1.0, axis[2]);
+    const double a = -1 / (sign + axis[2]);
+    const double b = axis[0] * axis[1] * a;
+    const double4 tangent{1 + sign * axis[0] * axis[0] * a, sign * b,
+                          -sign * axis[0], 0};
+    const double4 bitangent{b, sign + axis[1] * axis[1] * a, -axis[1], 0};
+
+    const double r = softness * std::sqrt(u[0]);
+    const double phi = 2 * std::acos(-1) * u[1];
+    return position + r * std::cos(phi) * tangent +
+           r * std::sin(phi) * bitangent;
+  }
 };
 
 class Scene {
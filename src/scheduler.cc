@@ -0,0 +1,187 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace deer {
+
+namespace {
+
+// Interleaves the bits of x and y.
+std::uint64_t MortonCode(std::uint32_t x, std::uint32_t y) {
+  auto spread = [](std::uint64_t v) {
+    v = (v | (v << 16)) & 0x0000FFFF0000FFFFull;
+    v = (v | (v << 8)) & 0x00FF00FF00FF00FFull;
+    v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0Full;
+    v = (v | (v << 2)) & 0x3333333333333333ull;
+    v = (v | (v << 1)) & 0x5555555555555555ull;
+    return v;
+  };
+  return spread(x) | (spread(y) << 1);
+}
+
+}  // namespace
+
+std::vector<Tile> MakeTiles(std::size_t image_width, std::size_t image_height,
+                            std::size_t tile_size, TileOrder order) {
+  tile_size = ClampTileSize(tile_size);
+  const std::size_t n_cols = (image_width + tile_size - 1) / tile_size;
+  const std::size_t n_rows = (image_height + tile_size - 1) / tile_size;
+
+  std::vector<Tile> tiles;
+  tiles.reserve(n_cols * n_rows);
+  for (std::size_t ty = 0; ty < n_rows; ty++) {
+    for (std::size_t tx = 0; tx < n_cols; tx++) {
+      const std::size_t row = ty * tile_size, col = tx * tile_size;
+      tiles.push_back(Tile{row, col,
+                           std::min(tile_size, image_height - row),
+                           std::min(tile_size, image_width - col)});
+    }
+  }
+
+  switch (order) {
+    case TileOrder::kScanline:
+      break;
+
+    case TileOrder::kMorton:
+      std::stable_sort(tiles.begin(), tiles.end(),
+          [&](const Tile &a, const Tile &b) {
+            return MortonCode(a.col / tile_size, a.row / tile_size) <
+                MortonCode(b.col / tile_size, b.row / tile_size);
+          });
+      break;
+
+    case TileOrder::kSpiral: {
+      // By square ring around the center, then by angle within a ring.
+      const double cx = (n_cols - 1) / 2.0, cy = (n_rows - 1) / 2.0;
+      auto key = [&](const Tile &t) {
+        const double dx = t.col / tile_size - cx;
+        const double dy = t.row / tile_size - cy;
+        const double ring = std::max(std::abs(dx), std::abs(dy));
+        return std::make_pair(std::ceil(ring), std::atan2(dy, dx));
+      };
+      std::stable_sort(tiles.begin(), tiles.end(),
+          [&](const Tile &a, const Tile &b) { return key(a) < key(b); });
+      break;
+    }
+  }
+
+  return tiles;
+}
+
+TileScheduler::TileScheduler(std::size_t n_threads, bool work_stealing)
+    : n_threads_(n_threads)
+    , work_stealing_(work_stealing) {
+  if (n_threads_ == 0) {
+    n_threads_ = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (std::size_t i = 0; i < n_threads_; i++) {
+    queues_.push_back(std::make_unique<WorkQueue>());
+  }
+  for (std::size_t i = 1; i < n_threads_; i++) {
+    workers_.emplace_back(&TileScheduler::Serve, this, i);
+  }
+}
+
+TileScheduler::~TileScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quitting_ = true;
+  }
+  run_started_.notify_all();
+  for (auto &worker : workers_) worker.join();
+}
+
+void TileScheduler::Serve(std::size_t thread) {
+  std::size_t n_runs_served = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    run_started_.wait(lock, [&] {
+      return quitting_ || n_runs_ != n_runs_served;
+    });
+    if (quitting_) return;
+    n_runs_served = n_runs_;
+    const auto &work = *work_;
+    lock.unlock();
+    work(thread);
+    lock.lock();
+    if (--n_busy_workers_ == 0) run_finished_.notify_one();
+  }
+}
+
+bool TileScheduler::Pop(std::size_t thread, std::size_t *tile) {
+  WorkQueue &queue = *queues_[thread];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.tiles.empty()) return false;
+  *tile = queue.tiles.front();
+  queue.tiles.pop_front();
+  return true;
+}
+
+bool TileScheduler::Steal(std::size_t thief, std::size_t *tile) {
+  for (std::size_t i = 1; i < n_threads_; i++) {
+    WorkQueue &queue = *queues_[(thief + i) % n_threads_];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tiles.empty()) continue;
+    *tile = queue.tiles.back();
+    queue.tiles.pop_back();
+    tiles_stolen_++;
+    return true;
+  }
+  return false;
+}
+
+void TileScheduler::Run(
+    const std::vector<Tile> &tiles,
+    const std::function<void(const Tile &, std::size_t)> &process) {
+  tiles_stolen_ = 0;
+  stopped_ = false;
+
+  // Contiguous runs keep the locality of the tile order within a thread.
+  for (std::size_t i = 0; i < n_threads_; i++) {
+    const std::size_t first = tiles.size() * i / n_threads_;
+    const std::size_t last = tiles.size() * (i + 1) / n_threads_;
+    queues_[i]->tiles.clear();
+    for (std::size_t j = first; j < last; j++) queues_[i]->tiles.push_back(j);
+  }
+
+  // Tiles are never added while running, so a thread that finds nothing
+  // to pop or steal is done with the run.
+  const std::function<void(std::size_t)> work = [&](std::size_t thread) {
+    std::size_t tile;
+    while (!stopped_ &&
+           (Pop(thread, &tile) || (work_stealing_ && Steal(thread, &tile)))) {
+      process(tiles[tile], thread);
+    }
+  };
+
+  if (!workers_.empty()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      work_ = &work;
+      n_busy_workers_ = workers_.size();
+      n_runs_++;
+    }
+    run_started_.notify_all();
+  }
+  work(0);
+  if (!workers_.empty()) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    run_finished_.wait(lock, [&] { return n_busy_workers_ == 0; });
+    work_ = nullptr;
+  }
+}
+
+}  // namespace deer
@@ -0,0 +1,101 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#ifndef DEER_SCHEDULER_H_
+#define DEER_SCHEDULER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace deer {
+
+struct Tile {
+  std::size_t row, col;  // of the top left pixel
+  std::size_t height, width;
+};
+
+enum struct TileOrder {
+  kScanline,
+  kMorton,  // Z-order curve over the tile grid
+  kSpiral,  // from the image center outwards
+};
+
+// A tile size of zero means tiles of single pixels; everything that
+// sizes a per-tile buffer goes by this.
+inline std::size_t ClampTileSize(std::size_t tile_size) {
+  return std::max<std::size_t>(tile_size, 1);
+}
+
+// Splits an image into tiles of at most tile_size x tile_size pixels,
+// after ClampTileSize, listed in the given order.
+std::vector<Tile> MakeTiles(std::size_t image_width, std::size_t image_height,
+                            std::size_t tile_size, TileOrder order);
+
+// Runs a function over a list of tiles on several threads. The list is
+// split into contiguous runs, one per thread; a thread that finishes its
+// own run steals single tiles from the far end of the others'. The
+// threads other than the caller's are started with the scheduler and
+// wait for the next Run in between, so that a job of many short passes
+// does not pay for starting threads on each.
+class TileScheduler {
+ public:
+  // Zero threads means one per hardware thread.
+  explicit TileScheduler(std::size_t n_threads = 0,
+                         bool work_stealing = true);
+  ~TileScheduler();
+
+  std::size_t n_threads() const { return n_threads_; }
+
+  // Calls process(tile, thread_index) for every tile and returns once all
+  // are done. The calling thread takes part as thread 0.
+  void Run(const std::vector<Tile> &tiles,
+           const std::function<void(const Tile &, std::size_t)> &process);
+
+  // Makes the current Run return as soon as the tiles being processed are
+  // done, skipping the rest. Meant to be called from process().
+  void Stop() { stopped_ = true; }
+  // Whether the last Run was stopped.
+  bool stopped() const { return stopped_; }
+
+  // Over the last Run.
+  std::size_t tiles_stolen() const { return tiles_stolen_; }
+
+ private:
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<std::size_t> tiles;
+  };
+
+  std::size_t n_threads_;
+  bool work_stealing_;
+  std::vector<std::unique_ptr<WorkQueue>> queues_;
+  std::atomic<std::size_t> tiles_stolen_{0};
+  std::atomic<bool> stopped_{false};
+
+  // Threads 1 and up; the rest is guarded by mutex_.
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable run_started_, run_finished_;
+  // Of the current Run, which every worker calls with its thread index.
+  const std::function<void(std::size_t)> *work_ = nullptr;
+  std::size_t n_runs_ = 0;
+  std::size_t n_busy_workers_ = 0;
+  bool quitting_ = false;
+
+  bool Pop(std::size_t thread, std::size_t *tile);
+  bool Steal(std::size_t thief, std::size_t *tile);
+  void Serve(std::size_t thread);
+};
+
+}  // namespace deer
+
+#endif  // DEER_SCHEDULER_H_
@@ -0,0 +1,173 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "spectral_sampling.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "rgb.h"
+#include "sampler.h"
+#include "spectrum.h"
+#include "vector.h"
+
+namespace deer {
+
+namespace {
+
+// splitmix64 finalizer
+std::uint64_t Hash(std::uint64_t x) {
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+double UniformDouble(std::uint64_t seed, std::uint64_t index) {
+  return (Hash(seed ^ Hash(index)) >> 11) * 0x1.0p-53;
+}
+
+}  // namespace
+
+SpectralSampler::SpectralSampler(const RgbColorProfile &profile,
+                                 SpectralSampling mode,
+                                 int samples,
+                                 int wavelengths_per_sample,
+                                 int dense_bins)
+    : profile_(profile)
+    , mode_(mode)
+    , samples_(std::max(samples, 1))
+    , wavelengths_per_sample_(std::max(wavelengths_per_sample, 1))
+    , dense_bins_(std::max(dense_bins, 1)) {
+  const double3 widths = profile.band_widths();
+  band_min_ = profile.wavelengths - widths / 2.0;
+  band_max_ = profile.wavelengths + widths / 2.0;
+  min_wavelength_ = *std::min_element(band_min_.begin(), band_min_.end());
+  max_wavelength_ = *std::max_element(band_max_.begin(), band_max_.end());
+}
+
+int SpectralSampler::cost() const {
+  switch (mode_) {
+    case SpectralSampling::kRgb: return 3;
+    case SpectralSampling::kHeroWavelength:
+      return samples_ * wavelengths_per_sample_;
+    case SpectralSampling::kDense: return dense_bins_;
+  }
+  return 0;
+}
+
+void SpectralSampler::Accumulate(double wavelength, double value,
+                                 double3 &sums, double3 &counts) const {
+  for (std::size_t i = 0; i < 3; i++) {
+    if (wavelength >= band_min_[i] && wavelength < band_max_[i]) {
+      sums[i] += value;
+      counts[i] += 1;
+      return;
+    }
+  }
+}
+
+double3 SpectralSampler::Integrate(const Spectrum &spectrum,
+                                   std::uint64_t seed) const {
+  return IntegrateJittered(spectrum,
+                           [&](int s) { return UniformDouble(seed, s); });
+}
+
+double3 SpectralSampler::Integrate(const Spectrum &spectrum,
+                                   const Sampler &sampler,
+                                   std::size_t pixel, std::size_t sample,
+                                   std::size_t dimension) const {
+  return IntegrateJittered(spectrum, [&](int s) {
+    return sampler.Get(pixel, sample * samples_ + s, dimension);
+  });
+}
+
+void SpectralSampler::Wavelengths(const Sampler &sampler,
+                                  std::size_t pixel, std::size_t sample,
+                                  std::size_t dimension,
+                                  double *wavelengths) const {
+  PickWavelengths([&](int s) {
+    return sampler.Get(pixel, sample * samples_ + s, dimension);
+  }, wavelengths);
+}
+
+double3 SpectralSampler::Resolve(const double *wavelengths,
+                                 const double *values) const {
+  if (mode_ == SpectralSampling::kRgb) {
+    return double3{values[0], values[1], values[2]};
+  }
+
+  double3 sums = double3::zero();
+  double3 counts = double3::zero();
+  const int n_wavelengths = cost();
+  for (int i = 0; i < n_wavelengths; i++) {
+    Accumulate(wavelengths[i], values[i], sums, counts);
+  }
+
+  double3 result;
+  if (mode_ == SpectralSampling::kDense) {
+    // Evenly spaced bins: the midpoint rule over each band.
+    for (std::size_t i = 0; i < 3; i++) {
+      result[i] = counts[i] > 0 ? sums[i] / counts[i] : 0;
+    }
+    return result;
+  }
+  // Hero wavelengths are uniform over the whole range, so a band gets
+  // width / range of them on average, and none at all when it is narrow
+  // and unlucky; averaging over those it got would darken it.
+  const double range = max_wavelength_ - min_wavelength_;
+  for (std::size_t i = 0; i < 3; i++) {
+    result[i] = sums[i] * range /
+                (n_wavelengths * (band_max_[i] - band_min_[i]));
+  }
+  return result;
+}
+
+template<class Jitter>
+void SpectralSampler::PickWavelengths(Jitter jitter,
+                                      double *wavelengths) const {
+  if (mode_ == SpectralSampling::kRgb) {
+    std::copy(profile_.wavelengths.begin(), profile_.wavelengths.end(),
+              wavelengths);
+    return;
+  }
+
+  const double range = max_wavelength_ - min_wavelength_;
+  if (mode_ == SpectralSampling::kDense) {
+    for (int i = 0; i < dense_bins_; i++) {
+      wavelengths[i] = min_wavelength_ + range * (i + 0.5) / dense_bins_;
+    }
+    return;
+  }
+
+  // Sample s owns the stratum [s, s+1) / (samples * companions) of the
+  // first 1/companions of the range; companion j shifts it by j/companions.
+  const int n_strata = samples_ * wavelengths_per_sample_;
+  for (int s = 0; s < samples_; s++) {
+    const double u = (s + jitter(s)) / n_strata;
+    for (int j = 0; j < wavelengths_per_sample_; j++) {
+      *wavelengths++ = min_wavelength_ +
+          range * (u + double(j) / wavelengths_per_sample_);
+    }
+  }
+}
+
+template<class Jitter>
+double3 SpectralSampler::IntegrateJittered(const Spectrum &spectrum,
+                                           Jitter jitter) const {
+  if (mode_ == SpectralSampling::kRgb) {
+    return spectrum(profile_.wavelengths);
+  }
+
+  std::vector<double> wavelengths(cost()), values(cost());
+  PickWavelengths(jitter, wavelengths.data());
+  for (std::size_t i = 0; i < wavelengths.size(); i++) {
+    values[i] = spectrum(wavelengths[i]);
+  }
+  return Resolve(wavelengths.data(), values.data());
+}
+
+}  // namespace deer
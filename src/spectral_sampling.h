@@ -0,0 +1,82 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#ifndef DEER_SPECTRAL_SAMPLING_H_
+#define DEER_SPECTRAL_SAMPLING_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "rgb.h"
+#include "sampler.h"
+#include "spectrum.h"
+#include "vector.h"
+
+namespace deer {
+
+enum struct SpectralSampling {
+  // Point-samples each spectrum at the three profile wavelengths.
+  kRgb,
+  // Each sample takes one random hero wavelength plus evenly spaced
+  // companions, so all samples together stratify the whole spectrum.
+  kHeroWavelength,
+  // Evaluates every one of a fixed number of bins; the reference.
+  kDense,
+};
+
+// Turns a spectrum into per-channel intensities, averaging it over the
+// band of each RgbColorProfile channel (see RgbColorProfile::band_widths).
+class SpectralSampler {
+ public:
+  SpectralSampler(const RgbColorProfile &profile,
+                  SpectralSampling mode,
+                  int samples = 1,
+                  int wavelengths_per_sample = 4,
+                  int dense_bins = 256);
+
+  SpectralSampling mode() const { return mode_; }
+
+  // Wavelengths evaluated per call.
+  int cost() const;
+
+  // The seed decorrelates hero wavelengths between pixels.
+  double3 Integrate(const Spectrum &, std::uint64_t seed) const;
+  // Takes the hero wavelength of the n-th of `samples` for a pixel sample
+  // from sampler.Get(pixel, sample * samples + n, dimension).
+  double3 Integrate(const Spectrum &, const Sampler &sampler,
+                    std::size_t pixel, std::size_t sample,
+                    std::size_t dimension) const;
+
+  // Integrate in two steps, for a renderer that adds up the values of
+  // spectra at a few wavelengths rather than the spectra themselves:
+  // the cost() wavelengths Integrate would evaluate a spectrum at, and
+  // the intensities it would give from the spectrum's values there.
+  void Wavelengths(const Sampler &sampler, std::size_t pixel,
+                   std::size_t sample, std::size_t dimension,
+                   double *wavelengths) const;
+  double3 Resolve(const double *wavelengths, const double *values) const;
+
+ private:
+  RgbColorProfile profile_;
+  SpectralSampling mode_;
+  int samples_;
+  int wavelengths_per_sample_;
+  int dense_bins_;
+
+  double3 band_min_, band_max_;
+  double min_wavelength_, max_wavelength_;
+
+  void Accumulate(double wavelength, double value,
+                  double3 &sums, double3 &counts) const;
+  // jitter(n) gives the position of the n-th hero wavelength within its
+  // stratum, in [0, 1).
+  template<class Jitter>
+  void PickWavelengths(Jitter jitter, double *wavelengths) const;
+  template<class Jitter>
+  double3 IntegrateJittered(const Spectrum &, Jitter jitter) const;
+};
+
+}  // namespace deer
+
+#endif  // DEER_SPECTRAL_SAMPLING_H_
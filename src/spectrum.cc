@@ -6,6 +6,8 @@
 
 #include <functional>
 #include <memory>
+#include <optional>
+#include <type_traits>
 
 namespace deer {
 
@@ -14,6 +16,7 @@ namespace {
 struct ConstantSpectrum : public Spectrum {
   double value = 0;
   double intensity(double wavelength) const override { return value; }
+  std::optional<double> constant_value() const override { return value; }
 };
 
 struct MonochromeSpectrum : public Spectrum {
@@ -27,6 +30,10 @@ struct MonochromeSpectrum : public Spectrum {
       return 0;
     }
   }
+  std::optional<double> constant_value() const override {
+    if (peak_height == 0 || peak_width <= 0) return 0;
+    return {};
+  }
 };
 
 template<class Op>
@@ -35,6 +42,15 @@ struct BinaryOperatorSpectrum : public Spectrum {
   double intensity(double wavelength) const override {
     return Op()(left(wavelength), right(wavelength));
   }
+  std::optional<double> constant_value() const override {
+    auto l = left.constant_value(), r = right.constant_value();
+    if (l && r) return Op()(*l, *r);
+    if (std::is_same_v<Op, std::multiplies<double>> &&
+        ((l && *l == 0) || (r && *r == 0))) {
+      return 0;
+    }
+    return {};
+  }
 };
 
 struct MultipliedSpectrum : public Spectrum {
@@ -43,6 +59,12 @@ struct MultipliedSpectrum : public Spectrum {
   double intensity(double wavelength) const override {
     return spectrum(wavelength) * times;
   }
+  std::optional<double> constant_value() const override {
+    if (times == 0) return 0;
+    auto value = spectrum.constant_value();
+    if (value) return *value * times;
+    return {};
+  }
 };
 
 }  // namespace
@@ -7,6 +7,7 @@
 
 #include <cmath>
 #include <memory>
+#include <optional>
 
 #include "vector.h"
 
@@ -20,6 +21,12 @@ class Spectrum {
   double operator()(double wavelength) const {
     return intensity(wavelength);
   }
+  // The intensity at every wavelength, if it is known to be the same.
+  virtual std::optional<double> constant_value() const {
+    if (!pimpl_) return {};
+    return pimpl_->constant_value();
+  }
+
   double3 operator()(double3 wavelengths) const {
     return double3{
       intensity(wavelengths.r()),
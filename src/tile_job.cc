@@ -0,0 +1,127 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "tile_job.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "color_conversion.h"
+#include "framebuffer.h"
+#include "renderer.h"
+#include "scheduler.h"
+
+namespace deer {
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+std::function<std::vector<std::uint8_t>()> ConvertingSnapshot(
+    std::shared_ptr<SharedFramebuffer> framebuffer,
+    const ColorConverter &converter, PixelLayout layout,
+    std::function<Framebuffer(Framebuffer)> prepare) {
+  return [framebuffer = std::move(framebuffer), converter, layout,
+          prepare = std::move(prepare)] {
+    if (prepare) {
+      return converter.Convert(prepare(framebuffer->Snapshot()), layout);
+    }
+    return converter.Convert(framebuffer->Snapshot(), layout);
+  };
+}
+
+TileJob::TileJob(std::shared_ptr<Renderer::JobStatus> job_status,
+                 std::size_t n_threads, bool work_stealing,
+                 double time_limit)
+    : job_status_(std::move(job_status))
+    , scheduler_(n_threads, work_stealing)
+    , tracing_start_(std::chrono::steady_clock::now())
+    , has_deadline_(time_limit > 0)
+    , deadline_(tracing_start_ +
+          std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+              std::chrono::duration<double>(time_limit)))
+    , finished_tiles_(scheduler_.n_threads()) {}
+
+bool TileJob::ShouldStop() {
+  Renderer::Outcome reason = Renderer::Outcome::kCompleted;
+  if (job_status_->cancel_requested) {
+    reason = Renderer::Outcome::kCancelled;
+  } else if (has_deadline_ &&
+             std::chrono::steady_clock::now() >= deadline_) {
+    reason = Renderer::Outcome::kTimedOut;
+  }
+  if (reason == Renderer::Outcome::kCompleted) return false;
+
+  Renderer::Outcome none = Renderer::Outcome::kCompleted;
+  stop_reason_.compare_exchange_strong(none, reason);
+  return true;
+}
+
+bool TileJob::RunPass(
+    const std::vector<Tile> &tiles,
+    const std::function<void(const Tile &, std::size_t)> &process) {
+  for (auto &finished : finished_tiles_) finished.clear();
+  const bool done = RunTiles(tiles, [&](const Tile &tile,
+                                        std::size_t thread) {
+    process(tile, thread);
+    finished_tiles_[thread].push_back(tile);
+  });
+
+  Renderer::Statistics &statistics = job_status_->statistics;
+  statistics.tiles_stolen += scheduler_.tiles_stolen();
+  if (!done) {
+    for (const auto &finished : finished_tiles_) {
+      statistics.finished_tiles.insert(statistics.finished_tiles.end(),
+                                       finished.begin(), finished.end());
+    }
+    return false;
+  }
+  job_status_->passes_done++;
+  return true;
+}
+
+bool TileJob::RunTiles(
+    const std::vector<Tile> &tiles,
+    const std::function<void(const Tile &, std::size_t)> &process) {
+  scheduler_.Run(tiles, [&](const Tile &tile, std::size_t thread) {
+    if (ShouldStop()) {
+      scheduler_.Stop();
+      return;
+    }
+    process(tile, thread);
+  });
+  if (scheduler_.stopped()) {
+    job_status_->outcome = stop_reason_;
+    return false;
+  }
+  return true;
+}
+
+void TileJob::EndTracing() {
+  job_status_->outcome = stop_reason_;
+  job_status_->statistics.tracing_seconds = SecondsSince(tracing_start_);
+}
+
+std::vector<std::uint8_t> TileJob::Finish(Framebuffer image,
+                                          const ColorConverter &converter,
+                                          PixelLayout layout) {
+  auto conversion_start = std::chrono::steady_clock::now();
+  job_status_->image = std::move(image);
+  auto result = converter.Convert(job_status_->image, layout);
+  job_status_->statistics.conversion_seconds =
+      SecondsSince(conversion_start);
+
+  if (job_status_->outcome == Renderer::Outcome::kCompleted) {
+    job_status_->amount_done = 1.0;
+  }
+  return result;
+}
+
+}  // namespace deer
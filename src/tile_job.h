@@ -0,0 +1,83 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#ifndef DEER_TILE_JOB_H_
+#define DEER_TILE_JOB_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "color_conversion.h"
+#include "framebuffer.h"
+#include "renderer.h"
+#include "scheduler.h"
+
+namespace deer {
+
+double SecondsSince(std::chrono::steady_clock::time_point start);
+
+// A JobStatus::snapshot that converts what the framebuffer holds, passed
+// through `prepare` first if that is set.
+std::function<std::vector<std::uint8_t>()> ConvertingSnapshot(
+    std::shared_ptr<SharedFramebuffer> framebuffer,
+    const ColorConverter &converter, PixelLayout layout,
+    std::function<Framebuffer(Framebuffer)> prepare = nullptr);
+
+// What the renderers that run passes over tiles of an image have in
+// common: stopping on cancellation or at the deadline, with the outcome
+// that made the job stop first and the tiles its last pass finished;
+// counting passes and timing the tracing; and converting the image.
+class TileJob {
+ public:
+  // The clock of the time limit (zero for none) starts here.
+  TileJob(std::shared_ptr<Renderer::JobStatus> job_status,
+          std::size_t n_threads, bool work_stealing, double time_limit);
+
+  std::size_t n_threads() const { return scheduler_.n_threads(); }
+
+  // Whether the job was cancelled or has run out of time. Safe to call
+  // from any thread; the first reason found is the outcome that RunPass
+  // and EndTracing report.
+  bool ShouldStop();
+
+  // Calls process(tile, thread) for every tile, unless ShouldStop() first.
+  // Returns false if the pass stopped, with the outcome and the tiles that
+  // were finished in JobStatus; otherwise counts it as done.
+  bool RunPass(const std::vector<Tile> &tiles,
+               const std::function<void(const Tile &, std::size_t)> &process);
+
+  // Like RunPass, for a run over the tiles that is no pass of its own:
+  // it is not counted, and leaves no finished tiles.
+  bool RunTiles(const std::vector<Tile> &tiles,
+                const std::function<void(const Tile &, std::size_t)> &process);
+
+  // Takes the tracing time and reports why the job stopped, if it did;
+  // called once, after the last pass, on the thread that runs the job.
+  void EndTracing();
+
+  // Keeps the final linear image in JobStatus, converts it, and takes
+  // the time that took. A job that was not stopped is then all done.
+  std::vector<std::uint8_t> Finish(Framebuffer image,
+                                   const ColorConverter &converter,
+                                   PixelLayout layout);
+
+ private:
+  std::shared_ptr<Renderer::JobStatus> job_status_;
+  TileScheduler scheduler_;
+  std::chrono::steady_clock::time_point tracing_start_;
+  bool has_deadline_;
+  std::chrono::steady_clock::time_point deadline_;
+  std::atomic<Renderer::Outcome> stop_reason_{Renderer::Outcome::kCompleted};
+  // By thread, of the current pass.
+  std::vector<std::vector<Tile>> finished_tiles_;
+};
+
+}  // namespace deer
+
+#endif  // DEER_TILE_JOB_H_
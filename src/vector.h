@@ -234,7 +234,15 @@ struct Vector {
     return result;
   }
 
-  // TODO(iliazeus): refraction
+  // Snell's law for a unit vector going through a surface with a unit
+  // normal that faces it; eta is the ratio of the refractive indices, from
+  // over to. Zero on total internal reflection.
+  Vector refract_through(const Vector &normal, scalar_type eta) const {
+    const scalar_type cos_in = -dot(normal, *this);
+    const scalar_type cos2_out = 1 - eta * eta * (1 - cos_in * cos_in);
+    if (cos2_out < 0) return zero();
+    return eta * *this + (eta * cos_in - std::sqrt(cos2_out)) * normal;
+  }
 
   static Vector zero() {
     Vector result;
@@ -0,0 +1,138 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "../src/color_conversion.h"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../src/framebuffer.h"
+#include "../src/rgb.h"
+#include "../src/vector.h"
+
+namespace deer {
+
+namespace test {
+
+class ColorConverterTest : public ::testing::Test {
+ public:
+  void SetUp() {
+    profile_.wavelengths = double3{2, 1, 0};
+    profile_.min_intensities = double3{0, 0, 0};
+    profile_.max_intensities = double3{1, 1, 1};
+
+    // Odd width, so that both the vector and the scalar paths are taken.
+    framebuffer_ = Framebuffer(7, 3);
+    for (std::size_t row = 0; row < framebuffer_.height(); row++) {
+      for (std::size_t col = 0; col < framebuffer_.width(); col++) {
+        double x = 0.1 * (row * framebuffer_.width() + col) - 0.3;
+        framebuffer_.Set(row, col, double3{x, 1 - x, x * x});
+      }
+    }
+  }
+
+ protected:
+  RgbColorProfile profile_;
+  Framebuffer framebuffer_;
+};
+
+TEST_F(ColorConverterTest, MatchesToRgbBytes) {
+  ColorConverter converter(profile_);
+  auto rgb = converter.Convert(framebuffer_, PixelLayout::kRgb);
+  auto bgra = converter.Convert(framebuffer_, PixelLayout::kBgra);
+  ASSERT_EQ(rgb.size(), framebuffer_.width() * framebuffer_.height() * 3);
+  ASSERT_EQ(bgra.size(), framebuffer_.width() * framebuffer_.height() * 4);
+
+  for (std::size_t row = 0; row < framebuffer_.height(); row++) {
+    for (std::size_t col = 0; col < framebuffer_.width(); col++) {
+      const std::size_t i = row * framebuffer_.width() + col;
+      const auto pixel = framebuffer_.Get(row, col);
+      const auto expected = profile_.ToRgbBytes(profile_.ToRgb(pixel));
+      EXPECT_EQ((byte3{rgb[3*i], rgb[3*i + 1], rgb[3*i + 2]}), expected);
+      EXPECT_EQ((byte3{bgra[4*i + 2], bgra[4*i + 1], bgra[4*i]}), expected);
+      EXPECT_EQ(bgra[4*i + 3], 0xFF);
+    }
+  }
+}
+
+TEST_F(ColorConverterTest, AppliesGamma) {
+  Framebuffer framebuffer(5, 1);
+  framebuffer.Set(0, 0, double3{0, 0, 0});
+  framebuffer.Set(0, 1, double3{0.25, 0.25, 0.25});
+  framebuffer.Set(0, 2, double3{0.5, 0.5, 0.5});
+  framebuffer.Set(0, 3, double3{1, 1, 1});
+  framebuffer.Set(0, 4, double3{2, 2, 2});
+
+  ColorConverter converter(profile_, 2.2);
+  auto bytes = converter.Convert(framebuffer, PixelLayout::kRgb);
+  EXPECT_EQ(bytes[0], 0);
+  EXPECT_NEAR(bytes[3], 255 * std::pow(0.25, 1 / 2.2), 1);
+  EXPECT_NEAR(bytes[6], 255 * std::pow(0.5, 1 / 2.2), 1);
+  EXPECT_EQ(bytes[9], 255);
+  EXPECT_EQ(bytes[12], 255);
+}
+
+TEST_F(ColorConverterTest, AppliesExposure) {
+  ColorConverter converter(profile_);
+  ColorConverter doubled(profile_, 1, ToneMapping::kLinear, 2);
+  EXPECT_EQ(ColorConverter(profile_, 1, ToneMapping::kLinear, 1)
+                .Convert(framebuffer_, PixelLayout::kRgb),
+            converter.Convert(framebuffer_, PixelLayout::kRgb));
+
+  Framebuffer halved(framebuffer_.width(), framebuffer_.height());
+  for (std::size_t row = 0; row < framebuffer_.height(); row++) {
+    for (std::size_t col = 0; col < framebuffer_.width(); col++) {
+      halved.Set(row, col, framebuffer_.Get(row, col) * 0.5);
+    }
+  }
+  auto expected = converter.Convert(framebuffer_, PixelLayout::kRgb);
+  auto bytes = doubled.Convert(halved, PixelLayout::kRgb);
+  ASSERT_EQ(bytes.size(), expected.size());
+  for (std::size_t i = 0; i < bytes.size(); i++) {
+    EXPECT_NEAR(bytes[i], expected[i], 1);
+  }
+}
+
+TEST_F(ColorConverterTest, MapsTones) {
+  Framebuffer framebuffer(5, 1);
+  const float intensities[] = {0, 0.25, 1, 4, 100};
+  for (std::size_t col = 0; col < 5; col++) {
+    const double x = intensities[col];
+    framebuffer.Set(0, col, double3{x, x, x});
+  }
+
+  auto reinhard = ColorConverter(profile_, 1, ToneMapping::kReinhard)
+      .Convert(framebuffer, PixelLayout::kRgb);
+  for (std::size_t col = 0; col < 5; col++) {
+    const double x = intensities[col];
+    EXPECT_NEAR(reinhard[col * 3], 255 * x / (1 + x), 1);
+  }
+  EXPECT_LT(reinhard[12], 255);
+
+  auto aces = ColorConverter(profile_, 1, ToneMapping::kAces)
+      .Convert(framebuffer, PixelLayout::kRgb);
+  EXPECT_EQ(aces[0], 0);
+  for (std::size_t col = 1; col < 5; col++) {
+    EXPECT_GT(aces[col * 3], aces[col * 3 - 3]);
+  }
+  EXPECT_EQ(aces[12], 255);
+
+  // Even at four pixels at a time.
+  Framebuffer wide(9, 1);
+  for (std::size_t col = 0; col < 9; col++) {
+    wide.Set(0, col, framebuffer.Get(0, col % 5));
+  }
+  auto wide_aces = ColorConverter(profile_, 1, ToneMapping::kAces)
+      .Convert(wide, PixelLayout::kRgb);
+  for (std::size_t col = 0; col < 9; col++) {
+    EXPECT_EQ(wide_aces[col * 3], aces[(col % 5) * 3]);
+  }
+}
+
+}  // namespace test
+
+}  // namespace deer
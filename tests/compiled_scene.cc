@@ -0,0 +1,256 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "../src/compiled_scene.h"
+
+#include <array>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../src/geometry.h"
+#include "../src/optics.h"
+#include "../src/scene.h"
+#include "../src/spectrum.h"
+#include "../src/transform.h"
+
+namespace deer {
+
+namespace test {
+
+// Behaves like a unit sphere, but is not known to the compiled scene.
+struct CustomSphereGeometry : public Geometry {
+  std::optional<RayIntersection> IntersectWithRay(
+      const Ray &ray) const override {
+    return UnitSphereGeometry().Intersect(ray);
+  }
+};
+
+// Moves a built-in sphere that it wraps, which the compiled scene must
+// not bypass.
+struct ShiftedSphereGeometry : public Geometry {
+  std::optional<RayIntersection> IntersectWithRay(
+      const Ray &ray) const override {
+    const Ray shifted{ray.origin - double4{0, 1, 0, 0}, ray.direction};
+    auto isec = sphere.Intersect(shifted);
+    if (isec) isec->point = isec->point + double4{0, 1, 0, 0};
+    return isec;
+  }
+
+  UnitSphereGeometry sphere;
+};
+
+// Adds to a built-in sphere what does not change how it is intersected.
+struct NamedSphereGeometry : public UnitSphereGeometry {
+  const char *name = "ball";
+};
+
+class CompiledSceneTest : public ::testing::Test {
+ public:
+  void SetUp() {
+    auto triangles = std::make_shared<TrianglesGeometry>(
+        std::vector<std::array<double4, 3>>{
+          {double4{-1, -1, 0, 1}, double4{1, -1, 0, 1}, double4{0, 1, 0, 1}},
+        });
+
+    scene_.Add(std::make_shared<GeometryObject>(
+        std::make_shared<UnitSphereGeometry>(), sphere_material_,
+        AffineTransform().Translate(-2, 0, 0)));
+    scene_.Add(std::make_shared<GeometryObject>(
+        std::make_shared<CustomSphereGeometry>(), custom_material_,
+        AffineTransform().Translate(2, 0, 0)));
+    scene_.Add(std::make_shared<GeometryObject>(
+        triangles, triangles_material_,
+        AffineTransform().Translate(0, 0, -1)));
+    scene_.Add(std::make_shared<GeometryObject>(
+        std::make_shared<XYPlaneGeometry>(), plane_material_,
+        AffineTransform().Translate(0, 0, 5)));
+  }
+
+ protected:
+  Scene scene_;
+  std::shared_ptr<Material> sphere_material_ = std::make_shared<Material>();
+  std::shared_ptr<Material> custom_material_ = std::make_shared<Material>();
+  std::shared_ptr<Material> triangles_material_ =
+      std::make_shared<Material>();
+  std::shared_ptr<Material> plane_material_ = std::make_shared<Material>();
+};
+
+TEST_F(CompiledSceneTest, MatchesSceneTraceRay) {
+  const CompiledScene bucketed(scene_, GeometryDispatch::kBucketed);
+  const CompiledScene virtual_(scene_, GeometryDispatch::kVirtual);
+
+  for (double x = -4; x <= 4; x += 0.25) {
+    for (double y = -2; y <= 2; y += 0.25) {
+      const Ray ray{double4{0, 0, -10, 1}, double4{x, y, 10, 0}};
+      const auto expected = scene_.TraceRay(ray);
+      for (const auto *compiled : {&bucketed, &virtual_}) {
+        const auto hit = compiled->Intersect(ray);
+        ASSERT_EQ(hit.has_value(), expected.has_value());
+        if (!hit) continue;
+        EXPECT_EQ(hit->point, expected->point);
+        EXPECT_EQ(hit->normal, expected->normal);
+        EXPECT_EQ(hit->material, expected->material.get());
+      }
+    }
+  }
+}
+
+TEST_F(CompiledSceneTest, IntersectsWrappersThroughVirtualCall) {
+  Scene scene;
+  scene.Add(std::make_shared<GeometryObject>(
+      std::make_shared<ShiftedSphereGeometry>(), sphere_material_,
+      AffineTransform()));
+  const CompiledScene compiled(scene, GeometryDispatch::kBucketed);
+  const Ray ray{double4{0, 1.5, -10, 1}, double4{0, 0, 1, 0}};
+
+  const auto expected = scene.TraceRay(ray);
+  ASSERT_TRUE(expected.has_value());
+  const auto hit = compiled.Intersect(ray);
+  ASSERT_TRUE(hit.has_value());
+  EXPECT_EQ(hit->point, expected->point);
+  EXPECT_TRUE(compiled.Occluded(ray, 100));
+}
+
+TEST_F(CompiledSceneTest, BucketsSubclassesOfBuiltins) {
+  Scene scene;
+  scene.Add(std::make_shared<GeometryObject>(
+      std::make_shared<NamedSphereGeometry>(), sphere_material_,
+      AffineTransform().Translate(0, 1, 0)));
+  const CompiledScene compiled(scene, GeometryDispatch::kBucketed);
+  const Ray ray{double4{0, 1.5, -10, 1}, double4{0, 0, 1, 0}};
+
+  const auto expected = scene.TraceRay(ray);
+  ASSERT_TRUE(expected.has_value());
+  const auto hit = compiled.Intersect(ray);
+  ASSERT_TRUE(hit.has_value());
+  EXPECT_EQ(hit->point, expected->point);
+}
+
+TEST_F(CompiledSceneTest, FindsOccluders) {
+  const CompiledScene compiled(scene_);
+  const Ray ray{double4{0, 0, -10, 1}, double4{0, 0, 1, 0}};
+
+  EXPECT_TRUE(compiled.Occluded(ray, 100));
+  EXPECT_FALSE(compiled.Occluded(ray, 8.5 * 8.5));
+
+  const auto hit = compiled.Intersect(ray);
+  ASSERT_TRUE(hit.has_value());
+  EXPECT_EQ(hit->object, 2u);
+  EXPECT_EQ(hit->material, triangles_material_.get());
+}
+
+TEST_F(CompiledSceneTest, TriesCachedOccluderFirst) {
+  const CompiledScene compiled(scene_);
+  const Ray ray{double4{0, 0, -10, 1}, double4{0, 0, 1, 0}};
+  const Ray custom_ray{double4{2, 0, -10, 1}, double4{0, 0, 1, 0}};
+
+  CompiledScene::Occluder occluder;
+  EXPECT_TRUE(compiled.Occluded(ray, 100, &occluder));
+  EXPECT_EQ(occluder.object, 2u);
+  EXPECT_TRUE(compiled.Occluded(ray, 100, &occluder));
+  EXPECT_EQ(occluder.object, 2u);
+
+  EXPECT_TRUE(compiled.Occluded(custom_ray, 100, &occluder));
+  EXPECT_EQ(occluder.object, 1u);
+
+  // A miss keeps the occluder for the next ray.
+  EXPECT_FALSE(compiled.Occluded(ray, 8.5 * 8.5, &occluder));
+  EXPECT_EQ(occluder.object, 1u);
+  EXPECT_TRUE(compiled.Occluded(ray, 100, &occluder));
+  EXPECT_EQ(occluder.object, 2u);
+}
+
+TEST_F(CompiledSceneTest, CachesTrianglesOfMeshes) {
+  Scene scene;
+  scene.Add(std::make_shared<GeometryObject>(
+      std::make_shared<TrianglesGeometry>(
+          std::vector<std::array<double4, 3>>{
+            {double4{0, 0, 0, 1}, double4{1, 0, 0, 1}, double4{0, 1, 0, 1}},
+            {double4{0, 0, 0, 1}, double4{-1, 0, 0, 1},
+             double4{0, -1, 0, 1}},
+          }),
+      triangles_material_, AffineTransform()));
+  const CompiledScene compiled(scene);
+  const Ray first_ray{double4{0.2, 0.2, -1, 1}, double4{0, 0, 1, 0}};
+  const Ray second_ray{double4{-0.2, -0.2, -1, 1}, double4{0, 0, 1, 0}};
+
+  CompiledScene::Occluder occluder;
+  EXPECT_TRUE(compiled.Occluded(first_ray, 4, &occluder));
+  EXPECT_EQ(occluder, (CompiledScene::Occluder{0, 0}));
+  EXPECT_TRUE(compiled.OccludedBy(&occluder, first_ray, 4));
+  EXPECT_EQ(occluder, (CompiledScene::Occluder{0, 0}));
+  // The rest of the mesh comes after the cached triangle.
+  EXPECT_TRUE(compiled.OccludedBy(&occluder, second_ray, 4));
+  EXPECT_EQ(occluder, (CompiledScene::Occluder{0, 1}));
+  EXPECT_FALSE(compiled.Occluded(second_ray, 1, &occluder));
+  EXPECT_EQ(occluder, (CompiledScene::Occluder{0, 1}));
+}
+
+TEST_F(CompiledSceneTest, BatchesMatchSingleRays) {
+  const CompiledScene compiled(scene_);
+  RayBatch rays;
+  std::vector<double> max_distance2;
+  for (double x = -4; x <= 4; x += 0.5) {
+    for (double y = -2; y <= 2; y += 0.5) {
+      rays.PushBack(double4{0, 0, -10, 1}, double4{x, y, 10, 0});
+      max_distance2.push_back(x < 0 ? 100 : 8.5 * 8.5);
+    }
+  }
+
+  std::vector<std::optional<CompiledScene::Hit>> hits(rays.size());
+  compiled.Intersect(rays, hits.data());
+  std::vector<CompiledScene::Occluder> occluders(rays.size());
+  // Skipped, as if it had been found already.
+  occluders[0] = CompiledScene::Occluder{3, 0};
+  compiled.FindOccluders(rays, max_distance2.data(), occluders.data());
+
+  for (std::size_t i = 0; i < rays.size(); i++) {
+    const Ray ray{rays.origin(i), rays.direction(i)};
+    const auto expected = compiled.Intersect(ray);
+    ASSERT_EQ(hits[i].has_value(), expected.has_value());
+    if (expected) {
+      EXPECT_EQ(hits[i]->point, expected->point);
+      EXPECT_EQ(hits[i]->object, expected->object);
+    }
+    if (i == 0) {
+      EXPECT_EQ(occluders[i].object, 3u);
+      continue;
+    }
+    CompiledScene::Occluder occluder;
+    compiled.Occluded(ray, max_distance2[i], &occluder);
+    EXPECT_EQ(occluders[i], occluder);
+  }
+}
+
+TEST_F(CompiledSceneTest, ClassifiesMaterials) {
+  sphere_material_->diffusion_spectrum = Spectrum::MakeConstant(1);
+  sphere_material_->specular_spectrum = Spectrum::MakeConstant(0);
+  sphere_material_->shininess = 0.5;
+  triangles_material_->diffusion_spectrum = Spectrum::MakeConstant(1);
+  triangles_material_->specular_spectrum = Spectrum::MakeConstant(1);
+  triangles_material_->shininess = 5;
+  const CompiledScene compiled(scene_);
+
+  const auto sphere_hit = compiled.Intersect(
+      Ray{double4{-2, 0, -10, 1}, double4{0, 0, 1, 0}});
+  ASSERT_TRUE(sphere_hit.has_value());
+  EXPECT_TRUE(sphere_hit->material_features.diffuse);
+  EXPECT_FALSE(sphere_hit->material_features.specular);
+  EXPECT_EQ(sphere_hit->material_features.shininess,
+            MaterialFeatures::kDynamicShininess);
+
+  const auto triangles_hit = compiled.Intersect(
+      Ray{double4{0, 0, -10, 1}, double4{0, 0, 1, 0}});
+  ASSERT_TRUE(triangles_hit.has_value());
+  EXPECT_TRUE(triangles_hit->material_features.diffuse);
+  EXPECT_TRUE(triangles_hit->material_features.specular);
+  EXPECT_EQ(triangles_hit->material_features.shininess, 5);
+}
+
+}  // namespace test
+
+}  // namespace deer
@@ -0,0 +1,122 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "../src/denoiser.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+#include "../src/framebuffer.h"
+#include "../src/vector.h"
+
+namespace deer {
+
+namespace test {
+
+class DenoiserTest : public ::testing::Test {
+ public:
+  void SetUp() {
+    // A wall facing the camera, with the left and right halves at
+    // different depths and the top and bottom in different colours.
+    guides_ = DenoiserGuides(kWidth, kHeight);
+    for (std::size_t row = 0; row < kHeight; row++) {
+      for (std::size_t col = 0; col < kWidth; col++) {
+        const std::size_t pixel = row * kWidth + col;
+        guides_.depth[pixel] = col < kWidth / 2 ? 5 : 10;
+        guides_.normal[pixel * 3 + 2] = -1;
+        for (std::size_t c = 0; c < 3; c++) {
+          guides_.albedo[pixel * 3 + c] = row < kHeight / 2 ? 0.2f : 0.8f;
+        }
+      }
+    }
+  }
+
+ protected:
+  static constexpr std::size_t kWidth = 61, kHeight = 40;
+  DenoiserGuides guides_;
+
+  // The noise-free image of the wall.
+  static double3 Clean(std::size_t row, std::size_t col) {
+    const double light = col < kWidth / 2 ? 1 : 0.25;
+    const double albedo = row < kHeight / 2 ? 0.2 : 0.8;
+    return double3{light * albedo, light * albedo, 0.5 * light * albedo};
+  }
+
+  // Hashed noise with a standard deviation of about 0.1.
+  static double Noise(std::size_t i) {
+    std::uint32_t h = i * 2654435761u;
+    h ^= h >> 15;
+    h *= 2246822519u;
+    h ^= h >> 13;
+    return (h / 4294967296.0 - 0.5) * 0.35;
+  }
+
+  static double Error(const Framebuffer &image) {
+    double sum = 0;
+    for (std::size_t row = 0; row < kHeight; row++) {
+      for (std::size_t col = 0; col < kWidth; col++) {
+        const double3 difference = image.Get(row, col) - Clean(row, col);
+        sum += length2(difference);
+      }
+    }
+    return std::sqrt(sum / (kWidth * kHeight));
+  }
+};
+
+TEST_F(DenoiserTest, RemovesNoise) {
+  Framebuffer image(kWidth, kHeight);
+  for (std::size_t row = 0; row < kHeight; row++) {
+    for (std::size_t col = 0; col < kWidth; col++) {
+      const std::size_t pixel = row * kWidth + col;
+      image.Set(row, col, Clean(row, col) + double3{
+          Noise(pixel * 3), Noise(pixel * 3 + 1), Noise(pixel * 3 + 2)});
+    }
+  }
+  const double noisy_error = Error(image);
+
+  // With the noise the samples tell, and without.
+  for (bool known_variance : {true, false}) {
+    DenoiserGuides guides = guides_;
+    if (known_variance) guides.variance.assign(kWidth * kHeight, 0.01f / 3);
+    Framebuffer denoised = image;
+    Denoiser().Denoise(guides, &denoised);
+    EXPECT_LT(Error(denoised), noisy_error / 3);
+  }
+}
+
+TEST_F(DenoiserTest, KeepsEdges) {
+  // Without noise, the guides keep the halves and the quarters apart.
+  Framebuffer image(kWidth, kHeight);
+  for (std::size_t row = 0; row < kHeight; row++) {
+    for (std::size_t col = 0; col < kWidth; col++) {
+      image.Set(row, col, Clean(row, col));
+    }
+  }
+  guides_.variance.assign(kWidth * kHeight, 1e-4f);
+  Denoiser().Denoise(guides_, &image);
+  EXPECT_LT(Error(image), 1e-3);
+}
+
+TEST_F(DenoiserTest, KeepsNoiseFreeImages) {
+  // No noise, no blur, even where nothing else tells the pixels apart.
+  Framebuffer image(kWidth, kHeight);
+  for (std::size_t row = 0; row < kHeight; row++) {
+    for (std::size_t col = 0; col < kWidth; col++) {
+      image.Set(row, col, double3{(row + col) % 7 * 0.1, 0, 0});
+    }
+  }
+  const Framebuffer original = image;
+  guides_.variance.assign(kWidth * kHeight, 0);
+  Denoiser().Denoise(guides_, &image);
+  for (std::size_t i = 0; i < image.size(); i++) {
+    EXPECT_NEAR(image.data()[i], original.data()[i], 1e-4);
+  }
+}
+
+}  // namespace test
+
+}  // namespace deer
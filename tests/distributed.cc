@@ -0,0 +1,131 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "../src/distributed.h"
+
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../src/geometry.h"
+#include "../src/optics.h"
+#include "../src/renderer.h"
+#include "../src/scene.h"
+#include "../src/transform.h"
+#include "scene_fixture.h"
+
+namespace deer {
+
+namespace test {
+
+// Set in a worker, whose copy of a scene with a KillingGeometry then
+// dies on the first ray it traces.
+bool kill_while_tracing = false;
+
+// Never hit, so it leaves the image as it is.
+struct KillingGeometry : public Geometry {
+  std::optional<RayIntersection> IntersectWithRay(const Ray &) const override {
+    if (kill_while_tracing) std::raise(SIGKILL);
+    return {};
+  }
+};
+
+class DistributedRendererTest
+    : public SceneFixture<RayTracer::Options> {
+ public:
+  void SetUp() {
+    SceneFixture::SetUp();
+    options_.n_threads = 2;
+    options_.tile_size = 8;
+
+    distributed_options_.n_workers = 3;
+    distributed_options_.region_size = 16;
+  }
+
+  std::vector<std::uint8_t> RenderAlone() {
+    return RayTracer(options_).Render(scene_, camera_)->result.get();
+  }
+
+ protected:
+  DistributedRenderer::Options distributed_options_;
+};
+
+TEST_F(DistributedRendererTest, MatchesSingleProcess) {
+  DistributedRenderer renderer(options_, distributed_options_);
+  auto job_status = renderer.Render(scene_, camera_);
+  auto image = job_status->result.get();
+
+  EXPECT_EQ(image, RenderAlone());
+  EXPECT_EQ(job_status->outcome, Renderer::Outcome::kCompleted);
+  EXPECT_EQ(job_status->amount_done, 1.0);
+  EXPECT_EQ(job_status->statistics.primary_rays, 75u * 41u);
+  EXPECT_EQ(job_status->statistics.workers_lost, 0u);
+  EXPECT_EQ(job_status->image.width(), 75u);
+  EXPECT_EQ(job_status->image.height(), 41u);
+}
+
+TEST_F(DistributedRendererTest, MatchesSingleProcessWithAdaptiveSampling) {
+  // Pixels look for contrast only inside their own tile, and regions are
+  // whole tiles.
+  options_.min_samples = 2;
+  options_.max_samples = 8;
+  DistributedRenderer renderer(options_, distributed_options_);
+  auto job_status = renderer.Render(scene_, camera_);
+
+  EXPECT_EQ(job_status->result.get(), RenderAlone());
+}
+
+TEST_F(DistributedRendererTest, RetracesRegionsOfLostWorkers) {
+  distributed_options_.worker_init = [](std::size_t worker) {
+    if (worker == 1) std::raise(SIGKILL);
+  };
+  DistributedRenderer renderer(options_, distributed_options_);
+  auto job_status = renderer.Render(scene_, camera_);
+  auto image = job_status->result.get();
+
+  EXPECT_EQ(image, RenderAlone());
+  EXPECT_EQ(job_status->statistics.workers_lost, 1u);
+  EXPECT_EQ(job_status->statistics.primary_rays, 75u * 41u);
+}
+
+TEST_F(DistributedRendererTest, RequeuesRegionsInFlightOfLostWorkers) {
+  scene_.Add(std::make_shared<GeometryObject>(
+      std::make_shared<KillingGeometry>(), nullptr, AffineTransform()));
+  distributed_options_.regions_in_flight = 3;
+  distributed_options_.worker_init = [](std::size_t worker) {
+    if (worker == 1) kill_while_tracing = true;
+  };
+  DistributedRenderer renderer(options_, distributed_options_);
+  auto job_status = renderer.Render(scene_, camera_);
+  auto image = job_status->result.get();
+
+  EXPECT_EQ(image, RenderAlone());
+  EXPECT_EQ(job_status->statistics.workers_lost, 1u);
+  // The worker dies on its first region, with up to two more sent after
+  // it, depending on when the coordinator notices.
+  EXPECT_GE(job_status->statistics.regions_retraced, 1u);
+  EXPECT_LE(job_status->statistics.regions_retraced, 3u);
+  EXPECT_EQ(job_status->statistics.primary_rays, 75u * 41u);
+}
+
+TEST_F(DistributedRendererTest, TracesItselfWithoutWorkers) {
+  distributed_options_.worker_init = [](std::size_t) {
+    std::raise(SIGKILL);
+  };
+  DistributedRenderer renderer(options_, distributed_options_);
+  auto job_status = renderer.Render(scene_, camera_);
+  auto image = job_status->result.get();
+
+  EXPECT_EQ(image, RenderAlone());
+  EXPECT_EQ(job_status->statistics.workers_lost, 3u);
+}
+
+}  // namespace test
+
+}  // namespace deer
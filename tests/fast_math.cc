@@ -0,0 +1,94 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "../src/fast_math.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+namespace deer {
+
+namespace test {
+
+template<class Math>
+class FastMathTest : public ::testing::Test {
+ protected:
+  static double RelativeError(double approximation, double exact) {
+    return std::abs(approximation / exact - 1);
+  }
+
+#ifdef __SSE2__
+  static double Lane0(__m128 v) { return _mm_cvtss_f32(v); }
+#endif
+};
+
+using ApproximateTiers = ::testing::Types<
+    FastMath<MathAccuracy::kFast>, FastMath<MathAccuracy::kFastest>>;
+TYPED_TEST_SUITE(FastMathTest, ApproximateTiers);
+
+TYPED_TEST(FastMathTest, RsqrtAndRcpAreWithinBounds) {
+  using Math = TypeParam;
+  double rsqrt_error = 0, rcp_error = 0;
+  for (double x = 1e-30; x < 1e30; x *= 1.001) {
+    const double rsqrt = 1 / std::sqrt(x);
+    rsqrt_error = std::max(rsqrt_error,
+        this->RelativeError(Math::Rsqrt(x), rsqrt));
+    rcp_error = std::max(rcp_error, this->RelativeError(Math::Rcp(x), 1 / x));
+#ifdef __SSE2__
+    const __m128 v = _mm_set1_ps(x);
+    rsqrt_error = std::max(rsqrt_error,
+        this->RelativeError(this->Lane0(Math::Rsqrt(v)), rsqrt));
+    rcp_error = std::max(rcp_error,
+        this->RelativeError(this->Lane0(Math::Rcp(v)), 1 / x));
+#endif
+  }
+  EXPECT_LE(rsqrt_error, Math::kRsqrtError);
+  EXPECT_LE(rcp_error, Math::kRcpError);
+}
+
+TYPED_TEST(FastMathTest, ExpIsWithinBounds) {
+  using Math = TypeParam;
+  for (double x = -87; x < 88; x += 0.001) {
+    const double bound = Math::kExpError * (1 + std::abs(x));
+    ASSERT_LE(this->RelativeError(Math::Exp(x), std::exp(x)), bound) << x;
+#ifdef __SSE2__
+    const double simd = this->Lane0(Math::Exp(_mm_set1_ps(x)));
+    ASSERT_LE(this->RelativeError(simd, std::exp(x)), bound) << x;
+#endif
+  }
+}
+
+#ifdef __SSE2__
+TEST(FastMathExp2Test, ScalarMatchesSimdAtHalves) {
+  for (float t = -20.5f; t <= 20.5f; t += 1) {
+    const __m128 simd = fast_math_internal::Exp2<4>(_mm_set1_ps(t));
+    EXPECT_EQ(fast_math_internal::Exp2<4>(t), _mm_cvtss_f32(simd)) << t;
+  }
+}
+#endif
+
+TYPED_TEST(FastMathTest, PowIsWithinBounds) {
+  using Math = TypeParam;
+  for (double y = -32; y <= 128; y += 0.5) {
+    for (double x = 1e-4; x <= 100; x *= 1.01) {
+      const double exact = std::pow(x, y);
+      if (exact < 1e-37 || exact > 1e38) continue;
+      const double bound = Math::kPowError *
+          (1 + std::abs(y) * (1 + std::abs(std::log(x))));
+      ASSERT_LE(this->RelativeError(Math::Pow(x, y), exact), bound)
+          << x << "^" << y;
+#ifdef __SSE2__
+      const double simd =
+          this->Lane0(Math::Pow(_mm_set1_ps(x), _mm_set1_ps(y)));
+      ASSERT_LE(this->RelativeError(simd, exact), bound) << x << "^" << y;
+#endif
+    }
+  }
+}
+
+}  // namespace test
+
+}  // namespace deer
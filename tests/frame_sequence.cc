@@ -0,0 +1,117 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "../src/frame_sequence.h"
+
+#include <cmath>
+#include <memory>
+
+#include <gtest/gtest.h>
+
+#include "../src/geometry.h"
+#include "../src/optics.h"
+#include "../src/renderer.h"
+#include "../src/scene.h"
+#include "../src/spectrum.h"
+#include "../src/transform.h"
+#include "scene_fixture.h"
+
+namespace deer {
+
+namespace test {
+
+class FrameSequenceTest : public SceneFixture<RayTracer::Options> {};
+
+TEST_F(FrameSequenceTest, ReusesPixelsOfPreviousFrame) {
+  options_.min_samples = 2;
+  options_.max_samples = 8;
+  const auto expected =
+      RayTracer(options_).Render(scene_, camera_)->result.get();
+
+  FrameSequence::Options sequence_options;
+  sequence_options.refresh_interval = 3;
+  FrameSequence sequence(options_, sequence_options);
+  auto first = sequence.RenderFrame(scene_, camera_);
+  EXPECT_EQ(first->result.get(), expected);
+  EXPECT_EQ(first->statistics.reused_pixel_fraction, 0);
+
+  // Nothing moved, so nothing needs tracing.
+  auto still = sequence.RenderFrame(scene_, camera_);
+  EXPECT_EQ(still->result.get(), expected);
+  EXPECT_EQ(still->statistics.reused_pixel_fraction, 1);
+  EXPECT_EQ(still->statistics.primary_rays, 0u);
+
+  Camera moved = camera_;
+  moved.transform.Translate(0.2, 0.1, 0);
+  auto moving = sequence.RenderFrame(scene_, moved);
+  const auto image = moving->result.get();
+  EXPECT_GT(moving->statistics.reused_pixel_fraction, 0.5);
+  EXPECT_LT(moving->statistics.reused_pixel_fraction, 1);
+  const auto traced = RayTracer(options_).Render(scene_, moved);
+  const auto traced_image = traced->result.get();
+  EXPECT_LT(moving->statistics.primary_rays,
+            traced->statistics.primary_rays);
+  double squared_error = 0;
+  for (std::size_t i = 0; i < image.size(); i++) {
+    squared_error += std::pow(image[i] - traced_image[i], 2);
+  }
+  EXPECT_LT(std::sqrt(squared_error / image.size()), 8);
+
+  // The refresh.
+  auto refreshed = sequence.RenderFrame(scene_, moved);
+  EXPECT_EQ(refreshed->result.get(), traced_image);
+  EXPECT_EQ(refreshed->statistics.reused_pixel_fraction, 0);
+}
+
+TEST_F(FrameSequenceTest, ReusesSingleSamplesWhereTheyWereTraced) {
+  // Through the pixel corners, so a still frame finds them there.
+  options_.min_samples = options_.max_samples = 1;
+  const auto expected =
+      RayTracer(options_).Render(scene_, camera_)->result.get();
+
+  FrameSequence::Options sequence_options;
+  sequence_options.max_drift = 0.25;
+  FrameSequence sequence(options_, sequence_options);
+  sequence.RenderFrame(scene_, camera_)->result.wait();
+  auto still = sequence.RenderFrame(scene_, camera_);
+  EXPECT_EQ(still->result.get(), expected);
+  EXPECT_EQ(still->statistics.reused_pixel_fraction, 1);
+}
+
+TEST_F(FrameSequenceTest, StopsFrameWhileReprojecting) {
+  options_.image_width = 240;
+  options_.image_height = 135;
+  FrameSequence sequence(options_);
+  sequence.RenderFrame(scene_, camera_)->result.wait();
+  auto job_status = sequence.RenderFrame(scene_, camera_);
+  job_status->cancel_requested = true;
+
+  job_status->result.wait();
+  EXPECT_EQ(job_status->outcome, Renderer::Outcome::kCancelled);
+  EXPECT_LT(job_status->statistics.reused_pixel_fraction, 1);
+  EXPECT_EQ(job_status->statistics.primary_rays, 0u);
+}
+
+TEST_F(FrameSequenceTest, TracesMirrorsInEveryFrame) {
+  auto mirror = std::make_shared<Material>();
+  mirror->diffusion_spectrum = Spectrum::MakeConstant(0);
+  mirror->specular_spectrum = Spectrum::MakeConstant(0);
+  mirror->ambiance_spectrum = Spectrum::MakeConstant(0);
+  mirror->reflectivity = 1;
+  scene_.Add(std::make_shared<GeometryObject>(
+      std::make_shared<UnitSphereGeometry>(), mirror,
+      AffineTransform().Translate(2, 0, 0)));
+
+  FrameSequence sequence(options_);
+  sequence.RenderFrame(scene_, camera_)->result.wait();
+  auto second = sequence.RenderFrame(scene_, camera_);
+  second->result.wait();
+  EXPECT_GT(second->statistics.reused_pixel_fraction, 0.5);
+  EXPECT_LT(second->statistics.reused_pixel_fraction, 1);
+  EXPECT_GT(second->statistics.primary_rays, 0u);
+}
+
+}  // namespace test
+
+}  // namespace deer
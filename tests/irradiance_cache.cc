@@ -0,0 +1,157 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "../src/irradiance_cache.h"
+
+#include <cmath>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../src/vector.h"
+
+namespace deer {
+
+namespace test {
+
+class IrradianceCacheTest : public ::testing::Test {
+ protected:
+  static IrradianceCache::Record MakeRecord(const double4 &point,
+                                            double irradiance,
+                                            double radius) {
+    IrradianceCache::Record record;
+    record.point = point;
+    record.normal = double4{0, 0, 1, 0};
+    record.irradiance = double3{irradiance, irradiance, irradiance};
+    record.radius = radius;
+    record.gradient = {double3::zero(), double3::zero(), double3::zero()};
+    return record;
+  }
+
+  // Over a floor at z = 0, a ceiling at z = 1 that shines only where
+  // x > 0, with the given strata.
+  static IrradianceCache::Record SampleUnderHalfLitCeiling(double x,
+                                                           std::size_t m,
+                                                           std::size_t n) {
+    const double4 point{x, 0, 0, 1};
+    return IrradianceCache::Sample(point, double4{0, 0, 1, 0}, m, n, 0, 100,
+        [](std::size_t) { return double2{0.5, 0.5}; },
+        [&](const double4 &direction, std::size_t) {
+          const double distance = 1 / direction[2];
+          const double4 hit = point + distance * direction;
+          const double radiance = hit[0] > 0 ? 1 : 0;
+          return IrradianceCache::Incoming{
+              double3{radiance, radiance, radiance}, distance};
+        });
+  }
+
+  const double4 up_{0, 0, 1, 0};
+};
+
+TEST_F(IrradianceCacheTest, InterpolatesNearbyRecords) {
+  IrradianceCache cache(0.2);
+  auto record = MakeRecord(double4{0, 0, 0, 1}, 1, 1);
+  record.gradient[0] = double3{1, 2, 3};
+  cache.Insert(record);
+  EXPECT_EQ(cache.size(), 1u);
+
+  auto irradiance = cache.Lookup(double4{0.1, 0, 0, 1}, up_);
+  ASSERT_TRUE(irradiance);
+  EXPECT_NEAR((*irradiance)[0], 1.1, 1e-12);
+  EXPECT_NEAR((*irradiance)[1], 1.2, 1e-12);
+  EXPECT_NEAR((*irradiance)[2], 1.3, 1e-12);
+
+  // Too far for the radius, or facing too differently.
+  EXPECT_FALSE(cache.Lookup(double4{0.25, 0, 0, 1}, up_));
+  EXPECT_FALSE(cache.Lookup(double4{0, 0, 0, 1}, double4{1, 0, 0, 0}));
+
+  // Closer records weigh more.
+  cache.Insert(MakeRecord(double4{0.1, 0, 0, 1}, 2, 1));
+  irradiance = cache.Lookup(double4{0.08, 0, 0, 1}, up_);
+  ASSERT_TRUE(irradiance);
+  EXPECT_GT((*irradiance)[0], 1.5);
+  EXPECT_LT((*irradiance)[0], 2);
+}
+
+TEST_F(IrradianceCacheTest, IgnoresRecordsInFront) {
+  IrradianceCache cache(0.2);
+  cache.Insert(MakeRecord(double4{0, 0, 0, 1}, 1, 1));
+  EXPECT_TRUE(cache.Lookup(double4{0.05, 0, 0.15, 1}, up_));
+  EXPECT_FALSE(cache.Lookup(double4{0.05, 0, -0.15, 1}, up_));
+}
+
+TEST_F(IrradianceCacheTest, FindsRecordsOfAnySize) {
+  IrradianceCache cache(0.5, double4{0, 0, 0, 1}, 16);
+  std::vector<IrradianceCache::Record> records;
+  for (int i = 0; i < 200; i++) {
+    // Spread over the octree cells and their borders, and outside it.
+    const double4 point{(i % 10 - 4.5) * 2.0, (i / 10 % 5 - 2) * 2.0,
+                        i / 50 * 7.0, 1};
+    records.push_back(MakeRecord(point, i, std::pow(0.5, i % 8)));
+    cache.Insert(records.back());
+  }
+  EXPECT_EQ(cache.size(), records.size());
+  for (const auto &record : records) {
+    const double4 offset{0.2 * record.radius, -0.1 * record.radius, 0, 0};
+    const auto irradiance = cache.Lookup(record.point + offset, up_);
+    ASSERT_TRUE(irradiance);
+    EXPECT_NEAR((*irradiance)[0], record.irradiance[0], 1e-9);
+  }
+}
+
+TEST_F(IrradianceCacheTest, InsertsFromManyThreads) {
+  IrradianceCache cache(0.5, double4{0, 0, 0, 1}, 8);
+  const std::size_t n_threads = 4, n_records = 500;
+  std::vector<std::thread> threads;
+  for (std::size_t t = 0; t < n_threads; t++) {
+    threads.emplace_back([&cache, t] {
+      for (std::size_t i = 0; i < n_records; i++) {
+        const double4 point{i % 20 * 0.2 - 2, i / 20 * 0.2 - 2, t * 1.0, 1};
+        cache.Insert(MakeRecord(point, t, 0.05));
+        // Lookups see records as soon as they are in.
+        EXPECT_TRUE(cache.Lookup(point, double4{0, 0, 1, 0}));
+      }
+    });
+  }
+  for (auto &thread : threads) thread.join();
+
+  EXPECT_EQ(cache.size(), n_threads * n_records);
+  for (std::size_t t = 0; t < n_threads; t++) {
+    for (std::size_t i = 0; i < n_records; i++) {
+      const double4 point{i % 20 * 0.2 - 2, i / 20 * 0.2 - 2, t * 1.0, 1};
+      const auto irradiance = cache.Lookup(point, up_);
+      ASSERT_TRUE(irradiance);
+      EXPECT_EQ((*irradiance)[0], t);
+    }
+  }
+}
+
+TEST_F(IrradianceCacheTest, SamplesIrradianceAndItsGradient) {
+  const auto record = SampleUnderHalfLitCeiling(0, 40, 125);
+  // Half of the cosine-weighted hemisphere sees the lit half.
+  EXPECT_NEAR(record.irradiance[0], 0.5, 0.01);
+  EXPECT_GT(record.radius, 1);
+  EXPECT_LT(record.radius, 2);
+
+  // Moving towards the lit half brightens the floor; sideways doesn't.
+  EXPECT_GT(record.gradient[0][0], 0);
+  EXPECT_NEAR(record.gradient[1][0], 0, 0.01);
+  EXPECT_NEAR(record.gradient[2][0], 0, 0.01);
+
+  // Analytically, the irradiance over pi grows by h / 2 per unit of x for
+  // a ceiling at height h.
+  EXPECT_NEAR(record.gradient[0][0], 0.5, 0.05);
+  for (double step : {-0.1, 0.1}) {
+    const auto moved = SampleUnderHalfLitCeiling(step, 40, 125);
+    const double change = moved.irradiance[0] - record.irradiance[0];
+    const double predicted = record.gradient[0][0] * step;
+    EXPECT_LT(std::abs(predicted - change), 0.2 * std::abs(change));
+  }
+}
+
+}  // namespace test
+
+}  // namespace deer
@@ -0,0 +1,111 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "../src/light_tree.h"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../src/rgb.h"
+#include "../src/scene.h"
+#include "../src/spectrum.h"
+#include "../src/vector.h"
+
+namespace deer {
+
+namespace test {
+
+class LightTreeTest : public ::testing::Test {
+ public:
+  void SetUp() {
+    for (int i = 0; i < 37; i++) {
+      lights_.push_back(std::make_shared<PointLightSource>(
+          double4{(i % 7) * 3.0, (i / 7) * 2.0, (i % 3) * 1.0, 1},
+          Spectrum::MakeConstant(1 + i % 4), i % 5 * 0.1));
+    }
+  }
+
+ protected:
+  std::vector<std::shared_ptr<PointLightSource>> lights_;
+  const RgbColorProfile profile_{double3{2, 1, 0}, double3::zero(),
+                                 double3{1, 1, 1}};
+};
+
+TEST_F(LightTreeTest, ProbabilitiesAddUpToOne) {
+  const LightTree tree(lights_, profile_);
+  EXPECT_EQ(tree.size(), lights_.size());
+  for (const double4 &point : {double4{0, 0, 0, 1}, double4{10, 5, -3, 1},
+                               double4{100, 0, 0, 1}}) {
+    double total = 0;
+    for (std::size_t light = 0; light < lights_.size(); light++) {
+      total += tree.Probability(point, light);
+    }
+    EXPECT_NEAR(total, 1, 1e-9);
+  }
+}
+
+TEST_F(LightTreeTest, SamplesWithItsProbabilities) {
+  const LightTree tree(lights_, profile_);
+  const double4 point{4, 3, -1, 1};
+  const std::size_t n = 100000;
+  std::vector<std::size_t> counts(lights_.size());
+  for (std::size_t i = 0; i < n; i++) {
+    const auto choice = tree.Sample(point, (i + 0.5) / n);
+    ASSERT_TRUE(choice);
+    EXPECT_NEAR(choice->probability,
+                tree.Probability(point, choice->light), 1e-12);
+    counts[choice->light]++;
+  }
+  for (std::size_t light = 0; light < lights_.size(); light++) {
+    EXPECT_NEAR(double(counts[light]) / n, tree.Probability(point, light),
+                1e-3);
+  }
+}
+
+TEST_F(LightTreeTest, PrefersNearAndPowerfulLights) {
+  lights_ = {
+    std::make_shared<PointLightSource>(double4{0, 0, 1, 1},
+                                       Spectrum::MakeConstant(1)),
+    std::make_shared<PointLightSource>(double4{0, 0, 10, 1},
+                                       Spectrum::MakeConstant(1)),
+    std::make_shared<PointLightSource>(double4{0, 0, -10, 1},
+                                       Spectrum::MakeConstant(10)),
+    std::make_shared<PointLightSource>(double4{0, 0, -20, 1},
+                                       Spectrum::MakeConstant(0)),
+  };
+  const LightTree tree(lights_, profile_);
+  const double4 origin{0, 0, 0, 1};
+  EXPECT_GT(tree.Probability(origin, 0), tree.Probability(origin, 1));
+  EXPECT_GT(tree.Probability(origin, 2), tree.Probability(origin, 1));
+  EXPECT_EQ(tree.Probability(origin, 3), 0);
+}
+
+TEST_F(LightTreeTest, PicksNothingWithoutLights) {
+  EXPECT_FALSE(LightTree({}, profile_).Sample(double4{0, 0, 0, 1}, 0.5));
+
+  lights_ = {std::make_shared<PointLightSource>(double4{0, 0, 1, 1},
+                                                Spectrum::MakeConstant(0))};
+  EXPECT_FALSE(LightTree(lights_, profile_).Sample(double4{0, 0, 0, 1},
+                                                   0.5));
+}
+
+TEST_F(LightTreeTest, WeighsPowerBetweenProfileWavelengths) {
+  // Dark at the wavelengths of the profile, but not between them, where
+  // a spectral renderer samples too.
+  lights_ = {std::make_shared<PointLightSource>(
+                 double4{0, 0, 1, 1}, Spectrum::MakeMonochrome(1.5, 0.4, 1)),
+             std::make_shared<PointLightSource>(
+                 double4{0, 0, 1, 1}, Spectrum::MakeConstant(1))};
+  const LightTree tree(lights_, profile_);
+  const double4 origin{0, 0, 0, 1};
+  EXPECT_GT(tree.Probability(origin, 0), 0);
+  EXPECT_LT(tree.Probability(origin, 0), tree.Probability(origin, 1));
+}
+
+}  // namespace test
+
+}  // namespace deer
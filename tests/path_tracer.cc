@@ -0,0 +1,145 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "../src/path_tracer.h"
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../src/irradiance_cache.h"
+#include "../src/renderer.h"
+#include "../src/spectrum.h"
+#include "scene_fixture.h"
+
+namespace deer {
+
+namespace test {
+
+class PathTracerTest : public SceneFixture<PathTracer::Options> {
+ public:
+  void SetUp() {
+    SceneFixture::SetUp();
+    material_->ambiance_spectrum = Spectrum::MakeConstant(0.5);
+    material_->diffusion_spectrum = Spectrum::MakeConstant(0.8);
+    material_->specular_spectrum = Spectrum::MakeConstant(0.2);
+
+    options_.image_width = 48;
+    options_.image_height = 27;
+    options_.samples_per_pixel = 8;
+  }
+
+ protected:
+  std::vector<std::uint8_t> Render(const PathTracer::Options &options) {
+    return PathTracer(options).Render(scene_, camera_)->result.get();
+  }
+};
+
+TEST_F(PathTracerTest, IsDeterministic) {
+  const auto expected = Render(options_);
+  for (std::size_t n_threads : {1, 3}) {
+    options_.n_threads = n_threads;
+    EXPECT_EQ(Render(options_), expected);
+  }
+}
+
+TEST_F(PathTracerTest, TreatsTileSizeZeroAsOne) {
+  const auto expected = Render(options_);
+  options_.tile_size = 0;
+  EXPECT_EQ(Render(options_), expected);
+}
+
+TEST_F(PathTracerTest, MatchesRayTracerWithoutBounces) {
+  // With no indirect light, both shade the same primary rays alike, as
+  // the light is hard and shadows whatever is behind a surface from it.
+  options_.max_bounces = 0;
+  const auto image = Render(options_);
+
+  RayTracer::Options ray_tracer_options;
+  ray_tracer_options.image_width = options_.image_width;
+  ray_tracer_options.image_height = options_.image_height;
+  ray_tracer_options.color_profile = options_.color_profile;
+  ray_tracer_options.min_samples = ray_tracer_options.max_samples =
+      options_.samples_per_pixel;
+  const auto expected = RayTracer(ray_tracer_options)
+      .Render(scene_, camera_)->result.get();
+
+  ASSERT_EQ(image.size(), expected.size());
+  for (std::size_t i = 0; i < image.size(); i++) {
+    EXPECT_NEAR(image[i], expected[i], 1);
+  }
+}
+
+TEST_F(PathTracerTest, AcceptsObjectsWithoutMaterial) {
+  // Behind the camera, where no primary or shadow ray goes.
+  options_.max_bounces = 0;
+  const auto expected = Render(options_);
+  scene_.Add(std::make_shared<GeometryObject>(
+      std::make_shared<UnitSphereGeometry>(), nullptr,
+      AffineTransform().Translate(0, 0, -20)));
+  EXPECT_EQ(Render(options_), expected);
+}
+
+TEST_F(PathTracerTest, AddsIndirectLight) {
+  options_.max_bounces = 0;
+  const auto direct = Render(options_);
+  options_.max_bounces = 4;
+  const auto global = Render(options_);
+
+  // Only ever more light, here mostly from the plane onto the sphere.
+  ASSERT_EQ(global.size(), direct.size());
+  for (std::size_t i = 0; i < global.size(); i++) {
+    EXPECT_GE(global[i], direct[i]);
+  }
+  EXPECT_GT(std::accumulate(global.begin(), global.end(), 0.0),
+            std::accumulate(direct.begin(), direct.end(), 0.0));
+}
+
+TEST_F(PathTracerTest, CachesIrradiance) {
+  options_.n_threads = 1;
+  options_.max_bounces = 2;
+  const auto brute_force = Render(options_);
+
+  auto cache = std::make_shared<IrradianceCache>(0.3);
+  options_.irradiance_cache = cache;
+  options_.irradiance_samples = 64;
+  const auto cached = Render(options_);
+  const std::size_t n_records = cache->size();
+  EXPECT_GT(n_records, 0u);
+  // Far fewer hemispheres than the diffuse hits.
+  EXPECT_LT(n_records, options_.image_width * options_.image_height / 4);
+
+  ASSERT_EQ(cached.size(), brute_force.size());
+  double error = 0;
+  for (std::size_t i = 0; i < cached.size(); i++) {
+    error += std::abs(cached[i] - brute_force[i]);
+  }
+  EXPECT_LT(error / cached.size(), 4);
+
+  // Every point of the next frame finds the records of the first.
+  Render(options_);
+  EXPECT_EQ(cache->size(), n_records);
+}
+
+TEST_F(PathTracerTest, ReportsProgress) {
+  options_.samples_per_pass = 3;
+  PathTracer tracer(options_);
+  auto job_status = tracer.Render(scene_, camera_);
+  EXPECT_EQ(job_status->passes_total, 3u);
+
+  job_status->result.wait();
+  EXPECT_EQ(job_status->passes_done, 3u);
+  EXPECT_EQ(job_status->outcome, Renderer::Outcome::kCompleted);
+  EXPECT_EQ(job_status->statistics.primary_rays,
+            options_.image_width * options_.image_height * 8);
+  EXPECT_GT(job_status->statistics.samples_per_second(), 0);
+}
+
+}  // namespace test
+
+}  // namespace deer
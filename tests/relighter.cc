@@ -0,0 +1,53 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "../src/relighter.h"
+
+#include <gtest/gtest.h>
+
+#include "../src/renderer.h"
+#include "../src/scene.h"
+#include "../src/spectrum.h"
+#include "scene_fixture.h"
+
+namespace deer {
+
+namespace test {
+
+class RelighterTest : public SceneFixture<RayTracer::Options> {};
+
+TEST_F(RelighterTest, RelightsFromCachedHits) {
+  options_.min_samples = 2;
+  options_.max_samples = 8;
+  Relighter relighter(options_);
+  auto first = relighter.Render(scene_, camera_);
+  EXPECT_EQ(first->result.get(),
+            RayTracer(options_).Render(scene_, camera_)->result.get());
+  EXPECT_EQ(first->statistics.cached_camera_rays, 0u);
+
+  scene_.point_light_sources()[0]->position = double4{5, 3, -5, 1};
+  auto moved = relighter.Render(scene_, camera_);
+  EXPECT_EQ(moved->result.get(),
+            RayTracer(options_).Render(scene_, camera_)->result.get());
+  EXPECT_GT(moved->statistics.cached_camera_rays, 0u);
+  EXPECT_LE(moved->statistics.cached_camera_rays,
+            moved->statistics.primary_rays);
+
+  options_.execution_mode = ExecutionMode::kWavefront;
+  Relighter wavefront_relighter(options_);
+  wavefront_relighter.Render(scene_, camera_)->result.wait();
+  // Dropping the specular term changes the shading kernel too.
+  auto material = scene_.objects()[0]->AsGeometryObject()->material();
+  material->specular_spectrum = Spectrum::MakeConstant(0);
+  material->diffusion_spectrum = Spectrum::MakeConstant(0.5);
+  material->reflectivity = 0.5;
+  auto edited = wavefront_relighter.Render(scene_, camera_);
+  EXPECT_EQ(edited->result.get(),
+            RayTracer(options_).Render(scene_, camera_)->result.get());
+  EXPECT_GT(edited->statistics.cached_camera_rays, 0u);
+}
+
+}  // namespace test
+
+}  // namespace deer
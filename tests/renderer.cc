@@ -0,0 +1,465 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "../src/renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../src/color_conversion.h"
+#include "../src/framebuffer.h"
+#include "../src/geometry.h"
+#include "../src/optics.h"
+#include "../src/rgb.h"
+#include "../src/scene.h"
+#include "../src/scheduler.h"
+#include "../src/spectrum.h"
+#include "../src/transform.h"
+#include "scene_fixture.h"
+
+namespace deer {
+
+namespace test {
+
+class RendererTest : public SceneFixture<RayTracer::Options> {};
+
+TEST_F(RendererTest, ProgressiveRenderConvergesToFullRender) {
+  RayTracer full(options_);
+  const auto expected = full.Render(scene_, camera_)->result.get();
+
+  options_.progressive = true;
+  options_.progressive_stride = 12;  // rounded down to 8
+  RayTracer progressive(options_);
+  auto job_status = progressive.Render(scene_, camera_);
+  EXPECT_EQ(job_status->passes_total, 4u);
+  ASSERT_TRUE(job_status->snapshot);
+  EXPECT_EQ(job_status->snapshot().size(), expected.size());
+
+  EXPECT_EQ(job_status->result.get(), expected);
+  EXPECT_EQ(job_status->passes_done, 4u);
+  EXPECT_EQ(job_status->snapshot(), expected);
+}
+
+TEST_F(RendererTest, TreatsTileSizeZeroAsOne) {
+  options_.min_samples = 2;
+  options_.max_samples = 8;
+  options_.tile_size = 1;
+  const auto expected = RayTracer(options_).Render(scene_, camera_)
+      ->result.get();
+  options_.tile_size = 0;
+  EXPECT_EQ(RayTracer(options_).Render(scene_, camera_)->result.get(),
+            expected);
+}
+
+TEST_F(RendererTest, RefinesOnlyWherePixelsVary) {
+  const std::size_t n_pixels = options_.image_width * options_.image_height;
+  RayTracer single(options_);
+  auto single_status = single.Render(scene_, camera_);
+  single_status->result.wait();
+  EXPECT_EQ(single_status->statistics.primary_rays, n_pixels);
+
+  options_.min_samples = options_.max_samples = 16;
+  RayTracer uniform(options_);
+  auto uniform_status = uniform.Render(scene_, camera_);
+  const auto expected = uniform_status->result.get();
+  EXPECT_EQ(uniform_status->statistics.primary_rays, 16 * n_pixels);
+
+  options_.min_samples = 4;
+  RayTracer adaptive(options_);
+  auto adaptive_status = adaptive.Render(scene_, camera_);
+  const auto image = adaptive_status->result.get();
+  EXPECT_GT(adaptive_status->statistics.primary_rays, 4 * n_pixels);
+  EXPECT_LT(adaptive_status->statistics.primary_rays, 8 * n_pixels);
+
+  // Thin features can still slip between the first few samples.
+  ASSERT_EQ(image.size(), expected.size());
+  double squared_error = 0;
+  for (std::size_t i = 0; i < image.size(); i++) {
+    squared_error += std::pow(image[i] - expected[i], 2);
+  }
+  EXPECT_LT(std::sqrt(squared_error / image.size()), 2.0);
+}
+
+TEST_F(RendererTest, SeesReflections) {
+  // A mirror ahead of the camera, and a sphere behind it that only the
+  // mirror shows.
+  auto mirror = std::make_shared<Material>();
+  mirror->ambiance_spectrum = Spectrum::MakeConstant(1);
+  mirror->diffusion_spectrum = Spectrum::MakeConstant(0);
+  mirror->specular_spectrum = Spectrum::MakeConstant(0);
+  mirror->shininess = 0;
+  mirror->reflectivity = 1;
+  auto matte = std::make_shared<Material>(*mirror);
+  matte->reflectivity = 0;
+
+  Scene scene;
+  scene.ambiance_spectrum = Spectrum::MakeConstant(0.5);
+  scene.Add(std::make_shared<GeometryObject>(
+      std::make_shared<XYPlaneGeometry>(), mirror,
+      AffineTransform().Translate(0, 0, 5)));
+  scene.Add(std::make_shared<GeometryObject>(
+      std::make_shared<UnitSphereGeometry>(), matte,
+      AffineTransform().Scale(5).Translate(0, 0, -30)));
+
+  const std::size_t center =
+      (options_.image_height / 2 * options_.image_width +
+       options_.image_width / 2) * 3;
+  const auto image = RayTracer(options_).Render(scene, camera_)->result.get();
+  EXPECT_EQ(image[center], 127);
+
+  options_.max_bounces = 0;
+  const auto unreflected =
+      RayTracer(options_).Render(scene, camera_)->result.get();
+  EXPECT_EQ(unreflected[center], 0);
+}
+
+TEST_F(RendererTest, SeesThroughGlassOfOutsideIndex) {
+  RayTracer tracer(options_);
+  const auto expected = tracer.Render(scene_, camera_)->result.get();
+
+  auto glass = std::make_shared<Material>();
+  glass->ambiance_spectrum = Spectrum::MakeConstant(1);
+  glass->diffusion_spectrum = Spectrum::MakeConstant(1);
+  glass->specular_spectrum = Spectrum::MakeConstant(1);
+  glass->shininess = 1;
+  glass->transparency = 1;
+  glass->refractive_index = 1;
+  scene_.Add(std::make_shared<GeometryObject>(
+      std::make_shared<UnitSphereGeometry>(), glass,
+      AffineTransform().Translate(2, 0, -5)));
+
+  const auto image = tracer.Render(scene_, camera_)->result.get();
+  ASSERT_EQ(image.size(), expected.size());
+  for (std::size_t i = 0; i < image.size(); i++) {
+    EXPECT_NEAR(image[i], expected[i], 1);
+  }
+}
+
+TEST_F(RendererTest, SoftensShadowEdgesOnly) {
+  RayTracer tracer(options_);
+  const auto hard = tracer.Render(scene_, camera_)->result.get();
+
+  scene_.point_light_sources()[0]->softness = 1;
+  const auto soft = tracer.Render(scene_, camera_)->result.get();
+
+  // Fully lit and fully shadowed points see all or none of the light,
+  // just like with a point light.
+  ASSERT_EQ(soft.size(), hard.size());
+  std::size_t n_differing = 0;
+  for (std::size_t i = 0; i < soft.size(); i += 3) {
+    if (soft[i] != hard[i]) n_differing++;
+  }
+  EXPECT_GT(n_differing, 0u);
+  EXPECT_LT(n_differing, soft.size() / 3 / 10);
+}
+
+TEST_F(RendererTest, SamplesManyLights) {
+  for (int i = 0; i < 32; i++) {
+    scene_.Add(std::make_shared<PointLightSource>(
+        double4{(i % 8) - 4.0, 4, (i / 8) - 8.0, 1},
+        Spectrum::MakeConstant(0.02)));
+  }
+  options_.min_samples = options_.max_samples = 4;
+  const auto expected =
+      RayTracer(options_).Render(scene_, camera_)->result.get();
+
+  options_.light_samples = 4;
+  const auto image =
+      RayTracer(options_).Render(scene_, camera_)->result.get();
+  // Noisier, but just as bright on the whole.
+  ASSERT_EQ(image.size(), expected.size());
+  double error = 0, squared_error = 0;
+  for (std::size_t i = 0; i < image.size(); i++) {
+    error += image[i] - expected[i];
+    squared_error += std::pow(image[i] - expected[i], 2);
+  }
+  EXPECT_LT(std::abs(error / image.size()), 0.5);
+  EXPECT_LT(std::sqrt(squared_error / image.size()), 5.0);
+
+  options_.execution_mode = ExecutionMode::kWavefront;
+  EXPECT_EQ(RayTracer(options_).Render(scene_, camera_)->result.get(),
+            image);
+}
+
+TEST_F(RendererTest, CachesOccludersWithoutChangingImage) {
+  options_.occluder_cache = false;
+  auto uncached_status = RayTracer(options_).Render(scene_, camera_);
+  const auto expected = uncached_status->result.get();
+  EXPECT_EQ(uncached_status->statistics.shadow_rays, 0u);
+
+  options_.occluder_cache = true;
+  for (auto mode : {ExecutionMode::kPerPixel, ExecutionMode::kWavefront}) {
+    options_.execution_mode = mode;
+    auto job_status = RayTracer(options_).Render(scene_, camera_);
+    EXPECT_EQ(job_status->result.get(), expected);
+    const auto &statistics = job_status->statistics;
+    EXPECT_LT(statistics.occluded_shadow_rays, statistics.shadow_rays);
+    EXPECT_GT(statistics.occluder_cache_hit_rate(), 0.5);
+    EXPECT_LT(statistics.occluder_cache_hit_rate(), 1);
+  }
+}
+
+TEST_F(RendererTest, WavefrontMatchesPerPixel) {
+  // A second, soft light, and a mirror so that some paths go on.
+  scene_.Add(std::make_shared<PointLightSource>(
+      double4{5, 5, -5, 1}, Spectrum::MakeConstant(0.3), 1));
+  auto mirror = std::make_shared<Material>();
+  mirror->ambiance_spectrum = Spectrum::MakeConstant(0.5);
+  mirror->diffusion_spectrum = Spectrum::MakeConstant(0.5);
+  mirror->specular_spectrum = Spectrum::MakeConstant(0);
+  mirror->shininess = 0;
+  mirror->reflectivity = 0.5;
+  scene_.Add(std::make_shared<GeometryObject>(
+      std::make_shared<UnitSphereGeometry>(), mirror,
+      AffineTransform().Translate(2, 0, 0)));
+  options_.min_samples = 2;
+  options_.max_samples = 8;
+
+  for (auto accuracy : {MathAccuracy::kExact, MathAccuracy::kFastest}) {
+    options_.math_accuracy = accuracy;
+    options_.execution_mode = ExecutionMode::kPerPixel;
+    const auto expected =
+        RayTracer(options_).Render(scene_, camera_)->result.get();
+    options_.execution_mode = ExecutionMode::kWavefront;
+    const auto image =
+        RayTracer(options_).Render(scene_, camera_)->result.get();
+    ASSERT_EQ(image.size(), expected.size());
+    for (std::size_t i = 0; i < image.size(); i++) {
+      EXPECT_NEAR(image[i], expected[i], 1);
+    }
+  }
+}
+
+TEST_F(RendererTest, DenoisesSoftShadows) {
+  scene_.point_light_sources()[0]->softness = 2;
+  options_.min_shadow_samples = options_.max_shadow_samples = 1;
+  options_.min_samples = options_.max_samples = 32;
+  const auto expected =
+      RayTracer(options_).Render(scene_, camera_)->result.get();
+
+  options_.min_samples = options_.max_samples = 4;
+  const auto noisy =
+      RayTracer(options_).Render(scene_, camera_)->result.get();
+  options_.denoise = true;
+  auto job_status = RayTracer(options_).Render(scene_, camera_);
+  const auto denoised = job_status->result.get();
+  EXPECT_GT(job_status->statistics.denoising_seconds, 0);
+
+  auto error = [&](const std::vector<std::uint8_t> &image) {
+    double squared_error = 0;
+    for (std::size_t i = 0; i < image.size(); i++) {
+      squared_error += std::pow(image[i] - expected[i], 2);
+    }
+    return std::sqrt(squared_error / image.size());
+  };
+  ASSERT_EQ(denoised.size(), expected.size());
+  EXPECT_LT(error(denoised), error(noisy) / 1.5);
+  EXPECT_EQ(job_status->snapshot(), denoised);
+
+  options_.execution_mode = ExecutionMode::kWavefront;
+  EXPECT_EQ(RayTracer(options_).Render(scene_, camera_)->result.get(),
+            denoised);
+}
+
+TEST_F(RendererTest, FillsOutputBuffers) {
+  const auto expected =
+      RayTracer(options_).Render(scene_, camera_)->result.get();
+  options_.output_depth = options_.output_normal = true;
+  options_.output_albedo = options_.output_object_id = true;
+  options_.output_hit_count = true;
+  auto job_status = RayTracer(options_).Render(scene_, camera_);
+  EXPECT_EQ(job_status->result.get(), expected);
+
+  const auto &outputs = job_status->outputs;
+  const std::size_t width = options_.image_width;
+  const std::size_t n_pixels = width * options_.image_height;
+  ASSERT_EQ(outputs.depth.size(), n_pixels);
+  ASSERT_EQ(outputs.normal.size(), n_pixels * 3);
+  ASSERT_EQ(outputs.albedo.size(), n_pixels * 3);
+  ASSERT_EQ(outputs.object_id.size(), n_pixels);
+  ASSERT_EQ(outputs.hit_count.size(), n_pixels);
+
+  // The front of the sphere, in the middle of its disk.
+  const std::size_t sphere = 20 * width + 33;
+  EXPECT_EQ(outputs.object_id[sphere], 0u);
+  EXPECT_NEAR(outputs.depth[sphere], 9, 0.1);
+  EXPECT_LT(outputs.normal[sphere * 3 + 2], -0.9);
+  // The plane behind it, in the corner.
+  EXPECT_EQ(outputs.object_id[0], 1u);
+  EXPECT_GT(outputs.depth[0], 15);
+  EXPECT_FLOAT_EQ(outputs.normal[2], -1);
+  for (std::size_t i = 0; i < n_pixels; i++) {
+    EXPECT_GE(outputs.hit_count[i], 1u);
+    EXPECT_FLOAT_EQ(outputs.albedo[i * 3], 1);
+  }
+
+  options_.execution_mode = ExecutionMode::kWavefront;
+  auto wavefront_status = RayTracer(options_).Render(scene_, camera_);
+  wavefront_status->result.wait();
+  EXPECT_EQ(wavefront_status->outputs.depth, outputs.depth);
+  EXPECT_EQ(wavefront_status->outputs.object_id, outputs.object_id);
+  EXPECT_EQ(wavefront_status->outputs.hit_count, outputs.hit_count);
+
+  // Looking away from everything.
+  Camera backwards(16.0 / 9.0, 1, -2);
+  backwards.transform.Translate(0, 0, -10);
+  auto sky_status = RayTracer(options_).Render(scene_, backwards);
+  sky_status->result.wait();
+  EXPECT_TRUE(std::isinf(sky_status->outputs.depth[0]));
+  EXPECT_EQ(sky_status->outputs.object_id[0],
+            Renderer::OutputBuffers::kNoObject);
+  EXPECT_EQ(sky_status->outputs.hit_count[0], 0u);
+  EXPECT_EQ(sky_status->outputs.normal[2], 0);
+}
+
+TEST_F(RendererTest, FillsOnlyRequestedOutputBuffers) {
+  options_.output_object_id = true;
+  auto job_status = RayTracer(options_).Render(scene_, camera_);
+  job_status->result.wait();
+  EXPECT_TRUE(job_status->outputs.depth.empty());
+  EXPECT_TRUE(job_status->outputs.normal.empty());
+  EXPECT_TRUE(job_status->outputs.albedo.empty());
+  EXPECT_EQ(job_status->outputs.object_id.size(),
+            options_.image_width * options_.image_height);
+  EXPECT_TRUE(job_status->outputs.hit_count.empty());
+}
+
+TEST_F(RendererTest, KeepsLinearImageForReexposure) {
+  auto job_status = RayTracer(options_).Render(scene_, camera_);
+  const auto image = job_status->result.get();
+  const Framebuffer &linear = job_status->image;
+  ASSERT_EQ(linear.width(), options_.image_width);
+  ASSERT_EQ(linear.height(), options_.image_height);
+  EXPECT_EQ(ColorConverter(options_.color_profile)
+                .Convert(linear, options_.pixel_layout),
+            image);
+
+  options_.tone_mapping = ToneMapping::kReinhard;
+  options_.exposure = 2;
+  EXPECT_EQ(RayTracer(options_).Render(scene_, camera_)->result.get(),
+            ColorConverter(options_.color_profile, 1,
+                           ToneMapping::kReinhard, 2)
+                .Convert(linear, options_.pixel_layout));
+}
+
+TEST_F(RendererTest, RendersViewsInOneJob) {
+  options_.min_samples = 2;
+  options_.max_samples = 8;
+  options_.denoise = true;
+  auto left = std::make_shared<Camera>(camera_);
+  auto right = std::make_shared<Camera>(camera_);
+  left->transform.Translate(-0.5, 0, 0);
+  right->transform.Translate(0.5, 0, 0);
+  scene_.Add(left);
+  scene_.Add(right);
+
+  RayTracer tracer(options_);
+  auto left_status = tracer.Render(scene_, *left);
+  auto right_status = tracer.Render(scene_, *right);
+  const auto left_image = left_status->result.get();
+  const auto right_image = right_status->result.get();
+  ASSERT_NE(left_image, right_image);
+
+  auto job_status = tracer.RenderAll(scene_);
+  const auto images = job_status->result.get();
+  ASSERT_EQ(images.size(), left_image.size() * 2);
+  EXPECT_TRUE(std::equal(left_image.begin(), left_image.end(),
+                         images.begin()));
+  EXPECT_TRUE(std::equal(right_image.begin(), right_image.end(),
+                         images.begin() + left_image.size()));
+  EXPECT_EQ(job_status->snapshot(), images);
+  EXPECT_EQ(job_status->image.height(), options_.image_height * 2);
+  EXPECT_EQ(job_status->statistics.primary_rays,
+            left_status->statistics.primary_rays +
+            right_status->statistics.primary_rays);
+}
+
+TEST_F(RendererTest, RendersCropWindow) {
+  options_.min_samples = 2;
+  options_.max_samples = 8;
+  const auto full = RayTracer(options_).Render(scene_, camera_)->result.get();
+  const std::size_t width = options_.image_width;
+  auto full_pixel = [&](std::size_t row, std::size_t col, std::size_t i) {
+    return full[(row * width + col) * 3 + i];
+  };
+
+  // Along tile boundaries, every pixel comes out as in the full image.
+  options_.crop = Tile{16, 16, 16, 40};
+  auto job_status = RayTracer(options_).Render(scene_, camera_);
+  const auto cropped = job_status->result.get();
+  ASSERT_EQ(cropped.size(), 16u * 40 * 3);
+  EXPECT_EQ(job_status->image.width(), 40u);
+  EXPECT_EQ(job_status->image.height(), 16u);
+  for (std::size_t row = 0; row < 16; row++) {
+    for (std::size_t col = 0; col < 40; col++) {
+      for (std::size_t i = 0; i < 3; i++) {
+        EXPECT_EQ(cropped[(row * 40 + col) * 3 + i],
+                  full_pixel(16 + row, 16 + col, i));
+      }
+    }
+  }
+
+  // Anywhere, and past the image edges, with the same number of samples
+  // everywhere.
+  options_.min_samples = options_.max_samples = 4;
+  options_.crop = Tile{30, 50, 20, 40};
+  options_.paste_crop = true;
+  const auto reference = [&] {
+    auto full_options = options_;
+    full_options.crop.reset();
+    return RayTracer(full_options).Render(scene_, camera_)->result.get();
+  }();
+  auto pasted_status = RayTracer(options_).Render(scene_, camera_);
+  const auto pasted = pasted_status->result.get();
+  ASSERT_EQ(pasted.size(), reference.size());
+  EXPECT_EQ(pasted_status->snapshot(), pasted);
+  std::size_t n_cropped = 0;
+  for (std::size_t row = 0; row < options_.image_height; row++) {
+    for (std::size_t col = 0; col < width; col++) {
+      const bool inside = row >= 30 && col >= 50;
+      n_cropped += inside;
+      for (std::size_t i = 0; i < 3; i++) {
+        const std::size_t k = (row * width + col) * 3 + i;
+        EXPECT_EQ(pasted[k], inside ? reference[k] : 0);
+      }
+    }
+  }
+  EXPECT_EQ(pasted_status->statistics.primary_rays, n_cropped * 4);
+}
+
+TEST_F(RendererTest, StopsAtTimeLimit) {
+  options_.progressive = true;
+  options_.time_limit = 1e-9;
+  RayTracer tracer(options_);
+  auto job_status = tracer.Render(scene_, camera_);
+
+  const auto image = job_status->result.get();
+  EXPECT_EQ(image.size(), options_.image_width * options_.image_height * 3);
+  EXPECT_EQ(job_status->outcome, Renderer::Outcome::kTimedOut);
+  EXPECT_LT(job_status->passes_done, job_status->passes_total);
+}
+
+TEST_F(RendererTest, StopsOnCancel) {
+  options_.image_width = 800;
+  options_.image_height = 450;
+  RayTracer tracer(options_);
+  auto job_status = tracer.Render(scene_, camera_);
+  job_status->cancel_requested = true;
+
+  job_status->result.wait();
+  EXPECT_EQ(job_status->outcome, Renderer::Outcome::kCancelled);
+  EXPECT_EQ(job_status->passes_done, 0u);
+  EXPECT_LT(job_status->statistics.finished_tiles.size(),
+            MakeTiles(800, 450, options_.tile_size, options_.tile_order)
+                .size());
+}
+
+}  // namespace test
+
+}  // namespace deer
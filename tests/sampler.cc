@@ -0,0 +1,75 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "../src/sampler.h"
+
+#include <cstddef>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace deer {
+
+namespace test {
+
+class SamplerTest : public ::testing::Test {};
+
+TEST_F(SamplerTest, StaysInUnitInterval) {
+  for (auto sequence : {SampleSequence::kRandom, SampleSequence::kSobol,
+                        SampleSequence::kBlueNoise}) {
+    const Sampler sampler(sequence, 16);
+    for (std::size_t pixel = 0; pixel < 256; pixel += 7) {
+      for (std::size_t sample = 0; sample < 64; sample++) {
+        for (std::size_t dimension = 0; dimension < 6; dimension++) {
+          const double x = sampler.Get(pixel, sample, dimension);
+          EXPECT_GE(x, 0);
+          EXPECT_LT(x, 1);
+          EXPECT_EQ(x, sampler.Get(pixel, sample, dimension));
+        }
+      }
+    }
+  }
+}
+
+TEST_F(SamplerTest, SobolStratifiesPairsOfDimensions) {
+  // 16 points: one in every cell of a 4x4 grid, of a 2x8 one, and so on.
+  const Sampler sampler(SampleSequence::kSobol);
+  for (std::size_t pixel : {0, 1, 1234}) {
+    for (std::size_t dimension : {0, 2, 6}) {
+      for (std::size_t columns : {1, 2, 4, 8, 16}) {
+        const std::size_t rows = 16 / columns;
+        std::vector<int> cells(16);
+        for (std::size_t sample = 0; sample < 16; sample++) {
+          const double2 p = sampler.Get2D(pixel, sample, dimension);
+          cells[static_cast<std::size_t>(p[1] * rows) * columns +
+                static_cast<std::size_t>(p[0] * columns)]++;
+        }
+        for (int count : cells) EXPECT_EQ(count, 1);
+      }
+    }
+  }
+}
+
+TEST_F(SamplerTest, ScramblesPixelsIndependently) {
+  const Sampler sampler(SampleSequence::kSobol);
+  EXPECT_NE(sampler.Get(0, 0, 0), sampler.Get(1, 0, 0));
+  EXPECT_NE(sampler.Get(0, 0, 0), sampler.Get(0, 0, 2));
+  EXPECT_NE(sampler.Get(0, 0, 0), Sampler(SampleSequence::kSobol, 1, 1)
+                                       .Get(0, 0, 0));
+}
+
+TEST_F(SamplerTest, BlueNoiseSpreadsFirstSampleOverPixels) {
+  // The first sample of every pixel in a 64x64 block, one per 1/4096 of
+  // the unit interval.
+  const Sampler sampler(SampleSequence::kBlueNoise, 64);
+  std::vector<int> bins(64 * 64);
+  for (std::size_t pixel = 0; pixel < 64 * 64; pixel++) {
+    bins[static_cast<std::size_t>(sampler.Get(pixel, 0, 3) * bins.size())]++;
+  }
+  for (int count : bins) EXPECT_EQ(count, 1);
+}
+
+}  // namespace test
+
+}  // namespace deer
@@ -0,0 +1,65 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#ifndef DEER_TESTS_SCENE_FIXTURE_H_
+#define DEER_TESTS_SCENE_FIXTURE_H_
+
+#include <memory>
+
+#include <gtest/gtest.h>
+
+#include "../src/geometry.h"
+#include "../src/optics.h"
+#include "../src/scene.h"
+#include "../src/spectrum.h"
+#include "../src/transform.h"
+
+namespace deer {
+
+namespace test {
+
+// The scene the renderer tests share: a ball in front of a wall, lit by
+// one light, seen by a small camera through a three-wavelength colour
+// profile. Options are those of the renderer under test.
+template<class Options>
+class SceneFixture : public ::testing::Test {
+ public:
+  void SetUp() {
+    material_->ambiance_spectrum = Spectrum::MakeConstant(1);
+    material_->diffusion_spectrum = Spectrum::MakeConstant(1);
+    material_->specular_spectrum = Spectrum::MakeConstant(1);
+    material_->shininess = 5;
+
+    scene_.Add(std::make_shared<GeometryObject>(
+        std::make_shared<UnitSphereGeometry>(), material_,
+        AffineTransform().Translate(-1, 0, 0)));
+    scene_.Add(std::make_shared<GeometryObject>(
+        std::make_shared<XYPlaneGeometry>(), material_,
+        AffineTransform().Translate(0, 0, 5)));
+    scene_.ambiance_spectrum = Spectrum::MakeConstant(0.2);
+    scene_.Add(std::make_shared<PointLightSource>(
+        double4{-5, 3, -5, 1}, Spectrum::MakeConstant(0.5)));
+
+    camera_.transform.Translate(0, 0, -10);
+
+    options_.image_width = 75;
+    options_.image_height = 41;
+    options_.color_profile.wavelengths = double3{2, 1, 0};
+    options_.color_profile.min_intensities = double3{0, 0, 0};
+    options_.color_profile.max_intensities = double3{1, 1, 1};
+  }
+
+ protected:
+  // Of both objects.
+  std::shared_ptr<Material> material_ = std::make_shared<Material>();
+  Scene scene_;
+  Camera camera_{16.0 / 9.0, 1, 2};
+  Options options_;
+};
+
+}  // namespace test
+
+}  // namespace deer
+
+#endif  // DEER_TESTS_SCENE_FIXTURE_H_
@@ -0,0 +1,107 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "../src/scheduler.h"
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace deer {
+
+namespace test {
+
+class SchedulerTest : public ::testing::Test {};
+
+TEST_F(SchedulerTest, TilesCoverImageOnce) {
+  const std::size_t width = 37, height = 21;
+  for (auto order : {TileOrder::kScanline, TileOrder::kMorton,
+                     TileOrder::kSpiral}) {
+    std::vector<int> coverage(width * height);
+    for (const auto &tile : MakeTiles(width, height, 8, order)) {
+      for (std::size_t row = tile.row; row < tile.row + tile.height; row++) {
+        for (std::size_t col = tile.col; col < tile.col + tile.width; col++) {
+          coverage[row * width + col]++;
+        }
+      }
+    }
+    for (int count : coverage) EXPECT_EQ(count, 1);
+  }
+}
+
+TEST_F(SchedulerTest, SpiralStartsAtCenter) {
+  const auto tiles = MakeTiles(50, 50, 10, TileOrder::kSpiral);
+  EXPECT_EQ(tiles.front().row, 20u);
+  EXPECT_EQ(tiles.front().col, 20u);
+}
+
+TEST_F(SchedulerTest, RunsEveryTileOnce) {
+  const auto tiles = MakeTiles(100, 60, 4, TileOrder::kMorton);
+  for (bool work_stealing : {false, true}) {
+    TileScheduler scheduler(4, work_stealing);
+    std::vector<std::atomic<int>> runs(tiles.size());
+    scheduler.Run(tiles, [&](const Tile &tile, std::size_t thread) {
+      EXPECT_LT(thread, 4u);
+      runs[&tile - tiles.data()]++;
+    });
+    for (const auto &count : runs) EXPECT_EQ(count, 1);
+    if (!work_stealing) {
+      EXPECT_EQ(scheduler.tiles_stolen(), 0u);
+    }
+  }
+}
+
+TEST_F(SchedulerTest, KeepsThreadsBetweenRuns) {
+  const auto tiles = MakeTiles(100, 60, 4, TileOrder::kMorton);
+  TileScheduler scheduler(4);
+  std::mutex mutex;
+  std::vector<std::thread::id> first_ids(4);
+  for (int run = 0; run < 50; run++) {
+    std::vector<std::atomic<int>> runs(tiles.size());
+    std::vector<std::thread::id> ids(4);
+    scheduler.Run(tiles, [&](const Tile &tile, std::size_t thread) {
+      runs[&tile - tiles.data()]++;
+      std::lock_guard<std::mutex> lock(mutex);
+      ids[thread] = std::this_thread::get_id();
+    });
+    for (const auto &count : runs) EXPECT_EQ(count, 1);
+    // Any thread may have had all its tiles stolen.
+    if (ids[0] != std::thread::id()) {
+      EXPECT_EQ(ids[0], std::this_thread::get_id());
+    }
+    for (std::size_t thread = 1; thread < 4; thread++) {
+      if (ids[thread] == std::thread::id()) continue;
+      if (first_ids[thread] == std::thread::id()) {
+        first_ids[thread] = ids[thread];
+      }
+      EXPECT_EQ(ids[thread], first_ids[thread]);
+      EXPECT_NE(ids[thread], std::this_thread::get_id());
+    }
+  }
+}
+
+TEST_F(SchedulerTest, StopSkipsRemainingTiles) {
+  const auto tiles = MakeTiles(100, 60, 4, TileOrder::kMorton);
+  TileScheduler scheduler(1);
+  std::size_t n_processed = 0;
+  scheduler.Run(tiles, [&](const Tile &, std::size_t) {
+    n_processed++;
+    scheduler.Stop();
+  });
+  EXPECT_EQ(n_processed, 1u);
+  EXPECT_TRUE(scheduler.stopped());
+
+  n_processed = 0;
+  scheduler.Run(tiles, [&](const Tile &, std::size_t) { n_processed++; });
+  EXPECT_EQ(n_processed, tiles.size());
+  EXPECT_FALSE(scheduler.stopped());
+}
+
+}  // namespace test
+
+}  // namespace deer
@@ -0,0 +1,110 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "../src/spectral_sampling.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../src/rgb.h"
+#include "../src/sampler.h"
+#include "../src/spectrum.h"
+#include "../src/vector.h"
+
+namespace deer {
+
+namespace test {
+
+class SpectralSamplerTest : public ::testing::Test {
+ public:
+  void SetUp() {
+    profile_.wavelengths = double3{2, 1, 0};
+    profile_.min_intensities = double3{0, 0, 0};
+    profile_.max_intensities = double3{1, 1, 1};
+  }
+
+ protected:
+  RgbColorProfile profile_;
+};
+
+TEST_F(SpectralSamplerTest, AgreesOnConstantSpectra) {
+  auto spectrum = Spectrum::MakeConstant(0.75);
+  auto expected = double3{0.75, 0.75, 0.75};
+
+  // Three hero wavelengths, one in each of the equal bands.
+  for (auto mode : {SpectralSampling::kRgb,
+                    SpectralSampling::kHeroWavelength,
+                    SpectralSampling::kDense}) {
+    SpectralSampler sampler(profile_, mode, 1, 3);
+    EXPECT_TRUE(near_equal(sampler.Integrate(spectrum, 42), expected));
+  }
+}
+
+TEST_F(SpectralSamplerTest, ResolvesValuesAtItsWavelengths) {
+  auto spectrum = Spectrum::MakeMonochrome(1.2, 0.5, 1) +
+                  Spectrum::MakeConstant(0.25);
+  const Sampler pixel_sampler;
+
+  for (auto mode : {SpectralSampling::kRgb,
+                    SpectralSampling::kHeroWavelength,
+                    SpectralSampling::kDense}) {
+    SpectralSampler sampler(profile_, mode, 2);
+    std::vector<double> wavelengths(sampler.cost()), values(sampler.cost());
+    for (std::size_t pixel = 0; pixel < 8; pixel++) {
+      sampler.Wavelengths(pixel_sampler, pixel, 3, 2, wavelengths.data());
+      for (std::size_t i = 0; i < values.size(); i++) {
+        values[i] = spectrum(wavelengths[i]);
+      }
+      EXPECT_EQ(sampler.Resolve(wavelengths.data(), values.data()),
+                sampler.Integrate(spectrum, pixel_sampler, pixel, 3, 2));
+    }
+  }
+}
+
+TEST_F(SpectralSamplerTest, AveragesOverBands) {
+  // Covers the middle half of the green band.
+  auto spectrum = Spectrum::MakeMonochrome(1, 0.5, 1);
+
+  SpectralSampler rgb(profile_, SpectralSampling::kRgb);
+  EXPECT_TRUE(near_equal(rgb.Integrate(spectrum, 0), double3{0, 1, 0}));
+
+  SpectralSampler dense(profile_, SpectralSampling::kDense, 1, 1, 300);
+  EXPECT_TRUE(near_equal(dense.Integrate(spectrum, 0), double3{0, 0.5, 0}));
+
+  SpectralSampler hero(profile_, SpectralSampling::kHeroWavelength, 64, 3);
+  double3 mean = double3::zero();
+  const int n_seeds = 100;
+  for (int seed = 0; seed < n_seeds; seed++) {
+    mean += hero.Integrate(spectrum, seed) / double(n_seeds);
+  }
+  EXPECT_NEAR(mean.r(), 0, 1e-9);
+  EXPECT_NEAR(mean.g(), 0.5, 0.01);
+  EXPECT_NEAR(mean.b(), 0, 1e-9);
+}
+
+TEST_F(SpectralSamplerTest, ConvergesOnBandsItMostlyMisses) {
+  // A green band a tenth wide, which four hero wavelengths spread over
+  // 3.9 leave out nine times in ten.
+  profile_.wavelengths = double3{3, 1.1, 1};
+  auto spectrum = Spectrum::MakeConstant(1);
+
+  SpectralSampler hero(profile_, SpectralSampling::kHeroWavelength, 1, 4);
+  double3 mean = double3::zero();
+  int n_missed = 0;
+  const int n_seeds = 10000;
+  for (int seed = 0; seed < n_seeds; seed++) {
+    const double3 intensities = hero.Integrate(spectrum, seed);
+    if (intensities.g() == 0) n_missed++;
+    mean += intensities / double(n_seeds);
+  }
+  EXPECT_GT(n_missed, n_seeds / 2);
+  EXPECT_NEAR(mean.r(), 1, 0.02);
+  EXPECT_NEAR(mean.g(), 1, 0.1);
+  EXPECT_NEAR(mean.b(), 1, 0.1);
+}
+
+}  // namespace test
+
+}  // namespace deer
@@ -34,6 +34,19 @@ TEST_F(SpectrumTest, DoesArithmetic) {
   EXPECT_EQ(sp2(15), 10);
 }
 
+TEST_F(SpectrumTest, KnowsConstantValues) {
+  auto const_sp = Spectrum::MakeConstant(2);
+  auto mono_sp = Spectrum::MakeMonochrome(10, 4, 3);
+
+  EXPECT_EQ(const_sp.constant_value(), 2);
+  EXPECT_EQ((const_sp * 3.0 + const_sp).constant_value(), 8);
+  EXPECT_FALSE(mono_sp.constant_value().has_value());
+  EXPECT_FALSE((mono_sp + const_sp).constant_value().has_value());
+  EXPECT_EQ((mono_sp * Spectrum::MakeConstant(0)).constant_value(), 0);
+  EXPECT_EQ((mono_sp * 0.0).constant_value(), 0);
+  EXPECT_FALSE(Spectrum().constant_value().has_value());
+}
+
 }  // namespace test
 
 }  // namespace deer
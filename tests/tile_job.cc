@@ -0,0 +1,92 @@
+// Copyright 2018 Ilia Pozdnyakov
+// This file is distributed under the MIT license.
+// See the LICENSE.txt file for details.
+
+#include "../src/tile_job.h"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "../src/renderer.h"
+#include "../src/scheduler.h"
+
+namespace deer {
+
+namespace test {
+
+class TileJobTest : public ::testing::Test {
+ public:
+  void SetUp() {
+    job_status_ = std::make_shared<Renderer::JobStatus>();
+    job_status_->amount_done = 0;
+    tiles_ = MakeTiles(32, 32, 8, TileOrder::kScanline);
+  }
+
+ protected:
+  std::shared_ptr<Renderer::JobStatus> job_status_;
+  std::vector<Tile> tiles_;
+};
+
+TEST_F(TileJobTest, CountsPasses) {
+  TileJob job(job_status_, 2, true, 0);
+  std::atomic<std::size_t> n_processed{0};
+  for (int pass = 0; pass < 3; pass++) {
+    EXPECT_TRUE(job.RunPass(tiles_, [&](const Tile &, std::size_t) {
+      n_processed++;
+    }));
+  }
+  EXPECT_EQ(n_processed, 3 * tiles_.size());
+  EXPECT_EQ(job_status_->passes_done, 3u);
+  EXPECT_EQ(job_status_->outcome, Renderer::Outcome::kCompleted);
+  EXPECT_TRUE(job_status_->statistics.finished_tiles.empty());
+}
+
+TEST_F(TileJobTest, StopsWithTilesOfLastPass) {
+  TileJob job(job_status_, 1, true, 0);
+  EXPECT_TRUE(job.RunPass(tiles_, [](const Tile &, std::size_t) {}));
+  std::size_t n_processed = 0;
+  EXPECT_FALSE(job.RunPass(tiles_, [&](const Tile &, std::size_t) {
+    if (++n_processed == 5) job_status_->cancel_requested = true;
+  }));
+  EXPECT_EQ(job_status_->passes_done, 1u);
+  EXPECT_EQ(job_status_->outcome, Renderer::Outcome::kCancelled);
+  EXPECT_EQ(job_status_->statistics.finished_tiles.size(), 5u);
+}
+
+TEST_F(TileJobTest, StopsRunsThatAreNoPass) {
+  TileJob job(job_status_, 1, true, 0);
+  std::size_t n_processed = 0;
+  EXPECT_TRUE(job.RunTiles(tiles_, [&](const Tile &, std::size_t) {
+    n_processed++;
+  }));
+  EXPECT_FALSE(job.RunTiles(tiles_, [&](const Tile &, std::size_t) {
+    if (++n_processed == tiles_.size() + 5) {
+      job_status_->cancel_requested = true;
+    }
+  }));
+  EXPECT_EQ(n_processed, tiles_.size() + 5);
+  EXPECT_EQ(job_status_->passes_done, 0u);
+  EXPECT_EQ(job_status_->outcome, Renderer::Outcome::kCancelled);
+  EXPECT_TRUE(job_status_->statistics.finished_tiles.empty());
+}
+
+TEST_F(TileJobTest, ReportsFirstReasonToStop) {
+  TileJob job(job_status_, 1, true, 1e-9);
+  EXPECT_TRUE(job.ShouldStop());
+  // Cancelling after the deadline has passed does not change why the job
+  // stopped.
+  job_status_->cancel_requested = true;
+  EXPECT_TRUE(job.ShouldStop());
+  // Reported once the job is over, not by the threads that stop it.
+  EXPECT_EQ(job_status_->outcome, Renderer::Outcome::kCompleted);
+  job.EndTracing();
+  EXPECT_EQ(job_status_->outcome, Renderer::Outcome::kTimedOut);
+}
+
+}  // namespace test
+
+}  // namespace deer
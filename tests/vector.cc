@@ -4,6 +4,8 @@
 
 #include "../src/vector.h"
 
+#include <cmath>
+
 #include <gtest/gtest.h>
 
 namespace deer {
@@ -79,6 +81,29 @@ TEST_F(VectorTest, DoesProjectReflect) {
   }
 }
 
+TEST_F(VectorTest, DoesRefract) {
+  const double s = std::sqrt(0.5);
+  const double2 normal{0, 1};
+  {
+    // Straight through, whatever the indices.
+    auto expected = double2{0, -1};
+    EXPECT_TRUE(near_equal(double2{0, -1}.refract_through(normal, 1.5),
+                           expected));
+  }
+  {
+    // sin 45 deg / 2 on the way into a denser medium.
+    auto refracted = double2{s, -s}.refract_through(normal, 0.5);
+    EXPECT_NEAR(refracted[0], s / 2, 1e-12);
+    EXPECT_NEAR(length(refracted), 1, 1e-12);
+  }
+  {
+    // Total internal reflection on the way out.
+    auto expected = double2::zero();
+    auto refracted = double2{s, -s}.refract_through(normal, 1.5);
+    EXPECT_EQ(refracted, expected);
+  }
+}
+
 }  // namespace test
 
 }  // namespace deer